@@ -0,0 +1,97 @@
+/*
+ * BinaryVocabFile.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: andresf
+ */
+
+#ifndef BINARYVOCABFILE_HPP_
+#define BINARYVOCABFILE_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+/**
+ * Binary container of the matrices of a vocabulary, memory mapped when loaded.
+ *
+ * The file holds a 64 bytes header with the magic, the format version, the number of
+ * matrices and the vocabulary type tag, then one 32 bytes entry per matrix with its name,
+ * rows, columns, OpenCV type and the offset of its data, and finally the raw data of
+ * every matrix, continuous and aligned to 64 bytes.
+ *
+ * Matrices returned by a loaded file point into the mapping, hence they are only valid
+ * while the file object lives. The mapping is private, writing to them does not modify
+ * the file.
+ */
+class BinaryVocabFile {
+public:
+
+	/**
+	 * Maps a binary vocabulary file.
+	 *
+	 * @param filename - Name of the file
+	 */
+	explicit BinaryVocabFile(const std::string& filename);
+
+	/**
+	 * Unmaps the file.
+	 */
+	~BinaryVocabFile();
+
+	/**
+	 * Saves the matrices of a vocabulary.
+	 *
+	 * @param filename - Name of the file
+	 * @param type - Vocabulary type tag, e.g. AKMAJ, at most 15 characters
+	 * @param names - Name of each matrix, at most 7 characters
+	 * @param matrices - Matrices to save
+	 */
+	static void save(const std::string& filename, const std::string& type,
+			const std::vector<std::string>& names,
+			const std::vector<cv::Mat>& matrices);
+
+	/**
+	 * Checks whether a file starts with the magic of binary vocabularies.
+	 */
+	static bool isBinaryVocab(const std::string& filename);
+
+	/**
+	 * Checks whether a file name has the extension of binary vocabularies, i.e. .bin
+	 */
+	static bool hasBinaryExtension(const std::string& filename);
+
+	const std::string& getType() const {
+		return m_type;
+	}
+
+	/**
+	 * Returns a matrix header pointing into the mapping.
+	 *
+	 * @param name - Name of the matrix
+	 */
+	cv::Mat getMatrix(const std::string& name) const;
+
+	/**
+	 * Checks whether the file holds a matrix, e.g. one added by a later version.
+	 *
+	 * @param name - Name of the matrix
+	 */
+	bool hasMatrix(const std::string& name) const;
+
+private:
+
+	// Non-copyable, the mapping is owned
+	BinaryVocabFile(const BinaryVocabFile&);
+	BinaryVocabFile& operator=(const BinaryVocabFile&);
+
+	void* m_data;
+	size_t m_size;
+	std::string m_type;
+	std::map<std::string, cv::Mat> m_matrices;
+
+};
+
+#endif /* BINARYVOCABFILE_HPP_ */
@@ -0,0 +1,102 @@
+/*
+ * BoundedQueue.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: andresf
+ */
+
+#ifndef BOUNDEDQUEUE_HPP_
+#define BOUNDEDQUEUE_HPP_
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+
+/**
+ * Thread-safe FIFO queue of limited capacity connecting producer and consumer stages.
+ *
+ * Producers block on push while the queue is full and consumers block on pop while it is
+ * empty. Once the producers are done they close the queue, consumers then drain the
+ * remaining items and pop returns false.
+ */
+template<typename T>
+class BoundedQueue {
+public:
+
+	BoundedQueue(size_t capacity) :
+			m_capacity(capacity), m_closed(false) {
+		if (capacity == 0) {
+			throw std::runtime_error(
+					"[BoundedQueue::BoundedQueue] Capacity must be positive");
+		}
+	}
+
+	/**
+	 * Appends an item, blocking while the queue is full.
+	 *
+	 * @param item - The item to append
+	 */
+	void push(T item) {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_notFull.wait(lock, [this] {return m_items.size() < m_capacity || m_closed;});
+		if (m_closed) {
+			throw std::runtime_error("[BoundedQueue::push] Queue is closed");
+		}
+		m_items.push_back(std::move(item));
+		m_notEmpty.notify_one();
+	}
+
+	/**
+	 * Removes the oldest item, blocking while the queue is empty and open.
+	 *
+	 * @param item - Output item
+	 * @return False if the queue is closed and there are no items left
+	 */
+	bool pop(T& item) {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_notEmpty.wait(lock, [this] {return m_items.empty() == false || m_closed;});
+		if (m_items.empty()) {
+			return false;
+		}
+		item = std::move(m_items.front());
+		m_items.pop_front();
+		m_notFull.notify_one();
+		return true;
+	}
+
+	/**
+	 * Signals that no more items will be pushed and wakes up the blocked threads.
+	 */
+	void close() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_closed = true;
+		m_notEmpty.notify_all();
+		m_notFull.notify_all();
+	}
+
+	size_t size() const {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_items.size();
+	}
+
+	size_t capacity() const {
+		return m_capacity;
+	}
+
+private:
+
+	// Make private the copy constructor and the assignment operator
+	BoundedQueue(BoundedQueue const&); // Don't Implement
+	void operator=(BoundedQueue const&); // Don't implement
+
+	size_t m_capacity;
+	bool m_closed;
+	std::deque<T> m_items;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_notEmpty;
+	std::condition_variable m_notFull;
+
+};
+
+#endif /* BOUNDEDQUEUE_HPP_ */
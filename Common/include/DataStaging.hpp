@@ -0,0 +1,55 @@
+/*
+ * DataStaging.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: andresf
+ */
+
+#ifndef DATASTAGING_HPP_
+#define DATASTAGING_HPP_
+
+#include <opencv2/core/core.hpp>
+
+#include <DynamicMat.hpp>
+
+/**
+ * Helpers to stage a subset of a data set in a contiguous local buffer, so that
+ * clustering reads every descriptor from the data set backend only once.
+ *
+ * Row i of a staged buffer is the descriptor indices[i], hence any reordering of the
+ * indices must move the staged rows along.
+ */
+class DataStaging {
+public:
+
+	/**
+	 * Gathers the descriptors referenced by the indices into a contiguous buffer, unless
+	 * it would take more than a memory budget.
+	 *
+	 * @param dataset - The data set
+	 * @param indices - Indices of the descriptors to gather
+	 * @param length - Number of indices
+	 * @param maxBytes - Maximum size of the buffer
+	 * @param staged - Output buffer, one row per index
+	 * @return true if the descriptors were staged, false if they did not fit
+	 */
+	static bool gather(vlr::Mat& dataset, const int* indices, int length,
+			size_t maxBytes, cv::Mat& staged);
+
+	/**
+	 * Sorts the indices in increasing order moving the staged rows along.
+	 *
+	 * @param indices - Indices to sort
+	 * @param length - Number of indices
+	 * @param staged - Buffer with one row per index
+	 */
+	static void sortByIndex(int* indices, int length, cv::Mat& staged);
+
+	/**
+	 * Swaps two rows of a staged buffer.
+	 */
+	static void swapRows(cv::Mat& staged, int a, int b);
+
+};
+
+#endif /* DATASTAGING_HPP_ */
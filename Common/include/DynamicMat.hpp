@@ -50,7 +50,10 @@ public:
 	Mat();
 
 	/**
-	 * Copy constructor.
+	 * Copy constructor, the copy gets its own clone of the cache client.
+	 *
+	 * The memcached client behind this class is not thread safe, hence code reading
+	 * the same matrix from several threads must give each thread its own copy.
 	 *
 	 * @param other - Reference to an instance where to copy properties from
 	 */
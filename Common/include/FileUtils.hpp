@@ -126,7 +126,8 @@ void saveDescriptors(const std::string& filename, const cv::Mat& descriptors);
 void loadDescriptors(const std::string& filename, cv::Mat& descriptors);
 
 /**
- * Saves a set of keypoints onto a plain text file using OpenCV FileStorage API.
+ * Saves a set of keypoints onto a plain text file using OpenCV FileStorage API,
+ * or in binary format if the filename has the extension .bin.
  *
  * @param filename - The path to the file where to save the keypoints
  * @param keypoints - The keypoints to be saved
@@ -135,7 +136,8 @@ void saveKeypoints(const std::string& filename,
 		const std::vector<cv::KeyPoint>& keypoints);
 
 /**
- * Loads a set of keypoints from a plain text file using OpenCV FileStorage API.
+ * Loads a set of keypoints from a plain text file using OpenCV FileStorage API,
+ * or from a binary file if the filename has the extension .bin.
  *
  * @param filename - The path to the file where to load the keypoints from
  * @param keypoints - The list where to save the loaded keypoints
@@ -143,6 +145,28 @@ void saveKeypoints(const std::string& filename,
 void loadKeypoints(const std::string& filename,
 		std::vector<cv::KeyPoint>& keypoints);
 
+/**
+ * Saves a set of keypoints in binary format onto a file stream using C++ STL.
+ *
+ * A magic and a version are followed by the number of keypoints, then by the x, y,
+ * size, angle and response (as floats) and the octave (as int) of every keypoint.
+ *
+ * @param filename - The path to the file where to save the keypoints
+ * @param keypoints - The keypoints to be saved
+ */
+void saveKeypointsToBin(const std::string& filename,
+		const std::vector<cv::KeyPoint>& keypoints);
+
+/**
+ * Loads a set of keypoints from a binary formatted file stream using C++ STL, files
+ * without the keypoints magic are rejected.
+ *
+ * @param filename - The path to the file where to load the keypoints from
+ * @param keypoints - The list where to save the loaded keypoints
+ */
+void loadKeypointsFromBin(const std::string& filename,
+		std::vector<cv::KeyPoint>& keypoints);
+
 /**
  * Checks whether a file exists.
  *
@@ -151,6 +175,15 @@ void loadKeypoints(const std::string& filename,
  */
 bool checkFileExist(const std::string& filename);
 
+/**
+ * Atomically replaces a file by another one, e.g. a fully written temporary file, so
+ * readers see either the old or the new contents. Both must be in the same file system.
+ *
+ * @param from - The name of the file to move
+ * @param to - The name of the file to replace
+ */
+void replaceFile(const std::string& from, const std::string& to);
+
 /**
  * Loads from a plain text file a list of strings and regions coordinates corresponding to
  * a set of queries.
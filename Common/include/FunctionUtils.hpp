@@ -8,6 +8,7 @@
 #ifndef FUNCTIONUTILS_HPP_
 #define FUNCTIONUTILS_HPP_
 
+#include <functional>
 #include <vector>
 #include <sstream>
 
@@ -45,6 +46,24 @@ std::string basify(const std::string& s);
 
 std::string parseLandmarkName(std::vector<std::string>::const_iterator fileName);
 
+/**
+ * Runs body(t, bounds[t], bounds[t + 1]) for every partition t, each on its own thread
+ * except a single partition which runs on the calling one. Rethrows the first error
+ * after all threads are done.
+ *
+ * @param bounds - Boundaries of the partitions
+ * @param body - Function to run on every partition
+ */
+void runPartitioned(const std::vector<int>& bounds,
+		const std::function<void(int, int, int)>& body);
+
+/**
+ * Splits [0, total) into numPartitions ranges of about the same length.
+ *
+ * @return The numPartitions + 1 boundaries of the ranges
+ */
+std::vector<int> splitEvenly(int total, int numPartitions);
+
 } // namespace FunctionUtils
 
 #endif /* FUNCTIONUTILS_HPP_ */
@@ -0,0 +1,239 @@
+/*
+ * BinaryVocabFile.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: andresf
+ */
+
+#include <BinaryVocabFile.hpp>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+static const char BINARY_VOCAB_MAGIC[8] = { 'V', 'L', 'R', 'V', 'O', 'C',
+		'A', 'B' };
+static const uint32_t BINARY_VOCAB_VERSION = 1;
+static const size_t BINARY_VOCAB_ALIGNMENT = 64;
+
+struct BinaryVocabHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t numMatrices;
+	char type[16];
+	char reserved[32];
+};
+
+struct BinaryVocabEntry {
+	char name[8];
+	int32_t rows;
+	int32_t cols;
+	int32_t type;
+	int32_t reserved;
+	uint64_t offset;
+};
+
+static_assert(sizeof(BinaryVocabHeader) == 64, "Unexpected header size");
+static_assert(sizeof(BinaryVocabEntry) == 32, "Unexpected entry size");
+
+static size_t alignOffset(size_t offset) {
+	return (offset + BINARY_VOCAB_ALIGNMENT - 1) / BINARY_VOCAB_ALIGNMENT
+			* BINARY_VOCAB_ALIGNMENT;
+}
+
+// --------------------------------------------------------------------------
+
+BinaryVocabFile::BinaryVocabFile(const std::string& filename) :
+		m_data(MAP_FAILED), m_size(0) {
+
+	int fd = open(filename.c_str(), O_RDONLY);
+
+	if (fd < 0) {
+		throw std::runtime_error("[BinaryVocabFile::BinaryVocabFile] "
+				"Unable to open file [" + filename + "] for reading");
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(BinaryVocabHeader)) {
+		close(fd);
+		throw std::runtime_error("[BinaryVocabFile::BinaryVocabFile] "
+				"File [" + filename + "] is too short");
+	}
+
+	m_size = st.st_size;
+	// Private mapping, pages are copied on write and never written back
+	m_data = mmap(NULL, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (m_data == MAP_FAILED) {
+		throw std::runtime_error("[BinaryVocabFile::BinaryVocabFile] "
+				"Unable to map file [" + filename + "]");
+	}
+
+	const char* data = (const char*) m_data;
+	const BinaryVocabHeader* header = (const BinaryVocabHeader*) data;
+
+	if (memcmp(header->magic, BINARY_VOCAB_MAGIC, sizeof(header->magic)) != 0
+			|| header->version != BINARY_VOCAB_VERSION) {
+		munmap(m_data, m_size);
+		throw std::runtime_error("[BinaryVocabFile::BinaryVocabFile] "
+				"File [" + filename + "] is not a binary vocabulary");
+	}
+
+	m_type.assign(header->type, strnlen(header->type, sizeof(header->type)));
+
+	size_t entriesEnd = sizeof(BinaryVocabHeader)
+			+ size_t(header->numMatrices) * sizeof(BinaryVocabEntry);
+	if (entriesEnd > m_size) {
+		munmap(m_data, m_size);
+		throw std::runtime_error("[BinaryVocabFile::BinaryVocabFile] "
+				"File [" + filename + "] is truncated");
+	}
+
+	const BinaryVocabEntry* entries = (const BinaryVocabEntry*) (data
+			+ sizeof(BinaryVocabHeader));
+
+	for (uint32_t m = 0; m < header->numMatrices; ++m) {
+		const BinaryVocabEntry& entry = entries[m];
+		size_t bytes = size_t(entry.rows) * entry.cols
+				* CV_ELEM_SIZE(entry.type);
+		if (entry.rows < 0 || entry.cols < 0 || entry.offset > m_size
+				|| bytes > m_size - entry.offset) {
+			munmap(m_data, m_size);
+			throw std::runtime_error("[BinaryVocabFile::BinaryVocabFile] "
+					"File [" + filename + "] is truncated");
+		}
+		std::string name(entry.name, strnlen(entry.name, sizeof(entry.name)));
+		m_matrices[name] = cv::Mat(entry.rows, entry.cols, entry.type,
+				(char*) m_data + entry.offset);
+	}
+
+}
+
+// --------------------------------------------------------------------------
+
+BinaryVocabFile::~BinaryVocabFile() {
+	munmap(m_data, m_size);
+}
+
+// --------------------------------------------------------------------------
+
+void BinaryVocabFile::save(const std::string& filename,
+		const std::string& type, const std::vector<std::string>& names,
+		const std::vector<cv::Mat>& matrices) {
+
+	CV_Assert(names.size() == matrices.size());
+
+	BinaryVocabHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, BINARY_VOCAB_MAGIC, sizeof(header.magic));
+	header.version = BINARY_VOCAB_VERSION;
+	header.numMatrices = matrices.size();
+	if (type.size() >= sizeof(header.type)) {
+		throw std::runtime_error("[BinaryVocabFile::save] "
+				"Type [" + type + "] is too long");
+	}
+	memcpy(header.type, type.c_str(), type.size());
+
+	// Lay out the data after the entries, every matrix aligned
+	std::vector<BinaryVocabEntry> entries(matrices.size());
+	size_t offset = alignOffset(
+			sizeof(BinaryVocabHeader)
+					+ matrices.size() * sizeof(BinaryVocabEntry));
+	for (size_t m = 0; m < matrices.size(); ++m) {
+		if (names[m].size() >= sizeof(entries[m].name)) {
+			throw std::runtime_error("[BinaryVocabFile::save] "
+					"Matrix name [" + names[m] + "] is too long");
+		}
+		memset(&entries[m], 0, sizeof(BinaryVocabEntry));
+		memcpy(entries[m].name, names[m].c_str(), names[m].size());
+		entries[m].rows = matrices[m].rows;
+		entries[m].cols = matrices[m].cols;
+		entries[m].type = matrices[m].type();
+		entries[m].offset = offset;
+		offset = alignOffset(
+				offset + matrices[m].total() * matrices[m].elemSize());
+	}
+
+	std::ofstream os;
+
+	// Open file
+	os.open(filename.c_str(),
+			std::ios::out | std::ios::trunc | std::ios::binary);
+
+	// Check file
+	if (os.good() == false) {
+		throw std::runtime_error("[BinaryVocabFile::save] "
+				"Unable to open file [" + filename + "] for writing");
+	}
+
+	os.write((const char*) &header, sizeof(header));
+	os.write((const char*) entries.data(),
+			entries.size() * sizeof(BinaryVocabEntry));
+
+	static const char padding[BINARY_VOCAB_ALIGNMENT] = { 0 };
+
+	for (size_t m = 0; m < matrices.size(); ++m) {
+		os.write(padding, entries[m].offset - size_t(os.tellp()));
+		// Rows are written one at a time in case the matrix is not continuous
+		size_t rowBytes = matrices[m].cols * matrices[m].elemSize();
+		for (int i = 0; i < matrices[m].rows; ++i) {
+			os.write((const char*) matrices[m].ptr(i), rowBytes);
+		}
+	}
+
+	if (os.good() == false) {
+		throw std::runtime_error("[BinaryVocabFile::save] "
+				"Error while writing file [" + filename + "]");
+	}
+
+	// Close file
+	os.close();
+
+}
+
+// --------------------------------------------------------------------------
+
+bool BinaryVocabFile::isBinaryVocab(const std::string& filename) {
+
+	std::ifstream is(filename.c_str(), std::fstream::in | std::fstream::binary);
+
+	char magic[sizeof(BINARY_VOCAB_MAGIC)];
+	is.read(magic, sizeof(magic));
+
+	return is.gcount() == std::streamsize(sizeof(magic))
+			&& memcmp(magic, BINARY_VOCAB_MAGIC, sizeof(magic)) == 0;
+}
+
+// --------------------------------------------------------------------------
+
+bool BinaryVocabFile::hasBinaryExtension(const std::string& filename) {
+	return filename.size() >= 4
+			&& filename.compare(filename.size() - 4, 4, ".bin") == 0;
+}
+
+// --------------------------------------------------------------------------
+
+cv::Mat BinaryVocabFile::getMatrix(const std::string& name) const {
+
+	std::map<std::string, cv::Mat>::const_iterator it = m_matrices.find(name);
+
+	if (it == m_matrices.end()) {
+		throw std::runtime_error("[BinaryVocabFile::getMatrix] "
+				"No matrix named [" + name + "]");
+	}
+
+	return it->second;
+}
+
+// --------------------------------------------------------------------------
+
+bool BinaryVocabFile::hasMatrix(const std::string& name) const {
+	return m_matrices.find(name) != m_matrices.end();
+}
@@ -0,0 +1,62 @@
+/*
+ * DataStaging.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: andresf
+ */
+
+#include <DataStaging.hpp>
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+bool DataStaging::gather(vlr::Mat& dataset, const int* indices, int length,
+		size_t maxBytes, cv::Mat& staged) {
+
+	size_t rowBytes = dataset.cols * dataset.elemSize();
+
+	if (size_t(length) * rowBytes > maxBytes) {
+		return false;
+	}
+
+	staged.create(length, dataset.cols, dataset.type());
+	for (int i = 0; i < length; ++i) {
+		dataset.row(indices[i]).copyTo(staged.row(i));
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------------------------
+
+void DataStaging::sortByIndex(int* indices, int length, cv::Mat& staged) {
+
+	CV_Assert(staged.rows == length);
+
+	std::vector<int> order(length);
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [indices](int a, int b) {
+		return indices[a] < indices[b];
+	});
+
+	std::vector<int> sortedIndices(length);
+	cv::Mat sorted(staged.rows, staged.cols, staged.type());
+	for (int i = 0; i < length; ++i) {
+		sortedIndices[i] = indices[order[i]];
+		staged.row(order[i]).copyTo(sorted.row(i));
+	}
+
+	std::copy(sortedIndices.begin(), sortedIndices.end(), indices);
+	sorted.copyTo(staged);
+}
+
+// --------------------------------------------------------------------------
+
+void DataStaging::swapRows(cv::Mat& staged, int a, int b) {
+	if (a == b) {
+		return;
+	}
+	uchar* rowA = staged.ptr(a);
+	std::swap_ranges(rowA, rowA + staged.cols * staged.elemSize(), staged.ptr(b));
+}
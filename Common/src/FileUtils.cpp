@@ -1,11 +1,14 @@
 #include <FileUtils.hpp>
 
 #include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <dirent.h>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -13,6 +16,22 @@
 #include <boost/iostreams/filtering_stream.hpp>
 #include <sys/stat.h>
 
+// Size in bytes of a keypoint in binary format: x, y, size, angle, response and octave
+static const size_t KEYPOINT_BIN_SIZE = 5 * sizeof(float) + sizeof(int);
+
+// Magic and version heading binary keypoints files, which tell them from descriptors
+static const char KEYPOINT_BIN_MAGIC[8] = { 'V', 'L', 'R', 'K', 'E', 'Y', 'P',
+		'T' };
+static const uint32_t KEYPOINT_BIN_VERSION = 1;
+
+/**
+ * Keypoints files with the extension .bin are stored in binary format.
+ */
+static bool hasBinExtension(const std::string& filename) {
+	return filename.size() >= 4
+			&& filename.compare(filename.size() - 4, 4, ".bin") == 0;
+}
+
 void FileUtils::readFolder(const char* folderPath,
 		std::vector<std::string>& files) {
 	DIR *dir;
@@ -231,6 +250,11 @@ void FileUtils::loadDescriptorsFromYaml(const std::string& filename,
 void FileUtils::saveKeypoints(const std::string& filename,
 		const std::vector<cv::KeyPoint>& keypoints) {
 
+	if (hasBinExtension(filename)) {
+		saveKeypointsToBin(filename, keypoints);
+		return;
+	}
+
 	cv::FileStorage fs(filename.c_str(), cv::FileStorage::WRITE);
 
 	if (fs.isOpened() == false) {
@@ -263,6 +287,11 @@ void FileUtils::saveKeypoints(const std::string& filename,
 void FileUtils::loadKeypoints(const std::string& filename,
 		std::vector<cv::KeyPoint>& keypoints) {
 
+	if (hasBinExtension(filename)) {
+		loadKeypointsFromBin(filename, keypoints);
+		return;
+	}
+
 	cv::FileStorage fs(filename.c_str(), cv::FileStorage::READ);
 
 	if (fs.isOpened() == false) {
@@ -293,6 +322,115 @@ void FileUtils::loadKeypoints(const std::string& filename,
 
 // --------------------------------------------------------------------------
 
+void FileUtils::saveKeypointsToBin(const std::string& filename,
+		const std::vector<cv::KeyPoint>& keypoints) {
+
+	std::ofstream os;
+
+	// Open file
+	os.open(filename.c_str(),
+			std::ios::out | std::ios::trunc | std::ios::binary);
+
+	// Check file
+	if (os.good() == false) {
+		throw std::runtime_error("[FileUtils::saveKeypointsToBin] "
+				"Unable to open file [" + filename + "] for writing");
+	}
+
+	// Write magic, version and number of keypoints
+	os.write(KEYPOINT_BIN_MAGIC, sizeof(KEYPOINT_BIN_MAGIC));
+	os.write((const char*) &KEYPOINT_BIN_VERSION, sizeof(uint32_t));
+	int numKeypoints = keypoints.size();
+	os.write((char*) &numKeypoints, sizeof(int));
+
+	// Serialize the fields into a single buffer and write it at once
+	std::vector<char> buffer(numKeypoints * KEYPOINT_BIN_SIZE);
+	char* record = buffer.data();
+	for (const cv::KeyPoint& k : keypoints) {
+		float fields[5] = { k.pt.x, k.pt.y, k.size, k.angle, k.response };
+		memcpy(record, fields, sizeof(fields));
+		memcpy(record + sizeof(fields), &k.octave, sizeof(int));
+		record += KEYPOINT_BIN_SIZE;
+	}
+	os.write(buffer.data(), buffer.size());
+
+	if (os.good() == false) {
+		throw std::runtime_error("[FileUtils::saveKeypointsToBin] "
+				"Error while writing file [" + filename + "]");
+	}
+
+	// Close file
+	os.close();
+
+}
+
+// --------------------------------------------------------------------------
+
+void FileUtils::loadKeypointsFromBin(const std::string& filename,
+		std::vector<cv::KeyPoint>& keypoints) {
+
+	std::ifstream is;
+
+	// Open file
+	is.open(filename.c_str(), std::fstream::in | std::fstream::binary);
+
+	// Check file
+	if (is.good() == false) {
+		throw std::runtime_error("[FileUtils::loadKeypointsFromBin] "
+				"Unable to open file [" + filename + "] for reading");
+	}
+
+	char magic[sizeof(KEYPOINT_BIN_MAGIC)];
+	uint32_t version = 0;
+	is.read(magic, sizeof(magic));
+	is.read((char*) &version, sizeof(uint32_t));
+
+	if (is.good() == false
+			|| memcmp(magic, KEYPOINT_BIN_MAGIC, sizeof(magic)) != 0
+			|| version != KEYPOINT_BIN_VERSION) {
+		throw std::runtime_error("[FileUtils::loadKeypointsFromBin] "
+				"File [" + filename + "] is not a binary keypoints file");
+	}
+
+	// Read number of keypoints
+	int numKeypoints = -1;
+	is.read((char*) &numKeypoints, sizeof(int));
+
+	if (is.good() == false || numKeypoints < 0) {
+		throw std::runtime_error("[FileUtils::loadKeypointsFromBin] "
+				"Invalid header in file [" + filename + "]");
+	}
+
+	std::vector<char> buffer(numKeypoints * KEYPOINT_BIN_SIZE);
+	is.read(buffer.data(), buffer.size());
+
+	if (is.gcount() != std::streamsize(buffer.size())) {
+		throw std::runtime_error("[FileUtils::loadKeypointsFromBin] "
+				"File [" + filename + "] is truncated");
+	}
+
+	keypoints.clear();
+	keypoints.reserve(numKeypoints);
+
+	const char* record = buffer.data();
+	for (int i = 0; i < numKeypoints; ++i) {
+		float fields[5];
+		int octave;
+		memcpy(fields, record, sizeof(fields));
+		memcpy(&octave, record + sizeof(fields), sizeof(int));
+		keypoints.push_back(
+				cv::KeyPoint(fields[0], fields[1], fields[2], fields[3],
+						fields[4], octave));
+		record += KEYPOINT_BIN_SIZE;
+	}
+
+	// Close file
+	is.close();
+
+}
+
+// --------------------------------------------------------------------------
+
 bool FileUtils::checkFileExist(const std::string& fname) {
 	struct stat buffer;
 	return stat(fname.c_str(), &buffer) == 0;
@@ -300,6 +438,16 @@ bool FileUtils::checkFileExist(const std::string& fname) {
 
 // --------------------------------------------------------------------------
 
+void FileUtils::replaceFile(const std::string& from, const std::string& to) {
+	if (rename(from.c_str(), to.c_str()) != 0) {
+		throw std::runtime_error("[FileUtils::replaceFile] "
+				"Unable to rename [" + from + "] to [" + to + "]: "
+				+ strerror(errno));
+	}
+}
+
+// --------------------------------------------------------------------------
+
 void FileUtils::loadQueriesList(std::string& filePath,
 		std::vector<Query>& list) {
 
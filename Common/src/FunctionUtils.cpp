@@ -9,9 +9,11 @@
 #include <FunctionUtils.hpp>
 
 #include <bitset>
+#include <exception>
 #include <stdio.h>
 #include <string>
 #include <stdexcept>
+#include <thread>
 
 void FunctionUtils::printKeypoints(std::vector<cv::KeyPoint>& keypoints) {
 
@@ -172,6 +174,51 @@ std::string FunctionUtils::parseLandmarkName(std::vector<std::string>::const_ite
 	return landmarkName;
 }
 
+void FunctionUtils::runPartitioned(const std::vector<int>& bounds,
+		const std::function<void(int, int, int)>& body) {
+
+	int numPartitions = int(bounds.size()) - 1;
+
+	if (numPartitions == 1) {
+		body(0, bounds[0], bounds[1]);
+		return;
+	}
+
+	std::vector<std::exception_ptr> errors(numPartitions);
+	std::vector<std::thread> threads;
+
+	for (int t = 0; t < numPartitions; ++t) {
+		threads.push_back(std::thread([&, t]() {
+			try {
+				body(t, bounds[t], bounds[t + 1]);
+			} catch (...) {
+				errors[t] = std::current_exception();
+			}
+		}));
+	}
+
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	for (std::exception_ptr& error : errors) {
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+
+}
+
+std::vector<int> FunctionUtils::splitEvenly(int total, int numPartitions) {
+
+	std::vector<int> bounds(numPartitions + 1);
+	for (int t = 0; t <= numPartitions; ++t) {
+		bounds[t] = int((long long) total * t / numPartitions);
+	}
+	return bounds;
+
+}
+
 ///**
 // * Transforms a key filename to an image filename
 // *
@@ -0,0 +1,77 @@
+/*
+ * BinaryVocabFile_test.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: andresf
+ */
+
+#include <cstdio>
+#include <gtest/gtest.h>
+
+#include <opencv2/core/core.hpp>
+
+#include <BinaryVocabFile.hpp>
+
+TEST(BinaryVocabFile, SaveLoad) {
+
+	cv::RNG rng(0xFFFFFFFF);
+
+	cv::Mat centers(100, 32, CV_8U);
+	rng.fill(centers, cv::RNG::UNIFORM, 0, 256);
+	cv::Mat weights(1, 100, CV_64F);
+	rng.fill(weights, cv::RNG::UNIFORM, 0.0, 1.0);
+
+	std::vector<std::string> names;
+	names.push_back("C");
+	names.push_back("W");
+	std::vector<cv::Mat> matrices;
+	matrices.push_back(centers);
+	// Non-continuous matrices are written row by row
+	matrices.push_back(weights.colRange(0, 99));
+
+	BinaryVocabFile::save("vocab_tmp.bin", "IKM", names, matrices);
+
+	EXPECT_TRUE(BinaryVocabFile::isBinaryVocab("vocab_tmp.bin"));
+
+	{
+		BinaryVocabFile file("vocab_tmp.bin");
+
+		EXPECT_EQ(std::string("IKM"), file.getType());
+
+		cv::Mat loadedCenters = file.getMatrix("C");
+		ASSERT_EQ(CV_8U, loadedCenters.type());
+		ASSERT_EQ(centers.size(), loadedCenters.size());
+		EXPECT_EQ(0, cv::countNonZero(centers != loadedCenters));
+
+		// Data is aligned for vectorized access
+		EXPECT_EQ(0u, size_t(loadedCenters.data) % 64);
+
+		cv::Mat loadedWeights = file.getMatrix("W");
+		ASSERT_EQ(CV_64F, loadedWeights.type());
+		ASSERT_EQ(99, loadedWeights.cols);
+		EXPECT_EQ(0, cv::countNonZero(weights.colRange(0, 99) != loadedWeights));
+
+		EXPECT_THROW(file.getMatrix("R"), std::runtime_error);
+	}
+
+	remove("vocab_tmp.bin");
+
+}
+
+TEST(BinaryVocabFile, Detection) {
+
+	EXPECT_TRUE(BinaryVocabFile::hasBinaryExtension("vocab.bin"));
+	EXPECT_FALSE(BinaryVocabFile::hasBinaryExtension("vocab.yaml.gz"));
+
+	// Text files and missing files are not binary vocabularies
+	FILE* f = fopen("vocab_tmp.yaml", "w");
+	fputs("%YAML:1.0\ntype: AKMAJ\n", f);
+	fclose(f);
+
+	EXPECT_FALSE(BinaryVocabFile::isBinaryVocab("vocab_tmp.yaml"));
+	EXPECT_FALSE(BinaryVocabFile::isBinaryVocab("missing_vocab.bin"));
+	EXPECT_THROW(BinaryVocabFile("vocab_tmp.yaml"), std::runtime_error);
+
+	remove("vocab_tmp.yaml");
+
+}
@@ -0,0 +1,63 @@
+/*
+ * BoundedQueue_test.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: andresf
+ */
+
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <BoundedQueue.hpp>
+
+TEST(BoundedQueue, PushPop) {
+
+	BoundedQueue<int> queue(4);
+
+	queue.push(1);
+	queue.push(2);
+
+	EXPECT_EQ(size_t(2), queue.size());
+
+	int item = 0;
+	EXPECT_TRUE(queue.pop(item));
+	EXPECT_EQ(1, item);
+	EXPECT_TRUE(queue.pop(item));
+	EXPECT_EQ(2, item);
+
+	queue.close();
+
+	EXPECT_FALSE(queue.pop(item));
+	EXPECT_ANY_THROW(queue.push(3));
+}
+
+TEST(BoundedQueue, ProducerConsumer) {
+
+	BoundedQueue<int> queue(2);
+
+	const int numItems = 1000;
+
+	std::thread producer([&queue, numItems] {
+		for (int i = 0; i < numItems; ++i) {
+			queue.push(i);
+			EXPECT_TRUE(queue.size() <= queue.capacity());
+		}
+		queue.close();
+	});
+
+	// Items are received in order and none is lost
+	std::vector<int> received;
+	int item;
+	while (queue.pop(item)) {
+		received.push_back(item);
+	}
+
+	producer.join();
+
+	ASSERT_EQ(size_t(numItems), received.size());
+	for (int i = 0; i < numItems; ++i) {
+		EXPECT_EQ(i, received[i]);
+	}
+}
@@ -0,0 +1,113 @@
+/*
+ * IOKeypoints_test.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: andresf
+ */
+
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/features2d/features2d.hpp>
+
+#include <FileUtils.hpp>
+
+TEST(KeypointsIOBin, LoadSave) {
+
+	std::vector<cv::KeyPoint> original;
+	cv::RNG rng(0xFFFFFFFF);
+	for (int i = 0; i < 1000; ++i) {
+		original.push_back(
+				cv::KeyPoint(rng.uniform(0.0f, 1024.0f),
+						rng.uniform(0.0f, 768.0f), rng.uniform(1.0f, 64.0f),
+						i % 10 == 0 ? -1.0f : rng.uniform(0.0f, 360.0f),
+						rng.uniform(0.0f, 100.0f), rng.uniform(0, 8)));
+	}
+
+	FileUtils::saveKeypoints("keypoints_tmp.kpt.bin", original);
+
+	std::vector<cv::KeyPoint> loaded;
+	FileUtils::loadKeypoints("keypoints_tmp.kpt.bin", loaded);
+
+	ASSERT_EQ(original.size(), loaded.size());
+
+	// Binary keypoints are stored exactly
+	for (size_t i = 0; i < original.size(); ++i) {
+		EXPECT_EQ(original[i].pt.x, loaded[i].pt.x);
+		EXPECT_EQ(original[i].pt.y, loaded[i].pt.y);
+		EXPECT_EQ(original[i].size, loaded[i].size);
+		EXPECT_EQ(original[i].angle, loaded[i].angle);
+		EXPECT_EQ(original[i].response, loaded[i].response);
+		EXPECT_EQ(original[i].octave, loaded[i].octave);
+	}
+
+	std::remove("keypoints_tmp.kpt.bin");
+
+}
+
+TEST(KeypointsIOBin, Empty) {
+
+	std::vector<cv::KeyPoint> original, loaded(3);
+
+	FileUtils::saveKeypoints("keypoints_empty_tmp.kpt.bin", original);
+	FileUtils::loadKeypoints("keypoints_empty_tmp.kpt.bin", loaded);
+
+	EXPECT_TRUE(loaded.empty());
+
+	std::remove("keypoints_empty_tmp.kpt.bin");
+
+}
+
+TEST(KeypointsIOBin, Truncated) {
+
+	std::vector<cv::KeyPoint> original(10, cv::KeyPoint(1.0f, 2.0f, 3.0f));
+	FileUtils::saveKeypoints("keypoints_truncated_tmp.kpt.bin", original);
+
+	// Drop the last keypoint record
+	FILE* file = fopen("keypoints_truncated_tmp.kpt.bin", "r+");
+	ASSERT_TRUE(file != NULL);
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	ASSERT_EQ(0, ftruncate(fileno(file), size - (5 * sizeof(float) + sizeof(int))));
+	fclose(file);
+
+	std::vector<cv::KeyPoint> loaded;
+	EXPECT_THROW(FileUtils::loadKeypoints("keypoints_truncated_tmp.kpt.bin", loaded),
+			std::runtime_error);
+
+	std::remove("keypoints_truncated_tmp.kpt.bin");
+
+}
+
+TEST(KeypointsIOBin, RejectDescriptors) {
+
+	// Descriptors files share the .bin extension but not the keypoints magic
+	std::vector<cv::KeyPoint> loaded;
+	EXPECT_THROW(FileUtils::loadKeypoints("brief_0.bin", loaded),
+			std::runtime_error);
+
+}
+
+TEST(KeypointsIOYaml, LoadSave) {
+
+	std::vector<cv::KeyPoint> original;
+	original.push_back(cv::KeyPoint(10.5f, 20.25f, 7.0f, 45.0f, 0.5f, 1));
+	original.push_back(cv::KeyPoint(0.0f, 1.0f, 3.0f, -1.0f, 12.0f, 0));
+
+	FileUtils::saveKeypoints("keypoints_tmp.yaml.gz", original);
+
+	std::vector<cv::KeyPoint> loaded;
+	FileUtils::loadKeypoints("keypoints_tmp.yaml.gz", loaded);
+
+	ASSERT_EQ(original.size(), loaded.size());
+	for (size_t i = 0; i < original.size(); ++i) {
+		EXPECT_FLOAT_EQ(original[i].pt.x, loaded[i].pt.x);
+		EXPECT_FLOAT_EQ(original[i].pt.y, loaded[i].pt.y);
+		EXPECT_EQ(original[i].octave, loaded[i].octave);
+	}
+
+	std::remove("keypoints_tmp.yaml.gz");
+
+}
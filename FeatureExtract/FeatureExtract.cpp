@@ -5,15 +5,25 @@
  *      Author: andresf
  */
 
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
 #include <dirent.h>
 #include <fstream>
+#include <functional>
+#include <mutex>
 #include <stdexcept>
 #include <stdlib.h>
 #include <string>
+#include <thread>
+#include <unordered_set>
 #include <vector>
 
+#include <BoundedQueue.hpp>
 #include <FileUtils.hpp>
 
+#include <ImageReader.hpp>
+
 #include <opencv2/core/internal.hpp>
 #include <opencv2/extensions/features2d.hpp>
 #include <opencv2/flann/logger.h>
@@ -23,6 +33,22 @@
 
 double mytime;
 
+/**
+ * Features of an image handed from the workers to the writer.
+ */
+struct ImageFeatures {
+	// Name of the image file
+	std::string image;
+	std::vector<cv::KeyPoint> keypoints;
+	cv::Mat descriptors;
+};
+
+// Processes an image given the index of the worker running it and the image name
+typedef std::function<void(int, const std::string&, ImageFeatures&)> ProcessFunction;
+
+// Writes the features of an image
+typedef std::function<void(ImageFeatures&)> WriteFunction;
+
 /**
  * Verify candidate algorithm is a valid OpenCV algorithm.
  *
@@ -32,60 +58,190 @@ double mytime;
 bool isValidAlgorithm(std::string& candidateAlgorithm);
 
 /**
- * Detect features from an image using some OpenCV supported detector.
+ * Decode an image in gray scale.
  *
+ * @param reader - Decoder, possibly at a reduced resolution
  * @param imgPath - Path to the images folder
  * @param imgName - Name of the image
+ * @param scale - Output factors mapping the decoded image onto the full resolution one
+ * @return The decoded image
+ */
+cv::Mat readImage(const ImageReader& reader, const std::string& imgPath,
+		const std::string& imgName, cv::Point2f& scale);
+
+/**
+ * Scales the position and size of key-points, e.g. from a reduced resolution image
+ * to the full resolution one.
+ *
+ * @param keyPoints - Vector of key-points scaled in place
+ * @param scale - Factors along x and y, the size is scaled by their mean
+ */
+void scaleKeypoints(std::vector<cv::KeyPoint>& keyPoints,
+		const cv::Point2f& scale);
+
+/**
+ * Detect features from an image using some OpenCV supported detector.
+ *
+ * @param img - Gray scale image
+ * @param imgName - Name of the image
  * @param keyPoints - Vector of key-points
- * @param detectorType - Detector algorithm name
+ * @param detector - Feature detector, not shared among threads
  */
-void detectFeatures(const std::string& imgPath, const std::string& imgName,
-		std::vector<cv::KeyPoint>& keyPoints, const std::string detectorType);
+void detectFeatures(const cv::Mat& img, const std::string& imgName,
+		std::vector<cv::KeyPoint>& keyPoints,
+		cv::Ptr<cv::FeatureDetector>& detector);
 
 /**
  * Extract descriptor from the at the indicated key-point positions.
  *
- * @param imgPath - Path to the images folder
+ * @param img - Gray scale image
  * @param imgName - Name of the image
  * @param keyPoints - Vector of key-points
  * @param descriptors - Matrix where to save extracted descriptors
- * @param descriptorType - Descriptor algorithm name
+ * @param extractor - Descriptor extractor, not shared among threads
  */
-void describeFeatures(const std::string& imgPath, const std::string& imgName,
+void describeFeatures(const cv::Mat& img, const std::string& imgName,
 		std::vector<cv::KeyPoint>& keyPoints, cv::Mat& descriptors,
-		const std::string descriptorType);
+		cv::Ptr<cv::DescriptorExtractor>& extractor);
 
 /**
- * In a given folder finds the last written file of the given extension that is also a valid image file.
+ * Lists the images whose output file of the given extension is not yet in a folder.
+ *
+ * Outputs are written atomically, hence an existing file is a complete one and the
+ * image it was computed from can be skipped regardless of the order the images
+ * were processed in.
  *
  * @param folderPath - Path to the folder where to search
  * @param imgFolderFiles - Vector of images names
- * @param extension
+ * @param extension - Extension of the output files
+ * @param pendingImages - Output vector of the names of the images left to process
+ */
+void findPendingImages(const std::string& folderPath,
+		const std::vector<std::string>& imgFolderFiles,
+		const std::string& extension, std::vector<std::string>& pendingImages);
+
+/**
+ * Saves a file under a temporary hidden name in the same folder and then renames it,
+ * so that an interrupted run never leaves a truncated file behind.
  *
- * @return an iterator to the image where the last written file is positioned
+ * @param filename - Final name of the file
+ * @param save - Function writing the file to the name it is given
  */
-std::vector<std::string>::iterator findLastWrittenFile(
-		const std::string& folderPath, std::vector<std::string>& imgFolderFiles,
-		const std::string& extension);
+void saveAtomically(const std::string& filename,
+		const std::function<void(const std::string&)>& save);
+
+/**
+ * Saves the key-points and the descriptors of an image. The key-points go first, hence
+ * the descriptors file marks the image as done.
+ *
+ * @param features - Features of the image
+ * @param descriptorsFolder - Folder where to save the descriptors
+ * @param keypointsFolder - Folder where to save the key-points
+ * @param keysExtension - Extension of the key-points file, .bin for binary format
+ */
+void saveFeatures(ImageFeatures& features, const std::string& descriptorsFolder,
+		const std::string& keypointsFolder, const std::string& keysExtension);
+
+/**
+ * Runs process over the images on a pool of worker threads and hands the results to
+ * write on the calling thread through a bounded queue, so that a slow disk throttles
+ * the workers instead of piling up features in memory.
+ *
+ * @param images - Names of the images to process
+ * @param numThreads - Number of worker threads
+ * @param queueSize - Maximum number of processed images waiting to be written
+ * @param process - Function run by the workers
+ * @param write - Function run by the writer
+ */
+void processImages(const std::vector<std::string>& images, int numThreads,
+		int queueSize, const ProcessFunction& process,
+		const WriteFunction& write);
 
 int main(int argc, char **argv) {
 
-	if (argc != 5 && argc != 7) {
+	std::string option = argc > 1 ? argv[1] : "";
+	int optsPos =
+			option.compare("-extract") == 0
+					|| option.compare("-detextract") == 0 ? 7 : 5;
+
+	if (argc < optsPos
+			|| (argc > optsPos && std::string(argv[optsPos]).compare("-opts") != 0)) {
 		printf(
 				"\nUsage:\n"
-						"\tFeatureExtract -detect <in.detector.type> <in.imgs.folder> <out.keypoints.folder>\n"
-						"\tFeatureExtract -extract <in.descriptor.type> <in.imgs.folder> <in.keypoints.folder> <out.descriptors.folder> <out.keypoints.folder>\n\n");
+						"\tFeatureExtract -detect <in.detector.type> <in.imgs.folder> <out.keypoints.folder> [-opts <key>=<value>]\n"
+						"\tFeatureExtract -extract <in.descriptor.type> <in.imgs.folder> <in.keypoints.folder> <out.descriptors.folder> <out.keypoints.folder> [-opts <key>=<value>]\n"
+						"\tFeatureExtract -detextract <in.detector.type> <in.descriptor.type> <in.imgs.folder> <out.descriptors.folder> <out.keypoints.folder> [-opts <key>=<value>]\n\n"
+						"Options:\n"
+						"\tnum.threads=1\t\tqueue.size=<2 * num.threads>\n"
+						"\tkeys.extension=.yaml.gz (.kpt.bin for -detextract)\n"
+						"\tmax.side=0\n\n"
+						"Modes:\n"
+						"\t-detextract decodes every image once to both detect and describe it\n"
+						"\tKey-points files with the extension .bin are stored in binary format,\n"
+						"\tdescriptors files take <image>.bin hence key-points may not use .bin alone\n\n"
+						"Resolution:\n"
+						"\tImages are processed with their longest side reduced to max.side, 0 keeps\n"
+						"\tthe full resolution. JPEG files are decoded directly at 1/2, 1/4 or 1/8 of\n"
+						"\ttheir resolution when possible. Saved key-points are always in full\n"
+						"\tresolution coordinates\n\n"
+						"Resume:\n"
+						"\tImages whose output files already exist are skipped, outputs are written\n"
+						"\tunder a temporary name and renamed once complete\n\n");
 		return EXIT_FAILURE;
 	}
 
+	int numThreads = 1;
+	int queueSize = -1;
+	int maxSide = 0;
+	std::string keysExtension =
+			option.compare("-detextract") == 0 ? ".kpt.bin" : ".yaml.gz";
+
+	for (int var = optsPos + 1; var < argc; ++var) {
+		std::string arg = argv[var];
+		size_t delimPos = arg.find("=");
+		CV_Assert(delimPos != std::string::npos);
+		std::string key = arg.substr(0, delimPos);
+		std::string value = arg.substr(delimPos + 1, arg.length());
+		if (key.compare("num.threads") == 0) {
+			numThreads = atoi(value.c_str());
+		} else if (key.compare("queue.size") == 0) {
+			queueSize = atoi(value.c_str());
+		} else if (key.compare("keys.extension") == 0) {
+			keysExtension = value;
+		} else if (key.compare("max.side") == 0) {
+			maxSide = atoi(value.c_str());
+		} else {
+			fprintf(stderr, "Unknown option [%s]\n", key.c_str());
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Descriptors are saved as <image>.bin, key-points by that name would overwrite them
+	if (option.compare("-detect") != 0 && keysExtension.compare(".bin") == 0) {
+		fprintf(stderr, "Key-points extension [.bin] is taken by the descriptors,"
+				" use e.g. [.kpt.bin]\n");
+		return EXIT_FAILURE;
+	}
+
+	if (numThreads <= 0) {
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	if (queueSize <= 0) {
+		queueSize = 2 * numThreads;
+	}
+
+	ImageReader reader(maxSide);
+	if (maxSide > 0) {
+		printf("-- Decoding images with their longest side reduced to [%d]\n",
+				maxSide);
+	}
+
 	// Initialize 2d features extensions mode, necessary for using AGAST and DBRIEF
 	cv::initModule_features2d_extensions();
 
 	// Initialize non-free module, necessary for using SIFT and SURF
 	cv::initModule_nonfree();
 
-	std::string option = argv[1];
-
 	if (option.compare("-detect") == 0) {
 		std::string detectorType = argv[2];
 		std::string imgsFolder = argv[3];
@@ -100,7 +256,14 @@ int main(int argc, char **argv) {
 			return EXIT_FAILURE;
 		}
 
-		printf("-- Using [%s] detector\n", detectorType.c_str());
+		printf("-- Using [%s] detector, num.threads=[%d] queue.size=[%d]\n",
+				detectorType.c_str(), numThreads, queueSize);
+
+		// One detector per worker, algorithms keep state and are not thread-safe
+		std::vector<cv::Ptr<cv::FeatureDetector> > detectors;
+		for (int t = 0; t < numThreads; ++t) {
+			detectors.push_back(cv::FeatureDetector::create(detectorType));
+		}
 
 		/* Load files from images folder into a vector */
 		printf("-- Loading images in folder [%s]\n", imgsFolder.c_str());
@@ -115,53 +278,50 @@ int main(int argc, char **argv) {
 			return EXIT_FAILURE;
 		}
 
-		/* Finding last written key-points file */
+		/* Finding already written key-points files */
 		printf(
 				"-- Searching for previous written key files in [%s] to resume feature detection\n",
 				keypointsFolder.c_str());
 
-		// By default set to the first file
-		std::vector<std::string>::iterator startImg = findLastWrittenFile(
-				keypointsFolder, imgFolderFiles, ".yaml.gz");
-
-		if (startImg == imgFolderFiles.begin()) {
-			printf("   Starting feature extraction from first image\n");
-		} else {
-			printf("   Restarting feature extraction from image [%s]\n",
-					(*startImg).c_str());
+		std::vector<std::string> pendingImages;
+		try {
+			findPendingImages(keypointsFolder, imgFolderFiles, keysExtension,
+					pendingImages);
+		} catch (const std::runtime_error& error) {
+			fprintf(stderr, "%s\n", error.what());
+			return EXIT_FAILURE;
 		}
 
-		std::vector<cv::KeyPoint> keypoints;
+		printf("   Found [%lu] images left to process\n", pendingImages.size());
 
 		/* Extracting features */
-		for (std::vector<std::string>::iterator image = startImg;
-				image != imgFolderFiles.end(); ++image) {
-			if ((*image).find(".jpg") != std::string::npos) {
-				printf("-- Processing image [%s]\n", (*image).c_str());
-
-				try {
-					// Note: number of key-points might be reduced due to border effect
-					detectFeatures(imgsFolder, *image, keypoints, detectorType);
-				} catch (const std::runtime_error& error) {
-					fprintf(stderr, "%s\n", error.what());
-					return EXIT_FAILURE;
-				}
-
-				std::string keypointsFileName = keypointsFolder + "/"
-						+ (*image).substr(0, (*image).size() - 4) + ".yaml.gz";
-
-				printf(
-						"-- Saving feature key-points to [%s] using OpenCV FileStorage\n",
-						keypointsFileName.c_str());
-
-				try {
-					FileUtils::saveKeypoints(keypointsFileName, keypoints);
-				} catch (const std::runtime_error& error) {
-					fprintf(stderr, "%s\n", error.what());
-					return EXIT_FAILURE;
-				}
-
-			}
+		try {
+			processImages(pendingImages, numThreads, queueSize,
+					[&](int worker, const std::string& image,
+							ImageFeatures& features) {
+						printf("-- Processing image [%s]\n", image.c_str());
+						cv::Point2f scale;
+						cv::Mat img = readImage(reader, imgsFolder, image, scale);
+						// Note: number of key-points might be reduced due to border effect
+						detectFeatures(img, image, features.keypoints,
+								detectors[worker]);
+						scaleKeypoints(features.keypoints, scale);
+					}, [&](ImageFeatures& features) {
+						std::string keypointsFileName = keypointsFolder + "/"
+						+ features.image.substr(0, features.image.size() - 4)
+						+ keysExtension;
+
+						printf("-- Saving feature key-points to [%s]\n",
+								keypointsFileName.c_str());
+
+						saveAtomically(keypointsFileName,
+								[&](const std::string& filename) {
+									FileUtils::saveKeypoints(filename, features.keypoints);
+								});
+					});
+		} catch (const std::exception& error) {
+			fprintf(stderr, "%s\n", error.what());
+			return EXIT_FAILURE;
 		}
 
 	} else if (option.compare("-extract") == 0) {
@@ -180,7 +340,15 @@ int main(int argc, char **argv) {
 			return EXIT_FAILURE;
 		}
 
-		printf("-- Using [%s] descriptor\n", descriptorType.c_str());
+		printf("-- Using [%s] descriptor, num.threads=[%d] queue.size=[%d]\n",
+				descriptorType.c_str(), numThreads, queueSize);
+
+		// One extractor per worker, algorithms keep state and are not thread-safe
+		std::vector<cv::Ptr<cv::DescriptorExtractor> > extractors;
+		for (int t = 0; t < numThreads; ++t) {
+			extractors.push_back(
+					cv::DescriptorExtractor::create(descriptorType));
+		}
 
 		/* Load files from images folder into a vector */
 		printf("-- Loading images in folder [%s]\n", imgsFolder.c_str());
@@ -195,86 +363,152 @@ int main(int argc, char **argv) {
 			return EXIT_FAILURE;
 		}
 
-		/* Finding last written descriptors file */
+		/* Finding already written descriptors files */
 		printf(
 				"-- Searching for previous written descriptors files in [%s] to resume feature extraction\n",
 				out_descriptorsFolder.c_str());
 
-		// By default set to the first file
-		std::vector<std::string>::iterator startImg = findLastWrittenFile(
-				out_descriptorsFolder, imgFolderFiles, ".bin");
-
-		if (startImg == imgFolderFiles.begin()) {
-			printf("   Starting feature extraction from first image\n");
-		} else {
-			printf("   Restarting feature extraction from image [%s]\n",
-					(*startImg).c_str());
+		std::vector<std::string> pendingImages;
+		try {
+			findPendingImages(out_descriptorsFolder, imgFolderFiles, ".bin",
+					pendingImages);
+		} catch (const std::runtime_error& error) {
+			fprintf(stderr, "%s\n", error.what());
+			return EXIT_FAILURE;
 		}
 
-		std::vector<cv::KeyPoint> keypoints;
-		cv::Mat descriptors;
+		printf("   Found [%lu] images left to process\n", pendingImages.size());
 
 		/* Extracting features */
-		for (std::vector<std::string>::iterator image = startImg;
-				image != imgFolderFiles.end(); ++image) {
-			if ((*image).find(".jpg") != std::string::npos) {
-				printf("-- Processing image [%s]\n", (*image).c_str());
-
-				std::string keypointsFileName = in_keypointsFolder + "/"
-						+ (*image).substr(0, (*image).size() - 4) + ".yaml.gz";
-
-				printf(
-						"   Loading feature key-points from [%s] using OpenCV FileStorage\n",
-						keypointsFileName.c_str());
-
-				try {
-					FileUtils::loadKeypoints(keypointsFileName, keypoints);
-				} catch (const std::runtime_error& error) {
-					fprintf(stderr, "%s\n", error.what());
-					return EXIT_FAILURE;
-				}
+		try {
+			processImages(pendingImages, numThreads, queueSize,
+					[&](int worker, const std::string& image,
+							ImageFeatures& features) {
+						printf("-- Processing image [%s]\n", image.c_str());
+
+						std::string keypointsFileName = in_keypointsFolder + "/"
+						+ image.substr(0, image.size() - 4) + keysExtension;
+
+						printf("   Loading feature key-points from [%s]\n",
+								keypointsFileName.c_str());
+
+						FileUtils::loadKeypoints(keypointsFileName,
+								features.keypoints);
+
+						// Key-points are saved in full resolution coordinates
+						cv::Point2f scale;
+						cv::Mat img = readImage(reader, imgsFolder, image, scale);
+						scaleKeypoints(features.keypoints,
+								cv::Point2f(1.0f / scale.x, 1.0f / scale.y));
+
+						// Note: number of key-points might be reduced due to border effect
+						describeFeatures(img, image, features.keypoints,
+								features.descriptors, extractors[worker]);
+						scaleKeypoints(features.keypoints, scale);
+						CV_Assert(
+								features.descriptors.rows >= 0
+								&& features.keypoints.size()
+								== (size_t ) features.descriptors.rows);
+					}, [&](ImageFeatures& features) {
+						saveFeatures(features, out_descriptorsFolder,
+								out_keypointsFolder, keysExtension);
+					});
+		} catch (const std::exception& error) {
+			fprintf(stderr, "%s\n", error.what());
+			return EXIT_FAILURE;
+		}
 
-				try {
-					// Note: number of key-points might be reduced due to border effect
-					describeFeatures(imgsFolder, *image, keypoints, descriptors,
-							descriptorType);
-					CV_Assert(
-							descriptors.rows >= 0
-									&& keypoints.size()
-											== (size_t )descriptors.rows);
-				} catch (const std::runtime_error& error) {
-					fprintf(stderr, "%s\n", error.what());
-					return EXIT_FAILURE;
-				}
+	} else if (option.compare("-detextract") == 0) {
+		std::string detectorType = argv[2];
+		std::string descriptorType = argv[3];
+		std::string imgsFolder = argv[4];
+		std::string out_descriptorsFolder = argv[5];
+		std::string out_keypointsFolder = argv[6];
+
+		if (isValidAlgorithm(detectorType) == false) {
+			fprintf(stderr,
+					"Input detector=[%s] is not a registered algorithm in OpenCV\n",
+					detectorType.c_str());
+			return EXIT_FAILURE;
+		}
 
-				std::string descriptorFileName = out_descriptorsFolder + "/"
-						+ (*image).substr(0, (*image).size() - 4) + ".bin";
+		if (isValidAlgorithm(descriptorType) == false) {
+			fprintf(stderr,
+					"Input descriptor=[%s] is not a registered algorithm in OpenCV\n",
+					descriptorType.c_str());
+			return EXIT_FAILURE;
+		}
 
-				printf("   Saving feature descriptors to [%s] using C++ STL\n",
-						descriptorFileName.c_str());
+		printf("-- Using [%s] detector and [%s] descriptor, num.threads=[%d] "
+				"queue.size=[%d]\n", detectorType.c_str(), descriptorType.c_str(),
+				numThreads, queueSize);
+
+		// One detector and extractor per worker, algorithms keep state and are not thread-safe
+		std::vector<cv::Ptr<cv::FeatureDetector> > detectors;
+		std::vector<cv::Ptr<cv::DescriptorExtractor> > extractors;
+		for (int t = 0; t < numThreads; ++t) {
+			detectors.push_back(cv::FeatureDetector::create(detectorType));
+			extractors.push_back(
+					cv::DescriptorExtractor::create(descriptorType));
+		}
 
-				try {
-					FileUtils::saveDescriptors(descriptorFileName, descriptors);
-				} catch (const std::runtime_error& error) {
-					fprintf(stderr, "%s\n", error.what());
-					return EXIT_FAILURE;
-				}
+		/* Load files from images folder into a vector */
+		printf("-- Loading images in folder [%s]\n", imgsFolder.c_str());
 
-				keypointsFileName = out_keypointsFolder + "/"
-						+ (*image).substr(0, (*image).size() - 4) + ".yaml.gz";
+		std::vector<std::string> imgFolderFiles;
+		try {
+			printf("   Opening directory [%s]\n", imgsFolder.c_str());
+			FileUtils::readFolder(imgsFolder.c_str(), imgFolderFiles);
+			printf("   Found [%lu] files\n", imgFolderFiles.size());
+		} catch (const std::runtime_error& error) {
+			fprintf(stderr, "%s\n", error.what());
+			return EXIT_FAILURE;
+		}
 
-				printf(
-						"-- Saving feature key-points to [%s] using OpenCV FileStorage\n",
-						keypointsFileName.c_str());
+		/* Finding already written descriptors files */
+		printf(
+				"-- Searching for previous written descriptors files in [%s] to resume feature extraction\n",
+				out_descriptorsFolder.c_str());
 
-				try {
-					FileUtils::saveKeypoints(keypointsFileName, keypoints);
-				} catch (const std::runtime_error& error) {
-					fprintf(stderr, "%s\n", error.what());
-					return EXIT_FAILURE;
-				}
+		std::vector<std::string> pendingImages;
+		try {
+			findPendingImages(out_descriptorsFolder, imgFolderFiles, ".bin",
+					pendingImages);
+		} catch (const std::runtime_error& error) {
+			fprintf(stderr, "%s\n", error.what());
+			return EXIT_FAILURE;
+		}
 
-			}
+		printf("   Found [%lu] images left to process\n", pendingImages.size());
+
+		/* Detecting and extracting features from a single decoding */
+		try {
+			processImages(pendingImages, numThreads, queueSize,
+					[&](int worker, const std::string& image,
+							ImageFeatures& features) {
+						printf("-- Processing image [%s]\n", image.c_str());
+
+						cv::Point2f scale;
+						cv::Mat img = readImage(reader, imgsFolder, image, scale);
+
+						detectFeatures(img, image, features.keypoints,
+								detectors[worker]);
+
+						// Note: number of key-points might be reduced due to border effect
+						describeFeatures(img, image, features.keypoints,
+								features.descriptors, extractors[worker]);
+						scaleKeypoints(features.keypoints, scale);
+						CV_Assert(
+								features.descriptors.rows >= 0
+								&& features.keypoints.size()
+								== (size_t ) features.descriptors.rows);
+					}, [&](ImageFeatures& features) {
+						saveFeatures(features, out_descriptorsFolder,
+								out_keypointsFolder, keysExtension);
+					});
+		} catch (const std::exception& error) {
+			fprintf(stderr, "%s\n", error.what());
+			return EXIT_FAILURE;
 		}
 
 	} else {
@@ -305,20 +539,39 @@ bool isValidAlgorithm(std::string& candidateAlgorithm) {
 	return isValid;
 }
 
-void detectFeatures(const std::string& imgPath, const std::string& imgName,
-		std::vector<cv::KeyPoint>& keyPoints, const std::string detectorType) {
+cv::Mat readImage(const ImageReader& reader, const std::string& imgPath,
+		const std::string& imgName, cv::Point2f& scale) {
 
-	cv::Mat img = cv::imread(imgPath + std::string("/") + imgName,
-			CV_LOAD_IMAGE_GRAYSCALE);
+	cv::Mat img = reader.read(imgPath + std::string("/") + imgName, scale);
 
 	if (!img.data) {
 		throw std::runtime_error(
 				"Error while reading image [" + imgPath + "/" + imgName + "]");
 	}
 
-	// Create smart pointer for feature detector
-	cv::Ptr<cv::FeatureDetector> detector = cv::FeatureDetector::create(
-			detectorType);
+	return img;
+}
+
+void scaleKeypoints(std::vector<cv::KeyPoint>& keyPoints,
+		const cv::Point2f& scale) {
+
+	// Full resolution images are left untouched
+	if (scale.x == 1.0f && scale.y == 1.0f) {
+		return;
+	}
+
+	float sizeScale = 0.5f * (scale.x + scale.y);
+	for (cv::KeyPoint& k : keyPoints) {
+		k.pt.x *= scale.x;
+		k.pt.y *= scale.y;
+		k.size *= sizeScale;
+	}
+
+}
+
+void detectFeatures(const cv::Mat& img, const std::string& imgName,
+		std::vector<cv::KeyPoint>& keyPoints,
+		cv::Ptr<cv::FeatureDetector>& detector) {
 
 //	detector->set("thres", 10);
 
@@ -335,27 +588,11 @@ void detectFeatures(const std::string& imgPath, const std::string& imgName,
 	//	printf("-- Detected [%zu] key-points in [%lf] ms\n", keypoints.size(),
 	//			mytime);
 
-	img.release();
-	img = cv::Mat();
-
 }
 
-void describeFeatures(const std::string& imgPath, const std::string& imgName,
+void describeFeatures(const cv::Mat& img, const std::string& imgName,
 		std::vector<cv::KeyPoint>& keyPoints, cv::Mat& descriptors,
-		const std::string descriptorType) {
-
-	cv::Mat img = cv::imread(imgPath + std::string("/") + imgName,
-			CV_LOAD_IMAGE_GRAYSCALE);
-
-	if (!img.data) {
-		throw std::runtime_error(
-				"Error reading image [" + imgPath + std::string("/") + imgName
-						+ "]");
-	}
-
-	// Create smart pointer for descriptor extractor
-	cv::Ptr<cv::DescriptorExtractor> extractor =
-			cv::DescriptorExtractor::create(descriptorType);
+		cv::Ptr<cv::DescriptorExtractor>& extractor) {
 
 	descriptors.release();
 	descriptors = cv::Mat();
@@ -376,44 +613,138 @@ void describeFeatures(const std::string& imgPath, const std::string& imgName,
 	//			descriptors.rows, descriptors.cols,
 	//			descriptors.type() == CV_8U ? "binary" : "real-valued", mytime);
 
-	img.release();
-	img = cv::Mat();
-
 }
 
-std::vector<std::string>::iterator findLastWrittenFile(
-		const std::string& folderPath, std::vector<std::string>& imgFolderFiles,
-		const std::string& extension) {
-
-	// By default set to the first file
-	std::vector<std::string>::iterator lastWrittenFile = imgFolderFiles.begin();
+void findPendingImages(const std::string& folderPath,
+		const std::vector<std::string>& imgFolderFiles,
+		const std::string& extension, std::vector<std::string>& pendingImages) {
 
 	// Load files from folder into a vector
 	std::vector<std::string> folderFiles;
-	try {
-		FileUtils::readFolder(folderPath.c_str(), folderFiles);
-	} catch (const std::runtime_error& error) {
-		throw std::runtime_error(error.what());
-	}
-
-	// Sort loaded files in reverse order
-	std::sort(folderFiles.begin(), folderFiles.end(),
-			std::greater<std::string>());
+	FileUtils::readFolder(folderPath.c_str(), folderFiles);
 
-	// Search for a file with the given extension
+	// Images for which a file with the given extension was written
+	std::unordered_set<std::string> writtenImages;
 	for (std::string& folderFile : folderFiles) {
-		if (folderFile.find(extension) != std::string::npos) {
-			std::vector<std::string>::iterator result = std::find(
-					imgFolderFiles.begin(), imgFolderFiles.end(),
-					folderFile.substr(0, folderFile.size() - extension.length())
+		if (folderFile.size() > extension.size()
+				&& folderFile.compare(folderFile.size() - extension.size(),
+						extension.size(), extension) == 0) {
+			writtenImages.insert(
+					folderFile.substr(0, folderFile.size() - extension.size())
 							+ ".jpg");
-			if (result != imgFolderFiles.end()) {
-				// Found element
-				lastWrittenFile = result;
-				break;
+		}
+	}
+
+	pendingImages.clear();
+	for (const std::string& image : imgFolderFiles) {
+		if (image.find(".jpg") != std::string::npos
+				&& writtenImages.find(image) == writtenImages.end()) {
+			pendingImages.push_back(image);
+		}
+	}
+
+}
+
+void saveAtomically(const std::string& filename,
+		const std::function<void(const std::string&)>& save) {
+
+	// Keep the extension, FileStorage picks the format and compression after it
+	size_t slashPos = filename.find_last_of('/');
+	std::string tmpFilename =
+			slashPos == std::string::npos ?
+					"." + filename :
+					filename.substr(0, slashPos + 1) + "."
+							+ filename.substr(slashPos + 1);
+
+	save(tmpFilename);
+
+	FileUtils::replaceFile(tmpFilename, filename);
+
+}
+
+void saveFeatures(ImageFeatures& features, const std::string& descriptorsFolder,
+		const std::string& keypointsFolder, const std::string& keysExtension) {
+
+	std::string baseName = features.image.substr(0, features.image.size() - 4);
+
+	std::string keypointsFileName = keypointsFolder + "/" + baseName
+			+ keysExtension;
+
+	printf("-- Saving feature key-points to [%s]\n", keypointsFileName.c_str());
+
+	saveAtomically(keypointsFileName, [&](const std::string& filename) {
+		FileUtils::saveKeypoints(filename, features.keypoints);
+	});
+
+	std::string descriptorFileName = descriptorsFolder + "/" + baseName + ".bin";
+
+	printf("   Saving feature descriptors to [%s] using C++ STL\n",
+			descriptorFileName.c_str());
+
+	saveAtomically(descriptorFileName, [&](const std::string& filename) {
+		FileUtils::saveDescriptors(filename, features.descriptors);
+	});
+
+}
+
+void processImages(const std::vector<std::string>& images, int numThreads,
+		int queueSize, const ProcessFunction& process,
+		const WriteFunction& write) {
+
+	BoundedQueue<ImageFeatures> queue(queueSize);
+	std::atomic<size_t> nextImage(0);
+	std::atomic<int> runningWorkers(numThreads);
+
+	// The first error stops the whole pool
+	std::mutex errorMutex;
+	std::string error;
+	auto setError = [&](const std::string& what) {
+		std::lock_guard<std::mutex> lock(errorMutex);
+		if (error.empty()) {
+			error = what;
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (int t = 0; t < numThreads; ++t) {
+		workers.push_back(std::thread([&, t]() {
+			try {
+				for (size_t i = nextImage++; i < images.size(); i = nextImage++) {
+					ImageFeatures features;
+					features.image = images[i];
+					process(t, images[i], features);
+					queue.push(std::move(features));
+				}
+			} catch (const std::exception& e) {
+				// Pushing fails once the queue is closed because of an earlier error
+				setError(e.what());
+				queue.close();
+			}
+			// The last worker done lets the writer drain the queue and stop
+			if (--runningWorkers == 0) {
+				queue.close();
 			}
+		}));
+	}
+
+	ImageFeatures features;
+	while (queue.pop(features)) {
+		try {
+			write(features);
+		} catch (const std::exception& e) {
+			setError(e.what());
+			break;
 		}
 	}
 
-	return lastWrittenFile;
+	// Unblock the workers if writing stopped early
+	queue.close();
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+
+	if (error.empty() == false) {
+		throw std::runtime_error(error);
+	}
+
 }
@@ -0,0 +1,143 @@
+/*
+ * ImageReader.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: andresf
+ */
+
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+
+#include <jpeglib.h>
+
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <ImageReader.hpp>
+
+/**
+ * libjpeg error manager jumping back to the decoder instead of exiting.
+ */
+struct JpegErrorManager {
+	struct jpeg_error_mgr pub;
+	jmp_buf setjmpBuffer;
+};
+
+static void jpegErrorExit(j_common_ptr cinfo) {
+	JpegErrorManager* err = (JpegErrorManager*) cinfo->err;
+	longjmp(err->setjmpBuffer, 1);
+}
+
+static void jpegOutputMessage(j_common_ptr) {
+	// Warnings are silenced, errors end up in jpegErrorExit
+}
+
+static bool hasJpegExtension(const std::string& filename) {
+	size_t dotPos = filename.find_last_of('.');
+	if (dotPos == std::string::npos) {
+		return false;
+	}
+	std::string extension = filename.substr(dotPos + 1);
+	return extension.compare("jpg") == 0 || extension.compare("jpeg") == 0
+			|| extension.compare("JPG") == 0 || extension.compare("JPEG") == 0;
+}
+
+// --------------------------------------------------------------------------
+
+ImageReader::ImageReader(int maxSide) :
+		m_maxSide(maxSide) {
+}
+
+// --------------------------------------------------------------------------
+
+cv::Mat ImageReader::read(const std::string& filename,
+		cv::Point2f& scale) const {
+
+	cv::Mat img;
+	cv::Size originalSize;
+
+	if (m_maxSide <= 0 || hasJpegExtension(filename) == false
+			|| readJpeg(filename, img, originalSize) == false) {
+		img = cv::imread(filename, CV_LOAD_IMAGE_GRAYSCALE);
+		originalSize = img.size();
+	}
+
+	if (!img.data) {
+		return img;
+	}
+
+	// Finish the reduction DCT scaling could not do on its own
+	int side = std::max(img.cols, img.rows);
+	if (m_maxSide > 0 && side > m_maxSide) {
+		double factor = double(m_maxSide) / side;
+		cv::Mat resized;
+		cv::resize(img, resized,
+				cv::Size(std::max(1, cvRound(img.cols * factor)),
+						std::max(1, cvRound(img.rows * factor))), 0, 0,
+				cv::INTER_AREA);
+		img = resized;
+	}
+
+	scale.x = float(originalSize.width) / img.cols;
+	scale.y = float(originalSize.height) / img.rows;
+
+	return img;
+}
+
+// --------------------------------------------------------------------------
+
+bool ImageReader::readJpeg(const std::string& filename, cv::Mat& img,
+		cv::Size& originalSize) const {
+
+	FILE* file = fopen(filename.c_str(), "rb");
+	if (file == NULL) {
+		return false;
+	}
+
+	struct jpeg_decompress_struct cinfo;
+	JpegErrorManager jerr;
+
+	cinfo.err = jpeg_std_error(&jerr.pub);
+	jerr.pub.error_exit = jpegErrorExit;
+	jerr.pub.output_message = jpegOutputMessage;
+
+	if (setjmp(jerr.setjmpBuffer)) {
+		jpeg_destroy_decompress(&cinfo);
+		fclose(file);
+		img.release();
+		return false;
+	}
+
+	jpeg_create_decompress(&cinfo);
+	jpeg_stdio_src(&cinfo, file);
+	jpeg_read_header(&cinfo, TRUE);
+
+	originalSize = cv::Size(cinfo.image_width, cinfo.image_height);
+
+	// Strongest DCT reduction keeping the longest side at least maxSide
+	int side = std::max(int(cinfo.image_width), int(cinfo.image_height));
+	int denom = 1;
+	while (denom < 8 && (side + 2 * denom - 1) / (2 * denom) >= m_maxSide) {
+		denom *= 2;
+	}
+
+	cinfo.scale_num = 1;
+	cinfo.scale_denom = denom;
+	cinfo.out_color_space = JCS_GRAYSCALE;
+
+	jpeg_start_decompress(&cinfo);
+
+	img.create(cinfo.output_height, cinfo.output_width, CV_8U);
+
+	while (cinfo.output_scanline < cinfo.output_height) {
+		JSAMPROW row = img.ptr<uchar>(cinfo.output_scanline);
+		jpeg_read_scanlines(&cinfo, &row, 1);
+	}
+
+	jpeg_finish_decompress(&cinfo);
+	jpeg_destroy_decompress(&cinfo);
+	fclose(file);
+
+	return true;
+}
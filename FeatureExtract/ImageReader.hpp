@@ -0,0 +1,64 @@
+/*
+ * ImageReader.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: andresf
+ */
+
+#ifndef IMAGEREADER_HPP_
+#define IMAGEREADER_HPP_
+
+#include <string>
+
+#include <opencv2/core/core.hpp>
+
+/**
+ * Decodes images in gray scale with their longest side reduced to at most maxSide.
+ *
+ * JPEG files are decoded by libjpeg directly at 1/2, 1/4 or 1/8 of their resolution
+ * through DCT scaling, choosing the strongest reduction that keeps the longest side
+ * above maxSide, and the rest of the reduction is done by resizing. Other formats,
+ * and JPEG files libjpeg cannot decode in gray scale, are read with cv::imread and
+ * resized. Instances hold no decoding state and can be shared among threads.
+ */
+class ImageReader {
+public:
+
+	/**
+	 * @param maxSide - Maximum length of the longest side, 0 to decode at full resolution
+	 */
+	ImageReader(int maxSide = 0);
+
+	/**
+	 * Decodes an image.
+	 *
+	 * @param filename - Path to the image
+	 * @param scale - Output factors mapping the coordinates of the decoded image onto
+	 * 					the full resolution one, i.e. original size over decoded size
+	 * @return The decoded image, empty if it could not be read
+	 */
+	cv::Mat read(const std::string& filename, cv::Point2f& scale) const;
+
+	int getMaxSide() const {
+		return m_maxSide;
+	}
+
+private:
+
+	/**
+	 * Decodes a JPEG file at the reduced resolution closest to, but not smaller than,
+	 * the maximum side.
+	 *
+	 * @param filename - Path to the image
+	 * @param img - Output gray scale image
+	 * @param originalSize - Output full resolution size
+	 * @return False if libjpeg could not decode the file
+	 */
+	bool readJpeg(const std::string& filename, cv::Mat& img,
+			cv::Size& originalSize) const;
+
+	int m_maxSide;
+
+};
+
+#endif /* IMAGEREADER_HPP_ */
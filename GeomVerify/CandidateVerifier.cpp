@@ -0,0 +1,257 @@
+/*
+ * CandidateVerifier.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: andresf
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+#include <opencv2/calib3d/calib3d.hpp>
+
+#include <CandidateVerifier.hpp>
+#include <matching.hpp>
+#include <verification.hpp>
+
+VerificationParams::VerificationParams() :
+		topKeypoints(500), ratioThreshold(0.8), distanceThreshold(90), minMatches(
+				8), ransacThreshold(10.0), verifier("HOMOGRAPHY"), wgc(false), wgcScaleBins(
+				8), wgcAngleBins(12), wgcMinVotes(-1), similarityConfidence(
+				0.99), similarityMaxIterations(1000), similarityRefine(
+				REFINE_NONE), imagesExtension(".jpg"), visualizeFolder("."), visualizeRate(
+				0.0) {
+}
+
+// --------------------------------------------------------------------------
+
+bool VerificationParams::set(const std::string& key,
+		const std::string& value) {
+
+	if (key.compare("verifier") == 0) {
+		if (value.compare("HOMOGRAPHY") != 0
+				&& value.compare("SIMILARITY") != 0
+				&& value.compare("WGC") != 0) {
+			throw std::runtime_error(
+					"[VerificationParams::set] Invalid verifier, choose among "
+							"HOMOGRAPHY, SIMILARITY or WGC");
+		}
+		verifier = value;
+	} else if (key.compare("wgc") == 0) {
+		wgc = atoi(value.c_str()) != 0;
+	} else if (key.compare("wgc.scale.bins") == 0) {
+		wgcScaleBins = atoi(value.c_str());
+	} else if (key.compare("wgc.angle.bins") == 0) {
+		wgcAngleBins = atoi(value.c_str());
+	} else if (key.compare("wgc.min.votes") == 0) {
+		wgcMinVotes = atoi(value.c_str());
+	} else if (key.compare("similarity.confidence") == 0) {
+		similarityConfidence = atof(value.c_str());
+	} else if (key.compare("similarity.max.iterations") == 0) {
+		similarityMaxIterations = atoi(value.c_str());
+	} else if (key.compare("similarity.refine") == 0) {
+		if (value.compare("NONE") == 0) {
+			similarityRefine = REFINE_NONE;
+		} else if (value.compare("AFFINE") == 0) {
+			similarityRefine = REFINE_AFFINE;
+		} else if (value.compare("HOMOGRAPHY") == 0) {
+			similarityRefine = REFINE_HOMOGRAPHY;
+		} else {
+			throw std::runtime_error(
+					"[VerificationParams::set] Invalid refinement, choose among "
+							"NONE, AFFINE or HOMOGRAPHY");
+		}
+	} else if (key.compare("images.folder") == 0) {
+		imagesFolder = value;
+	} else if (key.compare("images.extension") == 0) {
+		imagesExtension = value;
+	} else if (key.compare("visualize.folder") == 0) {
+		visualizeFolder = value;
+	} else if (key.compare("visualize.rate") == 0) {
+		visualizeRate = atof(value.c_str());
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------------------------
+
+void VerificationParams::print() const {
+
+	printf("   topKeypoints=[%d] ratioThr=[%2.1f] distanceThr=[%f] "
+			"minMatches=[%d] ransacThr=[%2.1f]\n", topKeypoints,
+			ratioThreshold, distanceThreshold, minMatches, ransacThreshold);
+	printf("   verifier=[%s] wgc=[%d] wgc.scale.bins=[%d] wgc.angle.bins=[%d] "
+			"wgc.min.votes=[%d]\n", verifier.c_str(), int(wgc), wgcScaleBins,
+			wgcAngleBins, wgcMinVotes < 0 ? minMatches : wgcMinVotes);
+	if (verifier.compare("SIMILARITY") == 0) {
+		printf("   similarity.refine=[%s] similarity.confidence=[%f] "
+				"similarity.max.iterations=[%d]\n",
+				similarityRefine == REFINE_AFFINE ? "AFFINE" :
+				similarityRefine == REFINE_HOMOGRAPHY ? "HOMOGRAPHY" : "NONE",
+				similarityConfidence, similarityMaxIterations);
+	}
+	if (visualizeRate > 0.0) {
+		printf("   images.folder=[%s] images.extension=[%s] "
+				"visualize.rate=[%f] visualize.folder=[%s]\n",
+				imagesFolder.c_str(), imagesExtension.c_str(), visualizeRate,
+				visualizeFolder.c_str());
+	}
+
+}
+
+// --------------------------------------------------------------------------
+
+void VerificationParams::printUsage() {
+
+	printf("Verification options:\n"
+			"\tverifier=HOMOGRAPHY\twgc=0\n"
+			"\twgc.scale.bins=8\twgc.angle.bins=12\n"
+			"\twgc.min.votes=<min.matches>\n"
+			"\tsimilarity.refine=NONE\tsimilarity.confidence=0.99\n"
+			"\tsimilarity.max.iterations=1000\n"
+			"\timages.folder=\t\timages.extension=.jpg\n"
+			"\tvisualize.rate=0\t\tvisualize.folder=<out.folder>\n\n"
+			"Verifiers:\n"
+			"\tHOMOGRAPHY: RANSAC homography, optionally pre-filtered by WGC when wgc=1\n"
+			"\tSIMILARITY: 1/2-point PROSAC similarity, refined to AFFINE or HOMOGRAPHY if requested\n"
+			"\tWGC: weak geometric consistency score only, no RANSAC\n\n"
+			"Visualization:\n"
+			"\tInlier matches of a fraction visualize.rate of the verified pairs are drawn\n"
+			"\tfrom images.folder, images are never decoded when it is left empty\n\n");
+
+}
+
+// --------------------------------------------------------------------------
+
+CandidateVerifier::CandidateVerifier(const VerificationParams& params) :
+		m_params(params), m_wgcMinVotes(
+				params.wgcMinVotes < 0 ? params.minMatches : params.wgcMinVotes), m_visualizer(
+				params.imagesFolder, params.imagesExtension,
+				params.visualizeFolder, params.visualizeRate) {
+}
+
+// --------------------------------------------------------------------------
+
+void CandidateVerifier::setQuery(const std::string& queryBase,
+		std::vector<cv::KeyPoint>& keypoints, cv::Mat& descriptors) {
+
+	filterFeatures(keypoints, descriptors, m_params.topKeypoints);
+
+	m_queryBase = queryBase;
+	m_queryKeypoints = keypoints;
+	m_queryDescriptors = descriptors;
+
+	// Binary descriptors are packed once and matched against every candidate
+	if (m_queryDescriptors.type() == CV_8U) {
+		m_matcher.train(m_queryDescriptors);
+	}
+
+}
+
+// --------------------------------------------------------------------------
+
+int CandidateVerifier::verify(const std::string& candidateBase,
+		std::vector<cv::KeyPoint>& keypoints, cv::Mat& descriptors) {
+
+	filterFeatures(keypoints, descriptors, m_params.topKeypoints);
+
+	// Searching putative matches
+	printf("   Matching key-points of query [%s] against candidate [%s]\n",
+			m_queryBase.c_str(), candidateBase.c_str());
+
+	double mytime = cv::getTickCount();
+
+	if (m_queryDescriptors.type() == CV_8U) {
+		m_matcher.match(descriptors, m_matches,
+				int(m_params.distanceThreshold));
+	} else {
+		matchKeypoints(descriptors, m_queryDescriptors, m_matches,
+				m_params.ratioThreshold, m_params.distanceThreshold);
+	}
+
+	mytime = (double(cv::getTickCount()) - mytime) / cv::getTickFrequency()
+			* 1000;
+
+	printf("   Found [%d] putative matches in [%lf] ms\n",
+			int(m_matches.size()), mytime);
+
+	// Weak geometric consistency either as a pre-filter or as the score itself
+	if (m_params.wgc || m_params.verifier.compare("WGC") == 0) {
+		int votes = weakGeometricConsistency(keypoints, m_queryKeypoints,
+				m_matches, m_consistentMatches, m_params.wgcScaleBins,
+				m_params.wgcAngleBins);
+		printf("   Weak geometric consistency kept [%d] out of [%d] "
+				"putative matches\n", votes, int(m_matches.size()));
+		if (m_params.verifier.compare("WGC") == 0) {
+			return votes;
+		}
+		if (votes < m_wgcMinVotes) {
+			printf("   Skipping RANSAC, need at least [%d] "
+					"consistent matches\n", m_wgcMinVotes);
+			return 0;
+		}
+		m_matches.swap(m_consistentMatches);
+	}
+
+	if (int(m_matches.size()) < m_params.minMatches) {
+		fprintf(stderr, "   Cannot compute transformation between"
+				" query [%s] and candidate [%s], "
+				"need at least [%d] putative matches\n", m_queryBase.c_str(),
+				candidateBase.c_str(), m_params.minMatches);
+		return 0;
+	}
+
+	// Compute a transformation between query and ranked file
+	bool similarity = m_params.verifier.compare("SIMILARITY") == 0;
+	printf("   Computing %s transformation "
+			"between query [%s] and candidate [%s]\n",
+			similarity ? "similarity" : "projective", m_queryBase.c_str(),
+			candidateBase.c_str());
+
+	m_inliersMask.clear();
+	cv::Mat H;
+
+	mytime = cv::getTickCount();
+	if (similarity) {
+		similarityRansac(keypoints, m_queryKeypoints, m_matches, H,
+				m_inliersMask, m_params.ransacThreshold,
+				m_params.similarityConfidence,
+				m_params.similarityMaxIterations, m_params.similarityRefine);
+	} else {
+		m_candidatePoints.clear();
+		m_queryPoints.clear();
+		for (cv::DMatch& match : m_matches) {
+			m_queryPoints.push_back(m_queryKeypoints[match.trainIdx].pt);
+			m_candidatePoints.push_back(keypoints[match.queryIdx].pt);
+		}
+		H = cv::findHomography(m_candidatePoints, m_queryPoints, CV_RANSAC,
+				m_params.ransacThreshold, m_inliersMask);
+	}
+	mytime = (double(cv::getTickCount()) - mytime) / cv::getTickFrequency()
+			* 1000;
+
+	// Obtain number of inliers
+	int numInliers = int(
+			std::count(m_inliersMask.begin(), m_inliersMask.end(), 1));
+
+	printf("   Computed transformation in [%0.3fms], found [%d] inliers\n",
+			mytime, numInliers);
+
+	if (m_visualizer.sample()) {
+		m_inlierMatches.clear();
+		for (size_t i = 0; i < m_inliersMask.size(); ++i) {
+			if (int(m_inliersMask[i]) == int(1)) {
+				m_inlierMatches.push_back(m_matches.at(i));
+			}
+		}
+		m_visualizer.write(m_queryBase, m_queryKeypoints, candidateBase,
+				keypoints, m_inlierMatches);
+	}
+
+	return numInliers;
+}
@@ -0,0 +1,131 @@
+/*
+ * CandidateVerifier.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: andresf
+ */
+
+#ifndef CANDIDATEVERIFIER_HPP_
+#define CANDIDATEVERIFIER_HPP_
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/features2d/features2d.hpp>
+
+#include <HammingMatcher.hpp>
+#include <visualization.hpp>
+
+/**
+ * Parameters of the spatial verification of a query against its ranked candidates.
+ */
+struct VerificationParams {
+
+	VerificationParams();
+
+	/**
+	 * Sets a parameter given as a <key>=<value> command line option.
+	 *
+	 * @param key - Name of the option, e.g. verifier or wgc.min.votes
+	 * @param value - Value of the option
+	 * @return False if the option is unknown
+	 */
+	bool set(const std::string& key, const std::string& value);
+
+	/**
+	 * Prints the parameters to standard output.
+	 */
+	void print() const;
+
+	/**
+	 * Prints the usage of the options accepted by set to standard output.
+	 */
+	static void printUsage();
+
+	// Number of features with the highest response kept per image
+	int topKeypoints;
+	// Ratio test threshold (real-valued descriptors)
+	double ratioThreshold;
+	// Nearest neighbor distance threshold (binary descriptors)
+	double distanceThreshold;
+	// Minimum number of putative matches to estimate a transformation
+	int minMatches;
+	// Maximum re-projection error of an inlier
+	double ransacThreshold;
+	// One of HOMOGRAPHY, SIMILARITY or WGC
+	std::string verifier;
+	// Weak geometric consistency pre-filter
+	bool wgc;
+	int wgcScaleBins;
+	int wgcAngleBins;
+	// Minimum number of consistent matches, negative to use minMatches
+	int wgcMinVotes;
+	double similarityConfidence;
+	int similarityMaxIterations;
+	int similarityRefine;
+	// Visualization sink
+	std::string imagesFolder;
+	std::string imagesExtension;
+	std::string visualizeFolder;
+	double visualizeRate;
+
+};
+
+/**
+ * Spatial verification of a query against a sequence of candidates.
+ *
+ * The query features are filtered and, for binary descriptors, packed into the matcher
+ * once by setQuery, every candidate passed to verify is then matched against them and
+ * its number of inliers returned.
+ */
+class CandidateVerifier {
+public:
+
+	CandidateVerifier(const VerificationParams& params);
+
+	/**
+	 * Sets the query the candidates are verified against.
+	 *
+	 * @param queryBase - Base name of the query image
+	 * @param keypoints - Query key-points, filtered in place to the top ones
+	 * @param descriptors - Query descriptors, filtered in place to the top ones
+	 */
+	void setQuery(const std::string& queryBase,
+			std::vector<cv::KeyPoint>& keypoints, cv::Mat& descriptors);
+
+	/**
+	 * Verifies a candidate against the current query.
+	 *
+	 * @param candidateBase - Base name of the candidate image
+	 * @param keypoints - Candidate key-points, filtered in place to the top ones
+	 * @param descriptors - Candidate descriptors, filtered in place to the top ones
+	 * @return The number of inliers, or of consistent matches for the WGC verifier
+	 */
+	int verify(const std::string& candidateBase,
+			std::vector<cv::KeyPoint>& keypoints, cv::Mat& descriptors);
+
+	const VerificationParams& getParams() const {
+		return m_params;
+	}
+
+private:
+
+	VerificationParams m_params;
+	int m_wgcMinVotes;
+
+	MatchesVisualizer m_visualizer;
+	HammingMatcher m_matcher;
+
+	std::string m_queryBase;
+	std::vector<cv::KeyPoint> m_queryKeypoints;
+	cv::Mat m_queryDescriptors;
+
+	// Buffers re-used across candidates
+	std::vector<cv::DMatch> m_matches, m_consistentMatches, m_inlierMatches;
+	std::vector<cv::Point2f> m_candidatePoints, m_queryPoints;
+	std::vector<uchar> m_inliersMask;
+
+};
+
+#endif /* CANDIDATEVERIFIER_HPP_ */
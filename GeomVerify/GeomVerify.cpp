@@ -7,11 +7,11 @@
 
 #include <iostream>
 #include <stdexcept>
+#include <unordered_map>
 
-#include <opencv2/calib3d/calib3d.hpp>
 #include <opencv2/flann/logger.h>
-#include <opencv2/highgui/highgui.hpp>
 
+#include <CandidateVerifier.hpp>
 #include <matching.hpp>
 
 #include <FileUtils.hpp>
@@ -33,15 +33,27 @@ double mytime;
 
 int main(int argc, char **argv) {
 
-	if (argc < 9 || argc > 13) {
+	// Position of the optional -opts <key>=<value> arguments
+	int optsPos = argc;
+	for (int var = 1; var < argc; ++var) {
+		if (std::string(argv[var]).compare("-opts") == 0) {
+			optsPos = var;
+			break;
+		}
+	}
+
+	if (optsPos < 9 || optsPos > 13) {
 		printf(
 				"\nUsage:\n"
 						"\tGeomVerify "
 						"<in.ranked.files.folder> <in.ranked.files.prefix> "
 						"<in.db.descriptors.list> <in.db.keypoints.folder> <in.queries.descriptors.list> <in.queries.keypoints.folder> "
 						"<out.re-ranked.files.folder> <in.top.candidates> "
-						"[in.topKeypoints:500] [in.ratio.thr:0.8|in.distance.thr:90] [im.min.matches:8] [in.ransac.thr:10]"
-						"\n\n");
+						"[in.topKeypoints:500] [in.ratio.thr:0.8|in.distance.thr:90] [im.min.matches:8] [in.ransac.thr:10] "
+						"[-opts <key>=<value>]\n\n"
+						"Input options:\n"
+						"\tkeys.extension=.yaml.gz\n\n");
+		VerificationParams::printUsage();
 		return EXIT_FAILURE;
 	}
 
@@ -54,19 +66,43 @@ int main(int argc, char **argv) {
 	std::string out_ranked_lists_folder = argv[7];
 
 	int topCandidates = atoi(argv[8]);
-	int topKeypoints = argc >= 10 ? atoi(argv[9]) : 500;
-	double ratioThreshold = argc >= 11 ? atof(argv[10]) : 0.8; // Ratio test threshold
-	double distanceThreshold = argc >= 11 ? atof(argv[10]) : 90; // Distance threshold for nearest neighbor test (for binary descriptors)
-	int ransacMinMatches = argc >= 12 ? atoi(argv[11]) : 8;
-	double ransacThreshold = argc >= 13 ? atof(argv[12]) : 10.0;
+
+	VerificationParams params;
+	params.topKeypoints = optsPos >= 10 ? atoi(argv[9]) : 500;
+	params.ratioThreshold = optsPos >= 11 ? atof(argv[10]) : 0.8; // Ratio test threshold
+	params.distanceThreshold = optsPos >= 11 ? atof(argv[10]) : 90; // Distance threshold for nearest neighbor test (for binary descriptors)
+	params.minMatches = optsPos >= 12 ? atoi(argv[11]) : 8;
+	params.ransacThreshold = optsPos >= 13 ? atof(argv[12]) : 10.0;
+	params.visualizeFolder = out_ranked_lists_folder;
+
+	std::string keysExtension = ".yaml.gz";
+
+	for (int var = optsPos + 1; var < argc; ++var) {
+		std::string arg = argv[var];
+		size_t delimPos = arg.find("=");
+		CV_Assert(delimPos != std::string::npos);
+		std::string key = arg.substr(0, delimPos);
+		std::string value = arg.substr(delimPos + 1, arg.length());
+		if (key.compare("keys.extension") == 0) {
+			keysExtension = value;
+			continue;
+		}
+		try {
+			if (params.set(key, value) == false) {
+				fprintf(stderr, "Unknown option [%s]\n", key.c_str());
+				return EXIT_FAILURE;
+			}
+		} catch (const std::runtime_error& error) {
+			fprintf(stderr, "%s\n", error.what());
+			return EXIT_FAILURE;
+		}
+	}
 
 	// Step 1/4: load tree + direct index
 
-	printf(
-			"-- Running spatial verification using topCandidates=[%d] topKeypoints=[%d] "
-					"ratioThr=[%2.1f] distanceThre=[%f] ransacMinMatches=[%d] ransacThr=[%2.1f]\n",
-			topCandidates, topKeypoints, ratioThreshold, distanceThreshold,
-			ransacMinMatches, ransacThreshold);
+	printf("-- Running spatial verification using topCandidates=[%d]\n",
+			topCandidates);
+	params.print();
 
 	// Step 2a: load list of queries descriptors
 	printf("-- Loading list of queries descriptors\n");
@@ -84,6 +120,12 @@ int main(int argc, char **argv) {
 	FileUtils::loadList(in_db_desc_list, db_desc_list);
 	printf("   Loaded, got [%lu] entries\n", db_desc_list.size());
 
+	// Mapping dbimg.candidate -> dbimg.id
+	std::unordered_map<std::string, int> db_ids;
+	for (size_t k = 0; k < db_desc_list.size(); ++k) {
+		db_ids[db_desc_list[k]] = int(k);
+	}
+
 	// Step 4/4: load and process queries key-points
 	printf("-- Loading and processing queries key-points\n");
 	std::vector<cv::KeyPoint> queryKeypoints;
@@ -93,19 +135,16 @@ int main(int argc, char **argv) {
 	std::vector<cv::KeyPoint> candidateKeypoints;
 	std::stringstream ranked_list_fname;
 
-	std::vector<cv::DMatch> matchesCandidateToQuery, inlierMatches;
-	std::vector<cv::Point2f> matchedCandidatePoints, matchedQueryPoints;
 	int top = -1;
 
-	cv::Mat inliers_idx, H;
 	std::vector<int> candidates_inliers;
 	std::vector<size_t> candidates_inliers_idx;
 
-	cv::Mat imgOut;
-	cv::Mat queryImg, candidateImg;
 	cv::Mat candidateDescriptors;
 	cv::Mat queryDescriptors;
 
+	CandidateVerifier verifier(params);
+
 	std::string queryBase, candidateBase;
 
 	cvflann::Logger::setDestination("inliers.log");
@@ -120,10 +159,10 @@ int main(int argc, char **argv) {
 
 		// Step 4a: load and pre-process query features
 		FileUtils::loadKeypoints(
-				in_queries_keys_folder + "/" + queryBase + ".yaml.gz",
+				in_queries_keys_folder + "/" + queryBase + keysExtension,
 				queryKeypoints);
 		FileUtils::loadDescriptors(queries_desc_list[i].name, queryDescriptors);
-		filterFeatures(queryKeypoints, queryDescriptors, topKeypoints);
+		verifier.setQuery(queryBase, queryKeypoints, queryDescriptors);
 
 		// Step 4b: load list of query ranked candidates
 		printf("   Loading list of ranked candidates\n");
@@ -143,160 +182,29 @@ int main(int argc, char **argv) {
 		candidates_inliers.clear();
 		candidates_inliers.resize(top, 0);
 
-		queryImg = cv::imread("oxbuild_images/" + queryBase + ".jpg",
-				CV_LOAD_IMAGE_GRAYSCALE);
-
-//		imgOut = cv::Mat();
-//		cv::drawKeypoints(queryImg, queryKeypoints, imgOut,
-//				cv::Scalar(255, 255, 0), cv::DrawMatchesFlags::DEFAULT);
-//		cv::namedWindow("oxbuild_images/" + queryBase + ".jpg",
-//				cv::WINDOW_NORMAL);
-//		cv::resizeWindow("oxbuild_images/" + queryBase + ".jpg", 500, 500);
-//		cv::imshow("oxbuild_images/" + queryBase + ".jpg", imgOut);
-//		cv::waitKey(0);
-
-		// Step 4c: load and pre-process candidate features
+		// Step 4c: load and verify candidates
 		for (int j = 0; j < top; ++j) {
 
-			printf("   Load and pre-process candidate features\n");
-			FileUtils::loadKeypoints(
-					in_db_keys_folder + "/" + ranked_candidates_list[j]
-							+ ".yaml.gz", candidateKeypoints);
-			FileUtils::loadDescriptors(
-					"db/" + ranked_candidates_list[j] + ".bin",
-					candidateDescriptors);
-			filterFeatures(candidateKeypoints, candidateDescriptors,
-					topKeypoints);
-
-			// Searching putative matches
-			printf("   Matching key-points of query [%lu] "
-					"against candidate [%d]\n", i, j);
+			candidateBase = ranked_candidates_list[j];
 
 			// Id of database image
-			std::vector<std::string>::iterator it = std::find(
-					db_desc_list.begin(), db_desc_list.end(),
-					"db/" + ranked_candidates_list[j] + ".bin");
-
-			if (it == db_desc_list.end()) {
-				throw std::runtime_error("Candidate [%s] not found "
-						"in list of database filenames");
+			if (db_ids.find("db/" + candidateBase + ".bin") == db_ids.end()) {
+				throw std::runtime_error(
+						"Candidate [" + candidateBase + "] not found "
+								"in list of database filenames");
 			}
 
-			candidateBase = ranked_candidates_list[j];
-			candidateImg = cv::imread(
-					"oxbuild_images/" + candidateBase + ".jpg",
-					CV_LOAD_IMAGE_GRAYSCALE);
-
-//			imgOut = cv::Mat();
-//			cv::drawKeypoints(candidateImg, candidateKeypoints, imgOut,
-//					cv::Scalar(255, 255, 0), cv::DrawMatchesFlags::DEFAULT);
-//			cv::namedWindow("oxbuild_images/" + candidateBase + ".jpg",
-//					cv::WINDOW_NORMAL);
-//			cv::resizeWindow("oxbuild_images/" + candidateBase + ".jpg", 500,
-//					500);
-//			cv::imshow("oxbuild_images/" + candidateBase + ".jpg", imgOut);
-//			cv::waitKey(0);
-
-			mytime = cv::getTickCount();
+			printf("   Load and pre-process candidate features\n");
+			FileUtils::loadKeypoints(
+					in_db_keys_folder + "/" + candidateBase + keysExtension,
+					candidateKeypoints);
+			FileUtils::loadDescriptors("db/" + candidateBase + ".bin",
+					candidateDescriptors);
 
 			// TODO Use the direct index to pre-filter query and candidate key-points
 
-			matchKeypoints(candidateDescriptors, queryDescriptors,
-					matchesCandidateToQuery, ratioThreshold, distanceThreshold);
-
-			matchedCandidatePoints.clear();
-			matchedQueryPoints.clear();
-
-			for (cv::DMatch& match : matchesCandidateToQuery) {
-//				double kptsDist = cv::norm(
-//						cv::Point(candidateKeypoints[match.queryIdx].pt.x,
-//								candidateKeypoints[match.queryIdx].pt.y)
-//								- cv::Point(queryKeypoints[match.trainIdx].pt.x,
-//										queryKeypoints[match.trainIdx].pt.y));
-//
-//				// Apply a proximity threshold
-//				if (kptsDist > 200) {
-//					continue;
-//				}
-				// Add points to vectors of matched
-				matchedQueryPoints.push_back(queryKeypoints[match.trainIdx].pt);
-				matchedCandidatePoints.push_back(
-						candidateKeypoints[match.queryIdx].pt);
-			}
-
-			mytime = (double(cv::getTickCount()) - mytime)
-					/ cv::getTickFrequency() * 1000;
-
-			printf("   Found [%d] putative matches in [%lf] ms\n",
-					int(matchesCandidateToQuery.size()), mytime);
-
-//			imgOut = cv::Mat();
-//			cv::drawMatches(candidateImg, candidateKeypoints, queryImg,
-//					queryKeypoints, matchesCandidateToQuery, imgOut);
-//			cv::namedWindow(
-//					"oxbuild_images/" + queryBase + "_" + candidateBase
-//							+ ".jpg", cv::WINDOW_NORMAL);
-//			cv::resizeWindow(
-//					"oxbuild_images/" + queryBase + "_" + candidateBase
-//							+ ".jpg", 500, 500);
-//			cv::imshow(
-//					"oxbuild_images/" + queryBase + "_" + candidateBase
-//							+ ".jpg", imgOut);
-//			cv::waitKey(0);
-
-			if ((int(matchesCandidateToQuery.size())) < ransacMinMatches) {
-				fprintf(stderr, "   Cannot compute homography between"
-						" query [%lu] and candidate [%d], "
-						"need at least [%d] putative matches\n", i, j,
-						ransacMinMatches);
-			} else {
-				// Compute a projective transformation between query and ranked file using direct index
-				printf("   Computing projective transformation "
-						"between query [%lu] and candidate [%d]\n", i, j);
-
-				inliers_idx = cv::Mat();
-
-				mytime = cv::getTickCount();
-				H = cv::findHomography(matchedCandidatePoints,
-						matchedQueryPoints, CV_RANSAC, ransacThreshold,
-						inliers_idx);
-				mytime = (double(cv::getTickCount()) - mytime)
-						/ cv::getTickFrequency() * 1000;
-
-				// Obtain number of inliers
-				int numInliers = int(sum(inliers_idx)[0]);
-
-				printf(
-						"   Computed homography in [%0.3fs], found [%d] inliers\n",
-						mytime, numInliers);
-
-				candidates_inliers[j] = numInliers;
-
-				inlierMatches.clear();
-				for (int i = 0; i < inliers_idx.rows; ++i) {
-					if (int(inliers_idx.at<uchar>(i)) == int(1)) {
-						inlierMatches.push_back(matchesCandidateToQuery.at(i));
-					}
-				}
-				imgOut = cv::Mat();
-				cv::drawMatches(candidateImg, candidateKeypoints, queryImg,
-						queryKeypoints, inlierMatches, imgOut);
-				cv::imwrite(
-						out_ranked_lists_folder + "/match_" + queryBase + "_"
-								+ candidateBase + ".jpg", imgOut);
-
-//				cv::namedWindow(
-//						"oxbuild_images/match_" + queryBase + "_"
-//								+ candidateBase + ".jpg", cv::WINDOW_NORMAL);
-//				cv::resizeWindow(
-//						"oxbuild_images/match_" + queryBase + "_"
-//								+ candidateBase + ".jpg", 500, 500);
-//				cv::imshow(
-//						"oxbuild_images/match_" + queryBase + "_"
-//								+ candidateBase + ".jpg", imgOut);
-//				cv::waitKey(0);
-
-			}
+			candidates_inliers[j] = verifier.verify(candidateBase,
+					candidateKeypoints, candidateDescriptors);
 
 			cvflann::Logger::log(0,
 					"query=[%s] candidate=[%s] numberInliers=[%d]\n",
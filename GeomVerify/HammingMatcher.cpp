@@ -0,0 +1,283 @@
+/*
+ * HammingMatcher.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: andresf
+ */
+
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define HAMMING_AVX2 1
+#define HAMMING_AVX2_TARGET __attribute__((target("avx2,popcnt")))
+#endif
+
+#include <HammingMatcher.hpp>
+
+// Helpers shared by both kernels are forced inline so that, once inlined into
+// an AVX2 entry point, they are compiled for that target too
+#define HAMMING_INLINE inline __attribute__((always_inline))
+
+namespace {
+
+/**
+ * Hamming distance between 32 bytes with the popcount builtin, it compiles
+ * to the popcount instruction only if the whole unit targets it.
+ */
+struct ScalarKernel {
+	static inline int distance4(const uint64_t* a, const uint64_t* b) {
+		return __builtin_popcountll(a[0] ^ b[0])
+				+ __builtin_popcountll(a[1] ^ b[1])
+				+ __builtin_popcountll(a[2] ^ b[2])
+				+ __builtin_popcountll(a[3] ^ b[3]);
+	}
+	static inline int popcount(uint64_t x) {
+		return __builtin_popcountll(x);
+	}
+};
+
+#if HAMMING_AVX2
+
+/**
+ * Counts the bits set in each 64-bit lane of a 256-bit register by means of
+ * the nibble look-up table method.
+ */
+HAMMING_AVX2_TARGET inline __m256i popcount256(const __m256i v) {
+	const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2,
+			3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i lowMask = _mm256_set1_epi8(0x0f);
+	__m256i lo = _mm256_and_si256(v, lowMask);
+	__m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), lowMask);
+	__m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+			_mm256_shuffle_epi8(lookup, hi));
+	return _mm256_sad_epu8(counts, _mm256_setzero_si256());
+}
+
+HAMMING_AVX2_TARGET inline int horizontalSum(const __m256i v) {
+	__m128i sum = _mm_add_epi64(_mm256_castsi256_si128(v),
+			_mm256_extracti128_si256(v, 1));
+	return int(_mm_cvtsi128_si64(sum) + _mm_extract_epi64(sum, 1));
+}
+
+/**
+ * Hamming distance between 32 bytes with AVX2, only called once the CPU
+ * has been checked to support it.
+ */
+struct Avx2Kernel {
+	HAMMING_AVX2_TARGET static inline int distance4(const uint64_t* a,
+			const uint64_t* b) {
+		__m256i x = _mm256_xor_si256(
+				_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a)),
+				_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b)));
+		return horizontalSum(popcount256(x));
+	}
+	HAMMING_AVX2_TARGET static inline int popcount(uint64_t x) {
+		return int(_mm_popcnt_u64(x));
+	}
+};
+
+#endif
+
+/**
+ * Hamming distance between two packed descriptors of 64 bytes, the second half
+ * is skipped whenever the first one already reaches the bound.
+ */
+template<typename Kernel>
+HAMMING_INLINE int distance8(const uint64_t* a, const uint64_t* b, int bound) {
+	int d = Kernel::distance4(a, b);
+	if (d >= bound) {
+		return d;
+	}
+	return d + Kernel::distance4(a + 4, b + 4);
+}
+
+/**
+ * Hamming distance between two packed descriptors of arbitrary length,
+ * the partial distance is checked against the bound every four words.
+ */
+template<typename Kernel>
+HAMMING_INLINE int distanceN(const uint64_t* a, const uint64_t* b, int words,
+		int bound) {
+	int d = 0;
+	for (int w = 0; w < words; ++w) {
+		d += Kernel::popcount(a[w] ^ b[w]);
+		if ((w & 3) == 3 && d >= bound) {
+			return d;
+		}
+	}
+	return d;
+}
+
+template<int Words, typename Kernel>
+struct Distance {
+	static HAMMING_INLINE int compute(const uint64_t* a, const uint64_t* b, int words,
+			int bound) {
+		return distanceN<Kernel>(a, b, words, bound);
+	}
+};
+
+template<typename Kernel>
+struct Distance<4, Kernel> {
+	static HAMMING_INLINE int compute(const uint64_t* a, const uint64_t* b, int,
+			int) {
+		return Kernel::distance4(a, b);
+	}
+};
+
+template<typename Kernel>
+struct Distance<8, Kernel> {
+	static HAMMING_INLINE int compute(const uint64_t* a, const uint64_t* b, int,
+			int bound) {
+		return distance8<Kernel>(a, b, bound);
+	}
+};
+
+template<int Words, typename Kernel>
+HAMMING_INLINE void matchPacked(
+		const std::vector<uint64_t>& queryWords, int queryRows,
+		const std::vector<uint64_t>& trainWords, int trainRows,
+		int wordsPerRow, int maxDistance, std::vector<cv::DMatch>& matches) {
+
+	const uint64_t* query = queryWords.data();
+
+	for (int q = 0; q < queryRows; ++q, query += wordsPerRow) {
+
+		// Only pairs strictly closer than the current bound are accepted,
+		// hence the bound starts right above the threshold
+		int bestDistance = maxDistance + 1;
+		int bestIdx = -1;
+
+		const uint64_t* train = trainWords.data();
+
+		for (int t = 0; t < trainRows; ++t, train += wordsPerRow) {
+			int d = Distance<Words, Kernel>::compute(query, train, wordsPerRow,
+					bestDistance);
+			if (d < bestDistance) {
+				bestDistance = d;
+				bestIdx = t;
+			}
+		}
+
+		if (bestIdx != -1) {
+			matches.push_back(cv::DMatch(q, bestIdx, float(bestDistance)));
+		}
+	}
+
+}
+
+typedef void (*MatchFunction)(const std::vector<uint64_t>&, int,
+		const std::vector<uint64_t>&, int, int, int, std::vector<cv::DMatch>&);
+
+template<int Words>
+void matchScalar(const std::vector<uint64_t>& queryWords, int queryRows,
+		const std::vector<uint64_t>& trainWords, int trainRows,
+		int wordsPerRow, int maxDistance, std::vector<cv::DMatch>& matches) {
+	matchPacked<Words, ScalarKernel>(queryWords, queryRows, trainWords,
+			trainRows, wordsPerRow, maxDistance, matches);
+}
+
+#if HAMMING_AVX2
+
+template<int Words>
+HAMMING_AVX2_TARGET void matchAvx2(const std::vector<uint64_t>& queryWords,
+		int queryRows, const std::vector<uint64_t>& trainWords, int trainRows,
+		int wordsPerRow, int maxDistance, std::vector<cv::DMatch>& matches) {
+	matchPacked<Words, Avx2Kernel>(queryWords, queryRows, trainWords,
+			trainRows, wordsPerRow, maxDistance, matches);
+}
+
+#endif
+
+/**
+ * Picks the AVX2 scan when the running CPU supports it and the scalar one
+ * otherwise, so the binary runs on any x86 host without special flags.
+ */
+template<int Words>
+MatchFunction selectMatch() {
+#if HAMMING_AVX2
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+		return &matchAvx2<Words>;
+	}
+#endif
+	return &matchScalar<Words>;
+}
+
+}
+
+// --------------------------------------------------------------------------
+
+HammingMatcher::HammingMatcher() :
+		m_trainRows(0), m_descriptorBytes(0), m_wordsPerRow(0) {
+}
+
+// --------------------------------------------------------------------------
+
+void HammingMatcher::train(const cv::Mat& trainDescriptors) {
+
+	CV_Assert(trainDescriptors.type() == CV_8U);
+
+	m_trainRows = trainDescriptors.rows;
+	m_descriptorBytes = trainDescriptors.cols;
+	m_wordsPerRow = (m_descriptorBytes + 7) / 8;
+
+	pack(trainDescriptors, m_trainWords, m_wordsPerRow);
+
+}
+
+// --------------------------------------------------------------------------
+
+void HammingMatcher::match(const cv::Mat& queryDescriptors,
+		std::vector<cv::DMatch>& matches, int maxDistance) {
+
+	// Clean up non constant variables received as parameters
+	matches.clear();
+
+	if (queryDescriptors.empty() || m_trainRows == 0) {
+		return;
+	}
+
+	CV_Assert(queryDescriptors.type() == CV_8U);
+
+	if (queryDescriptors.cols != m_descriptorBytes) {
+		throw std::runtime_error(
+				"[HammingMatcher::match] Query and train descriptors "
+						"have different lengths");
+	}
+
+	pack(queryDescriptors, m_queryWords, m_wordsPerRow);
+
+	matches.reserve(queryDescriptors.rows);
+
+	static const MatchFunction match4 = selectMatch<4>();
+	static const MatchFunction match8 = selectMatch<8>();
+	static const MatchFunction matchN = selectMatch<0>();
+
+	if (m_descriptorBytes == 32) {
+		match4(m_queryWords, queryDescriptors.rows, m_trainWords, m_trainRows,
+				m_wordsPerRow, maxDistance, matches);
+	} else if (m_descriptorBytes == 64) {
+		match8(m_queryWords, queryDescriptors.rows, m_trainWords, m_trainRows,
+				m_wordsPerRow, maxDistance, matches);
+	} else {
+		matchN(m_queryWords, queryDescriptors.rows, m_trainWords, m_trainRows,
+				m_wordsPerRow, maxDistance, matches);
+	}
+
+}
+
+// --------------------------------------------------------------------------
+
+void HammingMatcher::pack(const cv::Mat& descriptors,
+		std::vector<uint64_t>& words, int wordsPerRow) {
+
+	words.assign(size_t(descriptors.rows) * wordsPerRow, 0);
+
+	for (int i = 0; i < descriptors.rows; ++i) {
+		memcpy(&words[size_t(i) * wordsPerRow], descriptors.ptr<uchar>(i),
+				descriptors.cols);
+	}
+
+}
@@ -0,0 +1,82 @@
+/*
+ * HammingMatcher.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: andresf
+ */
+
+#ifndef HAMMINGMATCHER_HPP_
+#define HAMMINGMATCHER_HPP_
+
+#include <stdint.h>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/features2d/features2d.hpp>
+
+/**
+ * Brute-force nearest neighbor matcher for binary descriptors.
+ *
+ * Descriptors are kept packed in 64-bit words (zero padded up to a multiple of 8 bytes)
+ * and Hamming distances are computed with AVX2 for 32 and 64 byte descriptors when the
+ * running CPU supports it, which is checked once at the first match, or with the popcount
+ * builtin otherwise. The distance threshold is applied while scanning,
+ * i.e. a pair is abandoned as soon as its partial distance exceeds the best distance found
+ * so far (initially the threshold), so pairs that cannot pass never reach the result vector.
+ *
+ * The train descriptors are packed once by train() and re-used by every call to match(),
+ * hence in GeomVerify the query descriptors are trained once and matched against every candidate.
+ */
+class HammingMatcher {
+public:
+
+	HammingMatcher();
+
+	/**
+	 * Packs the descriptors to match against, they are kept until the next call to train.
+	 *
+	 * @param trainDescriptors - Matrix of binary descriptors, one per row and of type CV_8U
+	 */
+	void train(const cv::Mat& trainDescriptors);
+
+	/**
+	 * Finds for each query descriptor its nearest train descriptor, only those pairs whose
+	 * distance is below or equal to the threshold are kept. Ties are resolved in favor of
+	 * the train descriptor with the lowest index.
+	 *
+	 * @param queryDescriptors - Matrix of binary descriptors, one per row and of type CV_8U
+	 * @param matches - Output vector of matches, queryIdx/trainIdx index the query/train rows
+	 * @param maxDistance - Maximum Hamming distance for a pair to be considered a match
+	 */
+	void match(const cv::Mat& queryDescriptors,
+			std::vector<cv::DMatch>& matches, int maxDistance);
+
+	bool empty() const {
+		return m_trainRows == 0;
+	}
+
+	int getDescriptorSize() const {
+		return m_descriptorBytes;
+	}
+
+private:
+
+	/**
+	 * Copies the rows of a binary descriptors matrix into consecutive blocks of 64-bit words.
+	 *
+	 * @param descriptors - Matrix of binary descriptors
+	 * @param words - Output packed words, wordsPerRow words per descriptor
+	 * @param wordsPerRow - Number of 64-bit words per descriptor
+	 */
+	static void pack(const cv::Mat& descriptors, std::vector<uint64_t>& words,
+			int wordsPerRow);
+
+	std::vector<uint64_t> m_trainWords;
+	std::vector<uint64_t> m_queryWords;
+	int m_trainRows;
+	int m_descriptorBytes;
+	int m_wordsPerRow;
+
+};
+
+#endif /* HAMMINGMATCHER_HPP_ */
@@ -5,6 +5,7 @@
  *      Author: andresf
  */
 
+#include <HammingMatcher.hpp>
 #include <matching.hpp>
 
 #include <opencv2/legacy/legacy.hpp>
@@ -19,16 +20,19 @@ void matchKeypoints(cv::Mat& descriptors1, cv::Mat& descriptors2,
 	CV_Assert(descriptors1.cols == descriptors2.cols);
 	CV_Assert(descriptors1.type() == descriptors2.type());
 
-	std::vector<std::vector<cv::DMatch>> matchesAll;
-
-	cv::Ptr<cv::DescriptorMatcher> matcher;
-
 	if (descriptors1.type() == CV_8U) {
-		matcher = new cv::BruteForceMatcher<cv::Hamming>();
-	} else {
-		matcher = new cv::BruteForceMatcher<cv::L2<float> >();
+		// Nearest neighbor plus distance threshold in a single pass
+		HammingMatcher matcher;
+		matcher.train(descriptors2);
+		matcher.match(descriptors1, matches1to2, int(distanceThreshold));
+		return;
 	}
 
+	std::vector<std::vector<cv::DMatch>> matchesAll;
+
+	cv::Ptr<cv::DescriptorMatcher> matcher = new cv::BruteForceMatcher<
+			cv::L2<float> >();
+
 	// Find best two matches in descriptors2 to each descriptor in descriptors1
 	matcher->knnMatch(descriptors1, descriptors2, matchesAll, 2);
 
@@ -42,19 +46,12 @@ void matchKeypoints(cv::Mat& descriptors1, cv::Mat& descriptors2,
 
 	// Discard matches by applying ratio or distance threshold
 	for (std::vector<cv::DMatch>& matches : matchesAll) {
-		if (descriptors1.type() == CV_8U) {
-			score = double(matches.at(0).distance);
-			if (score > distanceThreshold) {
-				continue;
-			}
-		} else {
-			score = double(matches.at(0).distance / matches.at(1).distance);
-			CV_Assert(score <= 1.0);
-			// Reject all matches in which the distance ratio is greater than 0.8
-			// this eliminates 90% of the false matches while discarding less than 5% of the correct matches
-			if (score > ratioThreshold) {
-				continue;
-			}
+		score = double(matches.at(0).distance / matches.at(1).distance);
+		CV_Assert(score <= 1.0);
+		// Reject all matches in which the distance ratio is greater than 0.8
+		// this eliminates 90% of the false matches while discarding less than 5% of the correct matches
+		if (score > ratioThreshold) {
+			continue;
 		}
 		// Set pair as a match
 		matches1to2.push_back(matches.at(0));
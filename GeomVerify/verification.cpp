@@ -0,0 +1,378 @@
+/*
+ * verification.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: andresf
+ */
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include <opencv2/calib3d/calib3d.hpp>
+
+#include <verification.hpp>
+
+// Log-scale ratios are clamped to [-MAX_LOG_SCALE, MAX_LOG_SCALE], i.e. a factor of 8
+#define MAX_LOG_SCALE 3.0
+
+namespace {
+
+int scaleBin(const cv::KeyPoint& kpt1, const cv::KeyPoint& kpt2, int bins) {
+	double logScale = std::log(double(kpt2.size) / double(kpt1.size))
+			/ std::log(2.0);
+	logScale = std::max(-MAX_LOG_SCALE, std::min(MAX_LOG_SCALE, logScale));
+	int bin = int((logScale + MAX_LOG_SCALE) / (2 * MAX_LOG_SCALE) * bins);
+	return std::min(bin, bins - 1);
+}
+
+int angleBin(const cv::KeyPoint& kpt1, const cv::KeyPoint& kpt2, int bins) {
+	if (kpt1.angle < 0 || kpt2.angle < 0) {
+		return 0;
+	}
+	double angle = std::fmod(double(kpt2.angle) - double(kpt1.angle), 360.0);
+	if (angle < 0) {
+		angle += 360.0;
+	}
+	return std::min(int(angle / 360.0 * bins), bins - 1);
+}
+
+int argMax(const std::vector<int>& histogram) {
+	int best = 0;
+	for (int b = 1; b < int(histogram.size()); ++b) {
+		if (histogram[b] > histogram[best]) {
+			best = b;
+		}
+	}
+	return best;
+}
+
+/**
+ * Similarity hypothesis from a single correspondence using the key-points scale and orientation.
+ * The transform is stored as a row-major 3x3 matrix.
+ */
+bool similarityFromOne(const cv::KeyPoint& kpt1, const cv::KeyPoint& kpt2,
+		double* h) {
+	if (kpt1.size <= 0 || kpt2.size <= 0) {
+		return false;
+	}
+	double scale = double(kpt2.size) / double(kpt1.size);
+	double theta = (double(kpt2.angle) - double(kpt1.angle)) * CV_PI / 180.0;
+	double a = scale * std::cos(theta), b = scale * std::sin(theta);
+	h[0] = a;
+	h[1] = -b;
+	h[2] = kpt2.pt.x - (a * kpt1.pt.x - b * kpt1.pt.y);
+	h[3] = b;
+	h[4] = a;
+	h[5] = kpt2.pt.y - (b * kpt1.pt.x + a * kpt1.pt.y);
+	h[6] = 0;
+	h[7] = 0;
+	h[8] = 1;
+	return true;
+}
+
+/**
+ * Similarity hypothesis from two correspondences, solved as z' = (a + ib) z + t
+ * over the complex plane.
+ */
+bool similarityFromTwo(const cv::KeyPoint& kpt1a, const cv::KeyPoint& kpt2a,
+		const cv::KeyPoint& kpt1b, const cv::KeyPoint& kpt2b, double* h) {
+	double dx1 = kpt1b.pt.x - kpt1a.pt.x, dy1 = kpt1b.pt.y - kpt1a.pt.y;
+	double dx2 = kpt2b.pt.x - kpt2a.pt.x, dy2 = kpt2b.pt.y - kpt2a.pt.y;
+	double norm = dx1 * dx1 + dy1 * dy1;
+	// Reject degenerate samples made of (almost) coincident points
+	if (norm < 1.0 || dx2 * dx2 + dy2 * dy2 < 1.0) {
+		return false;
+	}
+	double a = (dx2 * dx1 + dy2 * dy1) / norm;
+	double b = (dy2 * dx1 - dx2 * dy1) / norm;
+	h[0] = a;
+	h[1] = -b;
+	h[2] = kpt2a.pt.x - (a * kpt1a.pt.x - b * kpt1a.pt.y);
+	h[3] = b;
+	h[4] = a;
+	h[5] = kpt2a.pt.y - (b * kpt1a.pt.x + a * kpt1a.pt.y);
+	h[6] = 0;
+	h[7] = 0;
+	h[8] = 1;
+	return true;
+}
+
+int countInliers(const std::vector<cv::KeyPoint>& keypoints1,
+		const std::vector<cv::KeyPoint>& keypoints2,
+		const std::vector<cv::DMatch>& matches1to2, const double* h,
+		double sqThreshold, std::vector<uchar>* mask) {
+	int inliers = 0;
+	for (size_t i = 0; i < matches1to2.size(); ++i) {
+		const cv::Point2f& p1 = keypoints1[matches1to2[i].queryIdx].pt;
+		const cv::Point2f& p2 = keypoints2[matches1to2[i].trainIdx].pt;
+		double w = h[6] * p1.x + h[7] * p1.y + h[8];
+		bool inlier = false;
+		if (std::fabs(w) > DBL_EPSILON) {
+			double x = (h[0] * p1.x + h[1] * p1.y + h[2]) / w;
+			double y = (h[3] * p1.x + h[4] * p1.y + h[5]) / w;
+			inlier = (x - p2.x) * (x - p2.x) + (y - p2.y) * (y - p2.y)
+					<= sqThreshold;
+		}
+		if (mask != NULL) {
+			(*mask)[i] = inlier ? 1 : 0;
+		}
+		inliers += inlier ? 1 : 0;
+	}
+	return inliers;
+}
+
+/**
+ * Least squares affine transform over the inliers of the mask.
+ */
+bool refineAffine(const std::vector<cv::KeyPoint>& keypoints1,
+		const std::vector<cv::KeyPoint>& keypoints2,
+		const std::vector<cv::DMatch>& matches1to2,
+		const std::vector<uchar>& mask, int inliers, double* h) {
+	if (inliers < 3) {
+		return false;
+	}
+	cv::Mat A = cv::Mat::zeros(2 * inliers, 6, CV_64F);
+	cv::Mat b(2 * inliers, 1, CV_64F);
+	int r = 0;
+	for (size_t i = 0; i < matches1to2.size(); ++i) {
+		if (mask[i] == 0) {
+			continue;
+		}
+		const cv::Point2f& p1 = keypoints1[matches1to2[i].queryIdx].pt;
+		const cv::Point2f& p2 = keypoints2[matches1to2[i].trainIdx].pt;
+		A.at<double>(r, 0) = p1.x;
+		A.at<double>(r, 1) = p1.y;
+		A.at<double>(r, 2) = 1;
+		b.at<double>(r++) = p2.x;
+		A.at<double>(r, 3) = p1.x;
+		A.at<double>(r, 4) = p1.y;
+		A.at<double>(r, 5) = 1;
+		b.at<double>(r++) = p2.y;
+	}
+	cv::Mat x;
+	if (cv::solve(A, b, x, cv::DECOMP_SVD) == false) {
+		return false;
+	}
+	for (int k = 0; k < 6; ++k) {
+		h[k] = x.at<double>(k);
+	}
+	h[6] = 0;
+	h[7] = 0;
+	h[8] = 1;
+	return true;
+}
+
+/**
+ * Least squares homography over the inliers of the mask.
+ */
+bool refineHomography(const std::vector<cv::KeyPoint>& keypoints1,
+		const std::vector<cv::KeyPoint>& keypoints2,
+		const std::vector<cv::DMatch>& matches1to2,
+		const std::vector<uchar>& mask, int inliers, double* h) {
+	if (inliers < 4) {
+		return false;
+	}
+	std::vector<cv::Point2f> points1, points2;
+	points1.reserve(inliers);
+	points2.reserve(inliers);
+	for (size_t i = 0; i < matches1to2.size(); ++i) {
+		if (mask[i] != 0) {
+			points1.push_back(keypoints1[matches1to2[i].queryIdx].pt);
+			points2.push_back(keypoints2[matches1to2[i].trainIdx].pt);
+		}
+	}
+	cv::Mat H = cv::findHomography(points1, points2, 0);
+	if (H.empty()) {
+		return false;
+	}
+	H.convertTo(H, CV_64F);
+	for (int k = 0; k < 9; ++k) {
+		h[k] = H.at<double>(k / 3, k % 3);
+	}
+	return true;
+}
+
+}
+
+// --------------------------------------------------------------------------
+
+int weakGeometricConsistency(const std::vector<cv::KeyPoint>& keypoints1,
+		const std::vector<cv::KeyPoint>& keypoints2,
+		const std::vector<cv::DMatch>& matches1to2,
+		std::vector<cv::DMatch>& consistentMatches, int scaleBins,
+		int angleBins) {
+
+	CV_Assert(scaleBins > 0 && angleBins > 0);
+
+	// Clean up non constant variables received as parameters
+	consistentMatches.clear();
+
+	if (matches1to2.empty()) {
+		return 0;
+	}
+
+	std::vector<int> scales(matches1to2.size()), angles(matches1to2.size());
+	std::vector<int> scaleHistogram(scaleBins, 0), angleHistogram(angleBins,
+			0);
+
+	// Vote
+	for (size_t i = 0; i < matches1to2.size(); ++i) {
+		const cv::KeyPoint& kpt1 = keypoints1[matches1to2[i].queryIdx];
+		const cv::KeyPoint& kpt2 = keypoints2[matches1to2[i].trainIdx];
+		scales[i] = scaleBin(kpt1, kpt2, scaleBins);
+		angles[i] = angleBin(kpt1, kpt2, angleBins);
+		scaleHistogram[scales[i]]++;
+		angleHistogram[angles[i]]++;
+	}
+
+	int bestScale = argMax(scaleHistogram);
+	int bestAngle = argMax(angleHistogram);
+
+	// Keep matches next to both peaks, orientation bins wrap around
+	for (size_t i = 0; i < matches1to2.size(); ++i) {
+		int scaleOffset = std::abs(scales[i] - bestScale);
+		int angleOffset = std::abs(angles[i] - bestAngle);
+		angleOffset = std::min(angleOffset, angleBins - angleOffset);
+		if (scaleOffset <= 1 && angleOffset <= 1) {
+			consistentMatches.push_back(matches1to2[i]);
+		}
+	}
+
+	return int(consistentMatches.size());
+}
+
+// --------------------------------------------------------------------------
+
+int similarityRansac(const std::vector<cv::KeyPoint>& keypoints1,
+		const std::vector<cv::KeyPoint>& keypoints2,
+		const std::vector<cv::DMatch>& matches1to2, cv::Mat& model,
+		std::vector<uchar>& inliersMask, double threshold, double confidence,
+		int maxIterations, int refine) {
+
+	// Clean up non constant variables received as parameters
+	model = cv::Mat::eye(3, 3, CV_64F);
+	inliersMask.assign(matches1to2.size(), 0);
+
+	// Single point hypotheses require every key-point to carry an orientation
+	int sampleSize = 1;
+	for (const cv::DMatch& match : matches1to2) {
+		if (keypoints1[match.queryIdx].angle < 0
+				|| keypoints2[match.trainIdx].angle < 0) {
+			sampleSize = 2;
+			break;
+		}
+	}
+
+	int N = int(matches1to2.size());
+	if (N < sampleSize || maxIterations <= 0) {
+		return 0;
+	}
+
+	// PROSAC ordering, most distinctive matches first
+	std::vector<int> order(N);
+	for (int i = 0; i < N; ++i) {
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+		return matches1to2[a].distance < matches1to2[b].distance;
+	});
+
+	const double sqThreshold = threshold * threshold;
+	cv::RNG rng;
+
+	// Growth schedule of the sampling set, see Chum and Matas (CVPR'05)
+	int n = sampleSize;
+	double Tn = maxIterations;
+	for (int i = 0; i < sampleSize; ++i) {
+		Tn *= double(sampleSize - i) / double(N - i);
+	}
+	int TnPrime = 1;
+
+	double best[9], h[9];
+	int bestInliers = 0;
+	int iterations = maxIterations;
+
+	for (int t = 1; t <= iterations; ++t) {
+
+		bool grown = false;
+		if (t > TnPrime && n < N) {
+			double Tn1 = Tn * (n + 1) / (n + 1 - sampleSize);
+			TnPrime += std::max(1, int(std::ceil(Tn1 - Tn)));
+			Tn = Tn1;
+			++n;
+			grown = true;
+		}
+
+		// The newest match of the sampling set enters the sample right after growing it
+		int first = grown ? order[n - 1] : order[rng.uniform(0, n)];
+
+		bool valid;
+		if (sampleSize == 1) {
+			valid = similarityFromOne(keypoints1[matches1to2[first].queryIdx],
+					keypoints2[matches1to2[first].trainIdx], h);
+		} else {
+			int second = order[rng.uniform(0, n)];
+			if (second == first) {
+				continue;
+			}
+			valid = similarityFromTwo(keypoints1[matches1to2[first].queryIdx],
+					keypoints2[matches1to2[first].trainIdx],
+					keypoints1[matches1to2[second].queryIdx],
+					keypoints2[matches1to2[second].trainIdx], h);
+		}
+
+		if (valid == false) {
+			continue;
+		}
+
+		int inliers = countInliers(keypoints1, keypoints2, matches1to2, h,
+				sqThreshold, NULL);
+
+		if (inliers > bestInliers) {
+			bestInliers = inliers;
+			std::copy(h, h + 9, best);
+
+			// Early termination once the required confidence is reached
+			double w = std::pow(double(inliers) / N, sampleSize);
+			if (w >= 1.0) {
+				break;
+			}
+			double k = std::log(1.0 - confidence) / std::log(1.0 - w);
+			if (k < iterations) {
+				iterations = std::max(t, int(std::ceil(k)));
+			}
+		}
+	}
+
+	if (bestInliers == 0) {
+		return 0;
+	}
+
+	countInliers(keypoints1, keypoints2, matches1to2, best, sqThreshold,
+			&inliersMask);
+
+	// Optional refinement, kept only when it does not lose inliers
+	if (refine != REFINE_NONE) {
+		bool refined =
+				refine == REFINE_AFFINE ?
+						refineAffine(keypoints1, keypoints2, matches1to2,
+								inliersMask, bestInliers, h) :
+						refineHomography(keypoints1, keypoints2, matches1to2,
+								inliersMask, bestInliers, h);
+		if (refined) {
+			std::vector<uchar> refinedMask(matches1to2.size());
+			int inliers = countInliers(keypoints1, keypoints2, matches1to2, h,
+					sqThreshold, &refinedMask);
+			if (inliers >= bestInliers) {
+				bestInliers = inliers;
+				std::copy(h, h + 9, best);
+				inliersMask.swap(refinedMask);
+			}
+		}
+	}
+
+	cv::Mat(3, 3, CV_64F, best).copyTo(model);
+
+	return bestInliers;
+}
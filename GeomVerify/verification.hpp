@@ -0,0 +1,74 @@
+/*
+ * verification.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: andresf
+ */
+
+#ifndef VERIFICATION_HPP_
+#define VERIFICATION_HPP_
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/features2d/features2d.hpp>
+
+/**
+ * Weak geometric consistency (WGC) check in the manner of Jegou et al.
+ *
+ * Every putative match votes in a histogram of log-scale ratios and in a histogram
+ * of orientation differences, the consistent matches are those falling in (or next to)
+ * the best bin of both histograms. Key-points without orientation (angle < 0) vote
+ * for a null orientation difference.
+ *
+ * @param keypoints1 - Key-points indexed by the queryIdx of the matches
+ * @param keypoints2 - Key-points indexed by the trainIdx of the matches
+ * @param matches1to2 - Putative matches
+ * @param consistentMatches - Output vector of geometrically consistent matches
+ * @param scaleBins - Number of bins of the log-scale ratio histogram
+ * @param angleBins - Number of bins of the orientation difference histogram
+ * @return The number of consistent matches, usable as a score on its own
+ */
+int weakGeometricConsistency(const std::vector<cv::KeyPoint>& keypoints1,
+		const std::vector<cv::KeyPoint>& keypoints2,
+		const std::vector<cv::DMatch>& matches1to2,
+		std::vector<cv::DMatch>& consistentMatches, int scaleBins = 8,
+		int angleBins = 12);
+
+/**
+ * Model estimated after the similarity hypothesis by similarityRansac.
+ */
+enum RefineType {
+	REFINE_NONE = 0, REFINE_AFFINE = 1, REFINE_HOMOGRAPHY = 2
+};
+
+/**
+ * RANSAC estimation of a similarity transform mapping keypoints1 onto keypoints2.
+ *
+ * When every matched key-point carries an orientation, a single correspondence
+ * hypothesizes the transform from its scale ratio, orientation difference and position,
+ * otherwise two correspondences are used. Samples are drawn in PROSAC order, i.e. the
+ * matches are sorted by distance and the sampling set grows progressively, and the loop
+ * stops as soon as the probability of having missed a better model drops below
+ * 1 - confidence. The best hypothesis can be refined by least squares to an affine
+ * transform or to a homography over its inliers.
+ *
+ * @param keypoints1 - Key-points indexed by the queryIdx of the matches
+ * @param keypoints2 - Key-points indexed by the trainIdx of the matches
+ * @param matches1to2 - Putative matches
+ * @param model - Output 3x3 transform of type CV_64F
+ * @param inliersMask - Output mask, one entry per match set to 1 for the inliers
+ * @param threshold - Maximum re-projection error in pixels for a match to be an inlier
+ * @param confidence - Probability of having found the best model required to stop
+ * @param maxIterations - Maximum number of hypotheses to evaluate
+ * @param refine - One of REFINE_NONE, REFINE_AFFINE or REFINE_HOMOGRAPHY
+ * @return The number of inliers
+ */
+int similarityRansac(const std::vector<cv::KeyPoint>& keypoints1,
+		const std::vector<cv::KeyPoint>& keypoints2,
+		const std::vector<cv::DMatch>& matches1to2, cv::Mat& model,
+		std::vector<uchar>& inliersMask, double threshold,
+		double confidence = 0.99, int maxIterations = 1000, int refine =
+				REFINE_NONE);
+
+#endif /* VERIFICATION_HPP_ */
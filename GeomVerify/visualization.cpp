@@ -0,0 +1,85 @@
+/*
+ * visualization.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: andresf
+ */
+
+#include <stdio.h>
+
+#include <opencv2/highgui/highgui.hpp>
+
+#include <visualization.hpp>
+
+MatchesVisualizer::MatchesVisualizer(const std::string& imagesFolder,
+		const std::string& imagesExtension, const std::string& outputFolder,
+		double rate) :
+		m_imagesFolder(imagesFolder), m_imagesExtension(imagesExtension), m_outputFolder(
+				outputFolder), m_rate(rate), m_rng(0xFFFFFFFF) {
+}
+
+// --------------------------------------------------------------------------
+
+bool MatchesVisualizer::sample() {
+
+	if (enabled() == false) {
+		return false;
+	}
+
+	return m_rate >= 1.0 || m_rng.uniform(0.0, 1.0) < m_rate;
+}
+
+// --------------------------------------------------------------------------
+
+void MatchesVisualizer::write(const std::string& queryBase,
+		const std::vector<cv::KeyPoint>& queryKeypoints,
+		const std::string& candidateBase,
+		const std::vector<cv::KeyPoint>& candidateKeypoints,
+		const std::vector<cv::DMatch>& matchesCandidateToQuery) {
+
+	if (m_queryBase.compare(queryBase) != 0) {
+		m_queryImg = loadImage(queryBase);
+		m_queryBase = queryBase;
+	}
+
+	cv::Mat candidateImg =
+			m_queryImg.empty() ? cv::Mat() : loadImage(candidateBase);
+
+	// Rendering is optional, a missing image only skips the pair
+	if (m_queryImg.empty() || candidateImg.empty()) {
+		return;
+	}
+
+	std::string filename = m_outputFolder + "/match_" + queryBase + "_"
+			+ candidateBase + ".jpg";
+
+	try {
+		cv::Mat imgOut;
+		cv::drawMatches(candidateImg, candidateKeypoints, m_queryImg,
+				queryKeypoints, matchesCandidateToQuery, imgOut);
+		if (cv::imwrite(filename, imgOut) == false) {
+			fprintf(stderr, "[MatchesVisualizer::write] Failed to write [%s],"
+					" skipping it\n", filename.c_str());
+		}
+	} catch (const cv::Exception& error) {
+		fprintf(stderr, "[MatchesVisualizer::write] Failed to render [%s],"
+				" skipping it: %s\n", filename.c_str(), error.what());
+	}
+
+}
+
+// --------------------------------------------------------------------------
+
+cv::Mat MatchesVisualizer::loadImage(const std::string& base) const {
+
+	std::string filename = m_imagesFolder + "/" + base + m_imagesExtension;
+
+	cv::Mat img = cv::imread(filename, CV_LOAD_IMAGE_GRAYSCALE);
+
+	if (img.empty()) {
+		fprintf(stderr, "[MatchesVisualizer::loadImage] Failed to load image [%s],"
+				" skipping its renderings\n", filename.c_str());
+	}
+
+	return img;
+}
@@ -0,0 +1,86 @@
+/*
+ * visualization.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: andresf
+ */
+
+#ifndef VISUALIZATION_HPP_
+#define VISUALIZATION_HPP_
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/features2d/features2d.hpp>
+
+/**
+ * Optional sink rendering the inlier matches of a sampled subset of query/candidate pairs.
+ *
+ * Images are only decoded for the sampled pairs, the query image is decoded once and kept
+ * until a different query is rendered. When no images folder is given or the sampling rate
+ * is zero the sink is disabled and never touches the images.
+ */
+class MatchesVisualizer {
+public:
+
+	/**
+	 * @param imagesFolder - Folder containing the images, empty disables the sink
+	 * @param imagesExtension - Extension appended to the images base names, e.g. .jpg
+	 * @param outputFolder - Folder where the renderings are written
+	 * @param rate - Fraction of pairs to render, between 0 and 1
+	 */
+	MatchesVisualizer(const std::string& imagesFolder = "",
+			const std::string& imagesExtension = ".jpg",
+			const std::string& outputFolder = ".", double rate = 0.0);
+
+	bool enabled() const {
+		return m_imagesFolder.empty() == false && m_rate > 0.0;
+	}
+
+	/**
+	 * Decides whether the next pair is to be rendered, sampling is deterministic
+	 * so that repeated runs render the same pairs.
+	 *
+	 * @return True if the pair must be passed to write
+	 */
+	bool sample();
+
+	/**
+	 * Renders the matches between candidate and query and writes them to
+	 * <outputFolder>/match_<queryBase>_<candidateBase>.jpg. Never throws, a pair whose
+	 * images cannot be read or whose rendering cannot be written is skipped with a
+	 * message on stderr.
+	 *
+	 * @param queryBase - Base name of the query image
+	 * @param queryKeypoints - Query key-points, indexed by trainIdx
+	 * @param candidateBase - Base name of the candidate image
+	 * @param candidateKeypoints - Candidate key-points, indexed by queryIdx
+	 * @param matchesCandidateToQuery - Matches to render
+	 */
+	void write(const std::string& queryBase,
+			const std::vector<cv::KeyPoint>& queryKeypoints,
+			const std::string& candidateBase,
+			const std::vector<cv::KeyPoint>& candidateKeypoints,
+			const std::vector<cv::DMatch>& matchesCandidateToQuery);
+
+private:
+
+	/**
+	 * @return The grayscale image, empty if it cannot be read
+	 */
+	cv::Mat loadImage(const std::string& base) const;
+
+	std::string m_imagesFolder;
+	std::string m_imagesExtension;
+	std::string m_outputFolder;
+	double m_rate;
+	cv::RNG m_rng;
+
+	// Last rendered query
+	std::string m_queryBase;
+	cv::Mat m_queryImg;
+
+};
+
+#endif /* VISUALIZATION_HPP_ */
@@ -0,0 +1,527 @@
+/*
+ * HCForestIndex.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: andresf
+ */
+
+#ifndef HCFORESTINDEX_HPP_
+#define HCFORESTINDEX_HPP_
+
+#include <opencv2/flann/flann.hpp>
+#include <opencv2/flann/random.h>
+
+#include <FunctionUtils.hpp>
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace vlr {
+
+// Algorithm reported by the forest index, not one of the cvflann algorithms
+static const cvflann::flann_algorithm_t HCFOREST_ALGORITHM =
+		cvflann::flann_algorithm_t(128);
+
+// Minimum number of queries searched by every thread of a batch
+static const int HCFOREST_MIN_QUERIES_PER_THREAD = 1024;
+
+struct HCForestIndexParams: public cvflann::IndexParams {
+	HCForestIndexParams(int trees = 4, int branching = 32, int leafSize = 100,
+			int checks = 32, int numThreads = 0) {
+		// Number of randomized trees
+		(*this)["trees"] = trees;
+		// Branching factor of the trees
+		(*this)["branching"] = branching;
+		// Maximum number of points in a leaf
+		(*this)["leaf_size"] = leafSize;
+		// Number of points compared to a query before the search stops
+		(*this)["checks"] = checks;
+		// Threads building the trees and searching batches of queries, zero or negative
+		// to use all available cores
+		(*this)["num.threads"] = numThreads;
+	}
+};
+
+/**
+ * Forest of randomized hierarchical clustering trees, built as HCTree: every node is
+ * split around branching data points chosen at random until at most leaf_size points
+ * are left. Every tree draws its own centers, hence the trees differ and are built in
+ * parallel.
+ *
+ * Searches are best-bin-first over all the trees at once: the nearest child of every
+ * node is followed down to a leaf while the other children are kept in a priority
+ * queue by the distance to their center, the search then continues from the closest
+ * node in the queue until checks points were compared to the query. Batches of
+ * queries are split among the threads.
+ *
+ * The data is not copied, the matrix must outlive the index.
+ */
+template<typename Distance>
+class HCForestIndex: public cvflann::NNIndex<Distance> {
+
+public:
+
+	typedef typename Distance::ElementType ElementType;
+	typedef typename Distance::ResultType DistanceType;
+
+private:
+
+	struct Node {
+		// Index of the data point which is the center of the node
+		int pivot;
+		// Position of the node in the forest in depth-first order, breaks the ties
+		// between branches so searches do not depend on where the nodes were allocated
+		int id;
+		// Children nodes, empty for leaves
+		std::vector<Node*> children;
+		// Data points of a leaf
+		std::vector<int> points;
+	};
+
+	typedef std::pair<DistanceType, Node*> Branch;
+
+	// Branch order in the search queue, the closest on top
+	struct FartherBranch {
+		bool operator()(const Branch& a, const Branch& b) const {
+			return a.first > b.first
+					|| (a.first == b.first && a.second->id > b.second->id);
+		}
+	};
+
+	typedef std::priority_queue<Branch, std::vector<Branch>, FartherBranch> BranchHeap;
+
+public:
+
+	/**
+	 * Class constructor.
+	 *
+	 * @param dataset - The data to index
+	 * @param params - Parameters to the index, see HCForestIndexParams
+	 * @param distance - The distance functor
+	 */
+	HCForestIndex(const cvflann::Matrix<ElementType>& dataset,
+			const cvflann::IndexParams& params = HCForestIndexParams(),
+			Distance distance = Distance()) :
+			m_dataset(dataset), m_params(params), m_distance(distance) {
+
+		m_numTrees = std::max(1, cvflann::get_param(params, "trees", 4));
+		m_branching = cvflann::get_param(params, "branching", 32);
+		m_leafSize = std::max(1, cvflann::get_param(params, "leaf_size", 100));
+		m_checks = cvflann::get_param(params, "checks", 32);
+		m_numThreads = cvflann::get_param(params, "num.threads", 0);
+		if (m_numThreads <= 0) {
+			m_numThreads = std::max(1, int(std::thread::hardware_concurrency()));
+		}
+
+		if (m_branching < 2) {
+			throw std::runtime_error("[HCForestIndex::HCForestIndex] "
+					"Branching factor must be at least 2");
+		}
+
+	}
+
+	/**
+	 * Class destroyer, releases the trees.
+	 */
+	virtual ~HCForestIndex() {
+		freeTrees();
+	}
+
+	/**
+	 * Builds the trees, each one on its own thread.
+	 */
+	void buildIndex() {
+
+		freeTrees();
+
+		int numPoints = m_dataset.rows;
+		m_roots.assign(m_numTrees, NULL);
+
+		// Seeds are drawn up front so the forest only depends on the global seed
+		std::vector<unsigned> seeds(m_numTrees);
+		for (int t = 0; t < m_numTrees; ++t) {
+			seeds[t] = unsigned(cvflann::rand_int(RAND_MAX));
+		}
+
+		int numThreads = std::min(m_numThreads, m_numTrees);
+		FunctionUtils::runPartitioned(
+				FunctionUtils::splitEvenly(m_numTrees, numThreads),
+				[&](int, int begin, int end) {
+					std::vector<int> indices(numPoints);
+					for (int t = begin; t < end; ++t) {
+						for (int i = 0; i < numPoints; ++i) {
+							indices[i] = i;
+						}
+						std::mt19937 random(seeds[t]);
+						m_roots[t] = new Node();
+						m_roots[t]->pivot = -1;
+						computeClustering(m_roots[t], indices.data(), numPoints,
+								random);
+					}
+				});
+
+		numberNodes();
+
+	}
+
+	/**
+	 * Searches the nearest neighbors of a batch of queries. Large batches are split
+	 * among the threads, the search parameter "num.threads" overrides the number of
+	 * threads of the index, e.g. 1 when the caller already searches in parallel.
+	 */
+	void knnSearch(const cvflann::Matrix<ElementType>& queries,
+			cvflann::Matrix<int>& indices, cvflann::Matrix<DistanceType>& dists,
+			int knn, const cvflann::SearchParams& params) {
+
+		CV_Assert(queries.cols == veclen());
+		CV_Assert(indices.rows >= queries.rows && dists.rows >= queries.rows);
+		CV_Assert(int(indices.cols) >= knn && int(dists.cols) >= knn);
+
+		int numQueries = queries.rows;
+		int numThreads = cvflann::get_param(params, "num.threads", m_numThreads);
+		numThreads = std::max(1,
+				std::min(numThreads,
+						numQueries / HCFOREST_MIN_QUERIES_PER_THREAD));
+
+		std::function<void(int, int, int)> search =
+				[&](int, int begin, int end) {
+					cvflann::KNNResultSet<DistanceType> resultSet(knn);
+					for (int q = begin; q < end; ++q) {
+						std::fill(indices[q], indices[q] + knn, -1);
+						resultSet.init(indices[q], dists[q]);
+						findNeighbors(resultSet, queries[q], params);
+					}
+				};
+
+		// Small batches are searched on the calling thread
+		if (numThreads == 1) {
+			search(0, 0, numQueries);
+			return;
+		}
+
+		FunctionUtils::runPartitioned(
+				FunctionUtils::splitEvenly(numQueries, numThreads), search);
+
+	}
+
+	/**
+	 * Best-bin-first search over all the trees.
+	 */
+	void findNeighbors(cvflann::ResultSet<DistanceType>& result,
+			const ElementType* vec, const cvflann::SearchParams& searchParams) {
+
+		int maxChecks = m_checks > 0 ?
+				m_checks : cvflann::get_param(searchParams, "checks", 32);
+
+		BranchHeap heap;
+		// Points are shared by the trees, every one is compared only once
+		std::unordered_set<int> checked;
+		int checks = 0;
+
+		for (size_t t = 0; t < m_roots.size(); ++t) {
+			searchTree(m_roots[t], result, vec, heap, checked, checks, maxChecks);
+		}
+
+		while (heap.empty() == false
+				&& (checks < maxChecks || result.full() == false)) {
+			Node* node = heap.top().second;
+			heap.pop();
+			searchTree(node, result, vec, heap, checked, checks, maxChecks);
+		}
+
+	}
+
+	/**
+	 * Saves the trees, the data must be saved apart.
+	 */
+	void saveIndex(FILE* stream) {
+		int32_t header[] = { m_numTrees, m_branching, m_leafSize, m_checks };
+		fwrite(header, sizeof(header), 1, stream);
+		for (size_t t = 0; t < m_roots.size(); ++t) {
+			saveTree(stream, m_roots[t]);
+		}
+	}
+
+	/**
+	 * Loads the trees saved by saveIndex, over the same data.
+	 */
+	void loadIndex(FILE* stream) {
+		freeTrees();
+		int32_t header[4];
+		if (fread(header, sizeof(header), 1, stream) != 1) {
+			throw std::runtime_error("[HCForestIndex::loadIndex] "
+					"Unable to read the index header");
+		}
+		m_numTrees = header[0];
+		m_branching = header[1];
+		m_leafSize = header[2];
+		m_checks = header[3];
+		m_params["trees"] = m_numTrees;
+		m_params["branching"] = m_branching;
+		m_params["leaf_size"] = m_leafSize;
+		m_params["checks"] = m_checks;
+		m_roots.assign(m_numTrees, NULL);
+		for (int t = 0; t < m_numTrees; ++t) {
+			m_roots[t] = loadTree(stream);
+		}
+		numberNodes();
+	}
+
+	size_t size() const {
+		return m_dataset.rows;
+	}
+
+	size_t veclen() const {
+		return m_dataset.cols;
+	}
+
+	int usedMemory() const {
+		size_t bytes = 0;
+		for (size_t t = 0; t < m_roots.size(); ++t) {
+			bytes += treeMemory(m_roots[t]);
+		}
+		return int(bytes);
+	}
+
+	cvflann::flann_algorithm_t getType() const {
+		return HCFOREST_ALGORITHM;
+	}
+
+	cvflann::IndexParams getParameters() const {
+		return m_params;
+	}
+
+private:
+
+	/**
+	 * Recursively splits the points of a node around randomly chosen centers.
+	 *
+	 * @param node - The node to split
+	 * @param indices - Indices of the points of the node, reordered by cluster
+	 * @param length - Number of points
+	 * @param random - Random generator of the tree
+	 */
+	void computeClustering(Node* node, int* indices, int length,
+			std::mt19937& random) {
+
+		// Recursion base case: done when the maximum leaf size is reached
+		// or when there is less data than clusters
+		if (length <= m_leafSize || length < m_branching) {
+			node->points.assign(indices, indices + length);
+			return;
+		}
+
+		// Move branching distinct points chosen at random to the front, they are the centers
+		for (int j = 0; j < m_branching; ++j) {
+			int r = j + int(random() % unsigned(length - j));
+			std::swap(indices[j], indices[r]);
+		}
+
+		std::vector<int> belongsTo(length);
+		std::vector<int> count(m_branching + 1, 0);
+		for (int i = 0; i < length; ++i) {
+			const ElementType* point = m_dataset[indices[i]];
+			DistanceType bestDist = m_distance(point, m_dataset[indices[0]],
+					veclen());
+			int best = 0;
+			for (int j = 1; j < m_branching; ++j) {
+				DistanceType dist = m_distance(point, m_dataset[indices[j]],
+						veclen());
+				if (bestDist > dist) {
+					best = j;
+					bestDist = dist;
+				}
+			}
+			belongsTo[i] = best;
+			++count[best + 1];
+		}
+
+		// All points fell in one cluster, e.g. duplicates, splitting would never end
+		if (*std::max_element(count.begin(), count.end()) == length) {
+			node->points.assign(indices, indices + length);
+			return;
+		}
+
+		node->children.resize(m_branching);
+		for (int j = 0; j < m_branching; ++j) {
+			node->children[j] = new Node();
+			node->children[j]->pivot = indices[j];
+			count[j + 1] += count[j];
+		}
+
+		// Re-order indices by chunks in clustering order
+		std::vector<int> sorted(length);
+		std::vector<int> next(count.begin(), count.end() - 1);
+		for (int i = 0; i < length; ++i) {
+			sorted[next[belongsTo[i]]++] = indices[i];
+		}
+		std::copy(sorted.begin(), sorted.end(), indices);
+
+		for (int j = 0; j < m_branching; ++j) {
+			computeClustering(node->children[j], indices + count[j],
+					count[j + 1] - count[j], random);
+		}
+
+	}
+
+	/**
+	 * Follows the nearest children down to a leaf, queueing the other children.
+	 */
+	void searchTree(Node* node, cvflann::ResultSet<DistanceType>& result,
+			const ElementType* vec, BranchHeap& heap,
+			std::unordered_set<int>& checked, int& checks, int maxChecks) {
+
+		while (node->children.empty() == false) {
+			int best = 0;
+			DistanceType bestDist = m_distance(vec,
+					m_dataset[node->children[0]->pivot], veclen());
+			std::vector<DistanceType> dists(m_branching);
+			dists[0] = bestDist;
+			for (int j = 1; j < m_branching; ++j) {
+				dists[j] = m_distance(vec, m_dataset[node->children[j]->pivot],
+						veclen());
+				if (bestDist > dists[j]) {
+					best = j;
+					bestDist = dists[j];
+				}
+			}
+			for (int j = 0; j < m_branching; ++j) {
+				if (j != best) {
+					heap.push(Branch(dists[j], node->children[j]));
+				}
+			}
+			node = node->children[best];
+		}
+
+		if (checks >= maxChecks && result.full()) {
+			return;
+		}
+
+		for (size_t p = 0; p < node->points.size(); ++p) {
+			int index = node->points[p];
+			if (checked.insert(index).second == false) {
+				continue;
+			}
+			result.addPoint(m_distance(vec, m_dataset[index], veclen()), index);
+			++checks;
+		}
+
+	}
+
+	/**
+	 * Numbers the nodes of the forest tree by tree in depth-first order.
+	 */
+	void numberNodes() {
+		int id = 0;
+		std::vector<Node*> stack;
+		for (size_t t = 0; t < m_roots.size(); ++t) {
+			stack.push_back(m_roots[t]);
+			while (stack.empty() == false) {
+				Node* node = stack.back();
+				stack.pop_back();
+				node->id = id++;
+				for (size_t c = node->children.size(); c > 0; --c) {
+					stack.push_back(node->children[c - 1]);
+				}
+			}
+		}
+	}
+
+	void saveTree(FILE* stream, const Node* node) const {
+		int32_t fields[] = { node->pivot, int32_t(node->children.size()),
+				int32_t(node->points.size()) };
+		fwrite(fields, sizeof(fields), 1, stream);
+		if (node->points.empty() == false) {
+			fwrite(node->points.data(), sizeof(int), node->points.size(),
+					stream);
+		}
+		for (size_t c = 0; c < node->children.size(); ++c) {
+			saveTree(stream, node->children[c]);
+		}
+	}
+
+	Node* loadTree(FILE* stream) {
+		int32_t fields[3];
+		if (fread(fields, sizeof(fields), 1, stream) != 1) {
+			throw std::runtime_error("[HCForestIndex::loadTree] "
+					"Unable to read the index trees");
+		}
+		Node* node = new Node();
+		node->pivot = fields[0];
+		node->points.resize(fields[2]);
+		if (fields[2] > 0
+				&& fread(node->points.data(), sizeof(int), fields[2], stream)
+						!= size_t(fields[2])) {
+			delete node;
+			throw std::runtime_error("[HCForestIndex::loadTree] "
+					"Unable to read the index trees");
+		}
+		node->children.resize(fields[1]);
+		for (int c = 0; c < fields[1]; ++c) {
+			node->children[c] = loadTree(stream);
+		}
+		return node;
+	}
+
+	size_t treeMemory(const Node* node) const {
+		size_t bytes = sizeof(Node) + node->points.size() * sizeof(int)
+				+ node->children.size() * sizeof(Node*);
+		for (size_t c = 0; c < node->children.size(); ++c) {
+			bytes += treeMemory(node->children[c]);
+		}
+		return bytes;
+	}
+
+	void freeTree(Node* node) {
+		for (size_t c = 0; c < node->children.size(); ++c) {
+			freeTree(node->children[c]);
+		}
+		delete node;
+	}
+
+	void freeTrees() {
+		for (size_t t = 0; t < m_roots.size(); ++t) {
+			if (m_roots[t] != NULL) {
+				freeTree(m_roots[t]);
+			}
+		}
+		m_roots.clear();
+	}
+
+	// Non-copyable, the trees are owned
+	HCForestIndex(const HCForestIndex&);
+	HCForestIndex& operator=(const HCForestIndex&);
+
+	// The indexed data
+	const cvflann::Matrix<ElementType> m_dataset;
+	cvflann::IndexParams m_params;
+	Distance m_distance;
+	// Number of trees
+	int m_numTrees;
+	// Branching factor of the trees
+	int m_branching;
+	// Maximum number of points in a leaf
+	int m_leafSize;
+	// Number of points compared to a query, zero or negative to take it from the
+	// search parameters
+	int m_checks;
+	// Number of threads building the trees and searching batches of queries
+	int m_numThreads;
+	// Root of every tree
+	std::vector<Node*> m_roots;
+
+};
+
+} /* namespace vlr */
+
+#endif /* HCFORESTINDEX_HPP_ */
@@ -28,6 +28,8 @@ struct HCTreeParams: public cvflann::IndexParams {
 		(*this)["branching"] = branching;
 		// Maximum leaf size
 		(*this)["maxLeafSize"] = maxLeafSize;
+		// Maximum size (in Bytes) of the local copy of the data of a node
+		(*this)["staging.max.bytes"] = 1 << 30;
 	}
 };
 
@@ -81,6 +83,8 @@ protected:
 	// Threshold on the number of points inside a cluster
 	// to consider a node as a leaf
 	int m_maxLeafSize;
+	// Maximum size (in Bytes) of the local copy of the data of a node
+	int m_stagingMaxBytes;
 	// Length of each feature
 	size_t m_veclen;
 	// Number of nodes in the tree
@@ -194,9 +198,11 @@ private:
 	 * @param indices_length
 	 * @param level
 	 * @param fitted
+	 * @param staged - Local copy of the data of the node, one row per index, or an
+	 * empty matrix if it is read from the data set
 	 */
 	void computeClustering(HCTreeNodePtr node, int* indices, int indices_length,
-			int level, bool fitted);
+			int level, bool fitted, cv::Mat staged = cv::Mat());
 
 	/**
 	 * Saves to a stream the tree starting at a given node.
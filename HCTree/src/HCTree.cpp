@@ -6,6 +6,7 @@
  */
 
 #include <HCTree.hpp>
+#include <DataStaging.hpp>
 
 #include <fstream>
 
@@ -18,6 +19,7 @@ HCTree::HCTree(vlr::Mat& inputData, const HCTreeParams& params) :
 	// Attributes initialization
 	m_branching = cvflann::get_param(params, "branching", 16);
 	m_maxLeafSize = cvflann::get_param(params, "maxLeafSize", 150);
+	m_stagingMaxBytes = cvflann::get_param(params, "staging.max.bytes", 1 << 30);
 	m_veclen = m_dataset.cols;
 
 }
@@ -359,7 +361,7 @@ void HCTree::build() {
 // --------------------------------------------------------------------------
 
 void HCTree::computeClustering(HCTreeNodePtr node, int* indices,
-		int indices_length, int level, bool fitted) {
+		int indices_length, int level, bool fitted, cv::Mat staged) {
 
 	// Assign node id then increase nodes counter
 	node->nodeId = m_size++;
@@ -367,7 +369,11 @@ void HCTree::computeClustering(HCTreeNodePtr node, int* indices,
 	// Sort descriptors, caching leverages this fact
 	// Note: it doesn't affect the clustering process since all descriptors referenced by indices belong to the same cluster
 	if (level > 0) {
-		std::sort(indices, indices + indices_length);
+		if (staged.empty()) {
+			std::sort(indices, indices + indices_length);
+		} else {
+			DataStaging::sortByIndex(indices, indices_length, staged);
+		}
 	}
 
 	// Recursion base case: done when the minimum leaf size was reached
@@ -386,6 +392,13 @@ void HCTree::computeClustering(HCTreeNodePtr node, int* indices,
 			level, indices_length);
 #endif
 
+	// Copy the data of the node once, the sub-trees then read it locally
+	// instead of fetching it from the data set at every level
+	if (staged.empty()) {
+		DataStaging::gather(m_dataset, indices, indices_length,
+				m_stagingMaxBytes, staged);
+	}
+
 	std::vector<int> centers_idx(m_branching);
 	int centers_length;
 
@@ -446,14 +459,21 @@ void HCTree::computeClustering(HCTreeNodePtr node, int* indices,
 #endif
 
 	std::vector<int> belongs_to(indices_length);
+	cv::Mat fetched;
 	for (int i = 0; i < indices_length; ++i) {
-		DistanceType sq_dist = m_distance(
-				(TDescriptor*) m_dataset.row(indices[i]).data,
+		// Fetch every descriptor once, not once per center
+		TDescriptor* descriptor;
+		if (staged.empty() == false) {
+			descriptor = staged.ptr<TDescriptor>(i);
+		} else {
+			fetched = m_dataset.row(indices[i]);
+			descriptor = (TDescriptor*) fetched.data;
+		}
+		DistanceType sq_dist = m_distance(descriptor,
 				(TDescriptor*) dcenters.row(0).data, m_veclen);
 		belongs_to[i] = 0;
 		for (int j = 1; j < m_branching; ++j) {
-			DistanceType new_sq_dist = m_distance(
-					(TDescriptor*) m_dataset.row(indices[i]).data,
+			DistanceType new_sq_dist = m_distance(descriptor,
 					(TDescriptor*) dcenters.row(j).data, m_veclen);
 			if (sq_dist > new_sq_dist) {
 				belongs_to[i] = j;
@@ -489,11 +509,14 @@ void HCTree::computeClustering(HCTreeNodePtr node, int* indices,
 				"level=[%d] branch=[%d]\n", level, c);
 #endif
 
-		// Re-order indices by chunks in clustering order
+		// Re-order indices by chunks in clustering order, along with the staged data
 		for (int i = 0; i < indices_length; ++i) {
 			if (belongs_to[i] == c) {
 				std::swap(indices[i], indices[end]);
 				std::swap(belongs_to[i], belongs_to[end]);
+				if (staged.empty() == false) {
+					DataStaging::swapRows(staged, i, end);
+				}
 				++end;
 			}
 		}
@@ -501,7 +524,8 @@ void HCTree::computeClustering(HCTreeNodePtr node, int* indices,
 		node->children[c] = new HCTreeNode();
 		node->children[c]->center = centers[c];
 		computeClustering(node->children[c], indices + start, end - start,
-				level + 1, fitted);
+				level + 1, fitted,
+				staged.empty() ? cv::Mat() : staged.rowRange(start, end));
 		start = end;
 	}
 
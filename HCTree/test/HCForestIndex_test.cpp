@@ -0,0 +1,141 @@
+/*
+ * HCForestIndex_test.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: andresf
+ */
+
+#include <gtest/gtest.h>
+#include <HCForestIndex.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include <cstdio>
+#include <cstring>
+
+typedef cvflann::Hamming<uchar> Distance;
+typedef Distance::ResultType DistanceType;
+
+static void search(cvflann::NNIndex<Distance>& index, const cv::Mat& queries,
+		int knn, cv::Mat& indices, cv::Mat& dists) {
+	indices.create(queries.rows, knn, CV_32S);
+	dists.create(queries.rows, knn, CV_32S);
+	cvflann::Matrix<int> nnIndices((int*) indices.data, indices.rows, knn);
+	cvflann::Matrix<DistanceType> nnDists((DistanceType*) dists.data,
+			dists.rows, knn);
+	index.knnSearch(
+			cvflann::Matrix<uchar>(queries.data, queries.rows, queries.cols),
+			nnIndices, nnDists, knn, cvflann::SearchParams());
+}
+
+static bool equal(const cv::Mat& a, const cv::Mat& b) {
+	return a.size() == b.size() && a.type() == b.type()
+			&& memcmp(a.data, b.data, a.total() * a.elemSize()) == 0;
+}
+
+TEST(HCForestIndex, ExactWithFullChecks) {
+
+	cv::Mat data(2000, 32, CV_8U);
+	cv::randu(data, cv::Scalar::all(0), cv::Scalar::all(256));
+	cvflann::Matrix<uchar> dataset(data.data, data.rows, data.cols);
+
+	// Checking every point makes the search exhaustive
+	vlr::HCForestIndex<Distance> forest(dataset,
+			vlr::HCForestIndexParams(4, 8, 20, data.rows));
+	forest.buildIndex();
+	cvflann::LinearIndex<Distance> linear(dataset,
+			cvflann::LinearIndexParams());
+	linear.buildIndex();
+
+	cv::Mat queries = data.rowRange(0, 100).clone();
+	queries.col(0) ^= cv::Scalar(1);
+
+	cv::Mat forestIndices, forestDists, linearIndices, linearDists;
+	search(forest, queries, 3, forestIndices, forestDists);
+	search(linear, queries, 3, linearIndices, linearDists);
+
+	EXPECT_TRUE(equal(forestDists, linearDists));
+
+}
+
+TEST(HCForestIndex, FindsDataPoints) {
+
+	cv::Mat data(5000, 32, CV_8U);
+	cv::randu(data, cv::Scalar::all(0), cv::Scalar::all(256));
+
+	vlr::HCForestIndex<Distance> forest(
+			cvflann::Matrix<uchar>(data.data, data.rows, data.cols),
+			vlr::HCForestIndexParams(4, 16, 50, 64));
+	forest.buildIndex();
+
+	cv::Mat indices, dists;
+	search(forest, data, 1, indices, dists);
+
+	// Every point lies in the leaf its own descent ends at
+	for (int i = 0; i < data.rows; ++i) {
+		EXPECT_EQ(0, dists.at<int>(i, 0));
+	}
+
+}
+
+TEST(HCForestIndex, SameResultsAcrossThreads) {
+
+	cv::Mat data(3000, 32, CV_8U);
+	cv::randu(data, cv::Scalar::all(0), cv::Scalar::all(256));
+	cvflann::Matrix<uchar> dataset(data.data, data.rows, data.cols);
+
+	// Enough queries to split the search among the threads
+	cv::Mat queries(4 * vlr::HCFOREST_MIN_QUERIES_PER_THREAD, 32, CV_8U);
+	cv::randu(queries, cv::Scalar::all(0), cv::Scalar::all(256));
+
+	cvflann::seed_random(7);
+	vlr::HCForestIndex<Distance> serial(dataset,
+			vlr::HCForestIndexParams(4, 8, 20, 32, 1));
+	serial.buildIndex();
+
+	cvflann::seed_random(7);
+	vlr::HCForestIndex<Distance> parallel(dataset,
+			vlr::HCForestIndexParams(4, 8, 20, 32, 4));
+	parallel.buildIndex();
+
+	cv::Mat serialIndices, serialDists, parallelIndices, parallelDists;
+	search(serial, queries, 5, serialIndices, serialDists);
+	search(parallel, queries, 5, parallelIndices, parallelDists);
+
+	EXPECT_TRUE(equal(serialIndices, parallelIndices));
+	EXPECT_TRUE(equal(serialDists, parallelDists));
+
+}
+
+TEST(HCForestIndex, SaveLoad) {
+
+	cv::Mat data(3000, 32, CV_8U);
+	cv::randu(data, cv::Scalar::all(0), cv::Scalar::all(256));
+	cvflann::Matrix<uchar> dataset(data.data, data.rows, data.cols);
+
+	vlr::HCForestIndex<Distance> forest(dataset,
+			vlr::HCForestIndexParams(4, 8, 20, 32));
+	forest.buildIndex();
+
+	FILE* stream = fopen("test_forest.bin", "wb");
+	ASSERT_TRUE(stream != NULL);
+	forest.saveIndex(stream);
+	fclose(stream);
+
+	vlr::HCForestIndex<Distance> loaded(dataset);
+	stream = fopen("test_forest.bin", "rb");
+	ASSERT_TRUE(stream != NULL);
+	loaded.loadIndex(stream);
+	fclose(stream);
+
+	cv::Mat queries(200, 32, CV_8U);
+	cv::randu(queries, cv::Scalar::all(0), cv::Scalar::all(256));
+
+	cv::Mat indices, dists, loadedIndices, loadedDists;
+	search(forest, queries, 5, indices, dists);
+	search(loaded, queries, 5, loadedIndices, loadedDists);
+
+	EXPECT_TRUE(equal(indices, loadedIndices));
+	EXPECT_TRUE(equal(dists, loadedDists));
+
+}
@@ -12,14 +12,17 @@
 #include <opencv2/features2d/features2d.hpp>
 #include <opencv2/flann/flann.hpp>
 
+#include <BinaryVocabFile.hpp>
 #include <DynamicMat.hpp>
 #include <VocabBase.hpp>
 
 namespace vlr {
 
 struct IncrementalKMeansParams: public cvflann::IndexParams {
-	IncrementalKMeansParams(int numClusters = 1000000) {
+	IncrementalKMeansParams(int numClusters = 1000000, int numThreads = 0) {
 		(*this)["num.clusters"] = numClusters;
+		// Number of threads searching the nearest centers, 0 means one per core
+		(*this)["num.threads"] = numThreads;
 	}
 };
 
@@ -33,6 +36,8 @@ protected:
 	int m_numDatapoints;
 	// Number of clusters (k)
 	int m_numClusters;
+	// Number of threads searching the nearest centers
+	int m_numThreads;
 
 	// Reference to the matrix with data to cluster (D)
 	vlr::Mat m_dataset;
@@ -42,12 +47,19 @@ protected:
 	cv::Mat m_clustersVariances;
 	// Weights for each cluster (W)
 	cv::Mat m_clustersWeights;
+	// Mapping of a binary vocabulary C, R and W point into, if loaded from one
+	cv::Ptr<BinaryVocabFile> m_vocabFile;
 	// Sum of points per cluster (M)
 	cv::Mat m_clustersSums;
 	// Number of data points assigned to each cluster (N)
 	cv::Mat m_clustersCounts;
+	// Whether the sums of each cluster changed since its center was last computed
+	std::vector<char> m_isDirty;
 	// Distance from each cluster center to the null transaction (Delta)
 	cv::Mat m_clusterDistancesToNullTransaction;
+	// Partial distances to the centers, (d*2*16 x k) one 16-entry table per nibble of the
+	// transaction and center, see preComputeDistances
+	cv::Mat m_distanceTables;
 
 	cv::Mat m_miu;
 	cv::Mat m_sigma;
@@ -142,10 +154,22 @@ public:
 	void initCentroids();
 
 	/**
-	 * Pre-compute distances between the null transaction and all the centers.
+	 * Pre-compute distances between the null transaction and all the centers, and the
+	 * partial distance tables used by findNearestNeighbor.
 	 */
 	void preComputeDistances();
 
+	/**
+	 * Pre-compute the distances for the jth center only.
+	 */
+	void preComputeDistances(const int& j);
+
+	/**
+	 * Sets the number of clusters and dimensionality from loaded centers and pre-computes
+	 * the distances needed to quantize.
+	 */
+	void initFromCentroids();
+
 	/**
 	 *
 	 */
@@ -153,7 +177,8 @@ public:
 
 	/**
 	 * Determine cluster membership for the given transaction by means of
-	 * sparse distance computation.
+	 * sparse distance computation: only the non-null nibbles of the transaction are
+	 * looked up in the partial distance tables.
 	 *
 	 * @param transaction - A transaction
 	 * @param clusterIndex - Index to the closest cluster center
@@ -161,6 +186,18 @@ public:
 	 */
 	void findNearestNeighbor(cv::Mat transaction, int& clusterIndex, double& distanceToCluster) const;
 
+	/**
+	 * Determine cluster membership for a range of transactions, split among threads.
+	 *
+	 * @param datasets - One copy of the data set per thread
+	 * @param begin - Index of the first transaction
+	 * @param end - Index past the last transaction
+	 * @param clusterIndices - Index to the closest cluster center of every transaction
+	 * @param distancesToClusters - Distance to the closest cluster center of every transaction
+	 */
+	void findNearestNeighbors(std::vector<vlr::Mat>& datasets, int begin, int end,
+			std::vector<int>& clusterIndices, std::vector<double>& distancesToClusters) const;
+
 	/**
 	 * Inserts an outlier into a list in descending order according by distance to their
 	 * nearest centroid, and returns true if the transaction is an outlier.
@@ -190,6 +227,8 @@ public:
 
 	/**
 	 * Compute clusters centers using sufficient statistics as proposed by Ordonez2003.
+	 * Only the clusters whose sums changed since the last computation are recomputed, in
+	 * O(d) each, along with their pre-computed distances; the weights are all updated.
 	 *
 	 * @param i - Number of processed transactions
 	 */
@@ -6,8 +6,12 @@
  */
 
 #include <IncrementalKMeans.hpp>
+#include <FunctionUtils.hpp>
 #include <opencv2/core/core.hpp>
 
+#include <algorithm>
+#include <thread>
+
 namespace vlr {
 
 static const int MAX_OUTLIERS = 10;
@@ -17,6 +21,10 @@ IncrementalKMeans::IncrementalKMeans(vlr::Mat data, const cvflann::IndexParams&
 
 	// Attributes initialization
 	m_numClusters = cvflann::get_param<int>(params, "num.clusters");
+	m_numThreads = cvflann::get_param<int>(params, "num.threads", 0);
+	if (m_numThreads <= 0) {
+		m_numThreads = std::max(1, int(std::thread::hardware_concurrency()));
+	}
 
 	// Compute the global data set mean
 	m_miu = cv::Mat::zeros(1, m_dim * 8, cv::DataType<double>::type);
@@ -76,56 +84,105 @@ void IncrementalKMeans::build() {
 	initClustersCounters();
 
 	double L = sqrt(m_numDatapoints);
-	int clusterIndex;
-	double distanceToCluster;
+	int step = (int) (m_numDatapoints / L);
+
+	// One copy of the dataset per thread, see vlr::Mat(const Mat&)
+	std::vector<vlr::Mat> datasets(m_numThreads, m_dataset);
+	std::vector<int> clusterIndices;
+	std::vector<double> distancesToClusters;
+
+	// Centers only change at the checkpoints, every L times, so the nearest centers of
+	// the transactions up to the next checkpoint are searched at once in parallel, then
+	// the transactions are assigned in order as by the sequential algorithm
+	for (int start = 0; start < m_numDatapoints;) {
+		int end = std::min(m_numDatapoints, (start + step - 1) / step * step + 1);
 
-	for (int i = 0; i < m_numDatapoints; ++i) {
-		cv::Mat transaction = m_dataset.row(i);
 		// Cluster assignment
 		// j = NN(ti)
-		findNearestNeighbor(transaction, clusterIndex, distanceToCluster);
-		// Insert transaction in the list of outliers
-		bool isOutlier = insertOutlier(i, clusterIndex, distanceToCluster);
-		// If the transaction is not an outlier then assign it to the jth cluster
-		if (isOutlier) {
-			// If the transaction is an outlier and is the farthest one on the jth cluster
-			// then pop and assign the nearest outlier on the jth cluster
-			if (m_outliers.at(clusterIndex).size() > MAX_OUTLIERS) {
-				transaction = m_dataset.row(m_outliers.at(clusterIndex).back().first);
-				m_outliers.at(clusterIndex).pop_back();
+		findNearestNeighbors(datasets, start, end, clusterIndices, distancesToClusters);
+
+		for (int i = start; i < end; ++i) {
+			int clusterIndex = clusterIndices[i - start];
+			double distanceToCluster = distancesToClusters[i - start];
+			cv::Mat transaction;
+			// Insert transaction in the list of outliers
+			bool isOutlier = insertOutlier(i, clusterIndex, distanceToCluster);
+			// If the transaction is not an outlier then assign it to the jth cluster
+			if (isOutlier) {
+				// If the transaction is an outlier and is the farthest one on the jth cluster
+				// then pop and assign the nearest outlier on the jth cluster
+				if (m_outliers.at(clusterIndex).size() > MAX_OUTLIERS) {
+					transaction = m_dataset.row(m_outliers.at(clusterIndex).back().first);
+					m_outliers.at(clusterIndex).pop_back();
+					// Mj <- Mj + ti
+					sparseSum(transaction, clusterIndex);
+					// Nj <- Nj + 1
+					m_clustersCounts.col(clusterIndex) += 1;
+				}
+			} else {
+				transaction = m_dataset.row(i);
 				// Mj <- Mj + ti
 				sparseSum(transaction, clusterIndex);
 				// Nj <- Nj + 1
 				m_clustersCounts.col(clusterIndex) += 1;
 			}
-		} else {
-			// Mj <- Mj + ti
-			sparseSum(transaction, clusterIndex);
-			// Nj <- Nj + 1
-			m_clustersCounts.col(clusterIndex) += 1;
-		}
 
-		// Update clusters centers every L times
-		if (i % ((int) (m_numDatapoints / L)) == 0) {
-			// Re-compute clusters centers
-			computeCentroids(i);
-			// Compute distances between clusters centers and the null transaction
-			preComputeDistances();
-			// Re-seeding
-			handleEmptyClusters();
+			// Update clusters centers every L times
+			if (i % step == 0) {
+				// Re-compute clusters centers, and their distances to the null transaction,
+				// only for the clusters which changed
+				computeCentroids(i);
+				// Re-seeding
+				handleEmptyClusters();
+			}
 		}
+
+		start = end;
 	}
 
 }
 
 // --------------------------------------------------------------------------
 
+void IncrementalKMeans::findNearestNeighbors(std::vector<vlr::Mat>& datasets, int begin,
+		int end, std::vector<int>& clusterIndices, std::vector<double>& distancesToClusters) const {
+
+	clusterIndices.resize(end - begin);
+	distancesToClusters.resize(end - begin);
+
+	int numThreads = std::min(int(datasets.size()), end - begin);
+
+	FunctionUtils::runPartitioned(FunctionUtils::splitEvenly(end - begin, numThreads),
+			[&](int t, int first, int last) {
+				for (int i = first; i < last; ++i) {
+					cv::Mat transaction = datasets[t].row(begin + i);
+					findNearestNeighbor(transaction, clusterIndices[i], distancesToClusters[i]);
+				}
+			});
+
+}
+
+// --------------------------------------------------------------------------
+
 void IncrementalKMeans::save(const std::string& filename) const {
 
 	if (m_centroids.empty()) {
 		throw std::runtime_error("[IncrementalKMeans::save] Vocabulary is empty");
 	}
 
+	if (BinaryVocabFile::hasBinaryExtension(filename)) {
+		std::vector<std::string> names;
+		names.push_back("C");
+		names.push_back("R");
+		names.push_back("W");
+		std::vector<cv::Mat> matrices;
+		matrices.push_back(m_centroids);
+		matrices.push_back(m_clustersVariances);
+		matrices.push_back(m_clustersWeights);
+		BinaryVocabFile::save(filename, "IKM", names, matrices);
+		return;
+	}
+
 	cv::FileStorage fs(filename.c_str(), cv::FileStorage::WRITE);
 
 	if (fs.isOpened() == false) {
@@ -146,6 +203,22 @@ void IncrementalKMeans::save(const std::string& filename) const {
 
 void IncrementalKMeans::load(const std::string& filename) {
 
+	// Binary vocabularies are mapped, the matrices point into the mapping
+	if (BinaryVocabFile::isBinaryVocab(filename)) {
+		m_vocabFile = new BinaryVocabFile(filename);
+		m_centroids = m_vocabFile->getMatrix("C");
+		m_clustersVariances = m_vocabFile->getMatrix("R");
+		m_clustersWeights = m_vocabFile->getMatrix("W");
+		initFromCentroids();
+		return;
+	}
+
+	// Detach the matrices from a previous mapping before unmapping it
+	m_centroids.release();
+	m_clustersVariances.release();
+	m_clustersWeights.release();
+	m_vocabFile.release();
+
 	enum nodeFields { header, vocab_type, centroids, squared_distances, weights, rows, cols, data_type, data };
 
 	std::string nodeFieldsNames[] = { "YAML", "type", "C:", "R:", "W:", "rows:", "cols:", "dt:", "data:" };
@@ -250,6 +323,17 @@ void IncrementalKMeans::load(const std::string& filename) {
 	// Close file
 	inputZippedFileStream.close();
 
+	initFromCentroids();
+
+}
+
+// --------------------------------------------------------------------------
+
+void IncrementalKMeans::initFromCentroids() {
+	m_numClusters = m_centroids.rows;
+	m_dim = m_centroids.cols / 8;
+	// Compute distances between clusters centers and the null transaction
+	preComputeDistances();
 }
 
 // --------------------------------------------------------------------------
@@ -269,9 +353,33 @@ void IncrementalKMeans::initCentroids() {
 // --------------------------------------------------------------------------
 
 void IncrementalKMeans::preComputeDistances() {
-	cv::Mat nullTransaction = cv::Mat::zeros(1, m_dim * 8, cv::DataType<double>::type);
+	m_clusterDistancesToNullTransaction.create(1, m_numClusters, cv::DataType<double>::type);
+	m_distanceTables.create(m_dim * 2 * 16, m_numClusters, cv::DataType<double>::type);
 	for (int j = 0; j < m_numClusters; ++j) {
-		cv::mulTransposed(nullTransaction - m_centroids.row(j), m_clusterDistancesToNullTransaction.col(j), false);
+		preComputeDistances(j);
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void IncrementalKMeans::preComputeDistances(const int& j) {
+	cv::Mat nullTransaction = cv::Mat::zeros(1, m_dim * 8, cv::DataType<double>::type);
+	cv::mulTransposed(nullTransaction - m_centroids.row(j), m_clusterDistancesToNullTransaction.col(j), false);
+
+	// For a transaction t, ||t - Cj||^2 = ||Cj||^2 + sum over the set bits l of (1 - 2 Cj(l)),
+	// the sum is tabulated per nibble: entry v of nibble n is the sum over the set bits of v,
+	// bit b of v (0 being the least significant) being dimension 4n + 3 - b
+	double table[16];
+	const double* centroid = m_centroids.ptr<double>(j);
+	for (int n = 0; n < m_dim * 2; ++n) {
+		table[0] = 0;
+		for (int v = 1; v < 16; ++v) {
+			// Extend the table entry of v without its lowest set bit
+			table[v] = table[v & (v - 1)] + 1 - 2 * centroid[4 * n + 3 - __builtin_ctz(v)];
+		}
+		for (int v = 0; v < 16; ++v) {
+			m_distanceTables.at<double>(n * 16 + v, j) = table[v];
+		}
 	}
 }
 
@@ -281,32 +389,40 @@ void IncrementalKMeans::initClustersCounters() {
 	m_clustersCounts = cv::Mat::zeros(1, m_numClusters, cv::DataType<int>::type);
 	m_clustersSums = cv::Mat::zeros(m_numClusters, m_dim * 8, cv::DataType<int>::type);
 	m_clustersWeights = cv::Mat::ones(1, m_numClusters, cv::DataType<double>::type) / m_numClusters;
+	// Every center is computed the first time
+	m_isDirty.assign(m_numClusters, 1);
 }
 
 // --------------------------------------------------------------------------
 
 void IncrementalKMeans::findNearestNeighbor(cv::Mat transaction, int& clusterIndex, double& distanceToCluster) const {
 
+	CV_Assert(transaction.type() == CV_8U && transaction.cols == m_dim);
+
 	clusterIndex = 0;
 	distanceToCluster = std::numeric_limits<double>::max();
 
-	double tempDistanceToCluster;
-	uchar byte = 0;
-	for (int j = 0; j < m_centroids.rows; ++j) {
-		tempDistanceToCluster = m_clusterDistancesToNullTransaction.at<double>(0, j);
-		for (int l = 0; l < m_centroids.cols; l++) {
-			if ((l % 8) == 0) {
-				byte = *(transaction.col((int) l / 8).data);
-			}
-			int bit = ((int) ((byte >> (7 - (l % 8))) % 2));
-			// Compute only differences for non-null dimensions
-			if (bit == 1) {
-				tempDistanceToCluster += pow(bit - m_centroids.at<double>(j, l), 2) - pow(m_centroids.at<double>(j, l), 2);
-			}
+	// Distances to all the centers at once, the tables rows are contiguous over the
+	// centers so every non-null nibble adds one row to the distances
+	const double* nullDistances = m_clusterDistancesToNullTransaction.ptr<double>(0);
+	std::vector<double> distances(nullDistances, nullDistances + m_numClusters);
+	const uchar* bytes = transaction.ptr<uchar>(0);
+	for (int n = 0; n < m_dim * 2; ++n) {
+		int v = n % 2 == 0 ? bytes[n / 2] >> 4 : bytes[n / 2] & 0x0F;
+		// Compute only differences for non-null dimensions
+		if (v == 0) {
+			continue;
 		}
-		if (tempDistanceToCluster < distanceToCluster) {
+		const double* table = m_distanceTables.ptr<double>(n * 16 + v);
+		for (int j = 0; j < m_numClusters; ++j) {
+			distances[j] += table[j];
+		}
+	}
+
+	for (int j = 0; j < m_numClusters; ++j) {
+		if (distances[j] < distanceToCluster) {
 			clusterIndex = j;
-			distanceToCluster = tempDistanceToCluster;
+			distanceToCluster = distances[j];
 		}
 	}
 
@@ -337,40 +453,52 @@ bool IncrementalKMeans::insertOutlier(const int& transactionIndex, const int& cl
 // --------------------------------------------------------------------------
 
 void IncrementalKMeans::sparseSum(cv::Mat transaction, const int& rowIndex) {
-	uchar byte = 0;
+	const uchar* bytes = transaction.ptr<uchar>(0);
+	int* sums = m_clustersSums.ptr<int>(rowIndex);
 	for (int l = 0; l < m_clustersSums.cols; l++) {
-		if ((l % 8) == 0) {
-			byte = *(transaction.col((int) l / 8).data);
-		}
-		m_clustersSums.at<int>(rowIndex, l) += ((int) ((byte >> (7 - (l % 8))) % 2));
+		sums[l] += (bytes[l / 8] >> (7 - (l % 8))) & 1;
 	}
+	m_isDirty[rowIndex] = 1;
 }
 
 // --------------------------------------------------------------------------
 
 void IncrementalKMeans::sparseSubtraction(cv::Mat transaction, const int& rowIndex) {
-	uchar byte = 0;
+	const uchar* bytes = transaction.ptr<uchar>(0);
+	int* sums = m_clustersSums.ptr<int>(rowIndex);
 	for (int l = 0; l < m_clustersSums.cols; l++) {
-		if ((l % 8) == 0) {
-			byte = *(transaction.col((int) l / 8).data);
-		}
-		m_clustersSums.at<int>(rowIndex, l) -= ((int) ((byte >> (7 - (l % 8))) % 2));
+		sums[l] -= (bytes[l / 8] >> (7 - (l % 8))) & 1;
 	}
+	m_isDirty[rowIndex] = 1;
 }
 
 // --------------------------------------------------------------------------
 
 void IncrementalKMeans::computeCentroids(const int& i) {
+	// The pre-computed distances are refreshed along with the centers, once allocated
+	bool refreshDistances = m_distanceTables.cols == m_numClusters;
 	for (int j = 0; j < m_numClusters; ++j) {
-		// Cj <- Mj/Nj
-		m_clustersSums.row(j).convertTo(m_centroids.row(j), cv::DataType<double>::type);
-		m_centroids.row(j) = m_centroids.row(j) / ((double) m_clustersCounts.at<int>(0, j));
-		// Rj <- Cj - diag(Cj*Cj')
-		cv::Mat clusterVariance(m_dim * 8, m_dim * 8, cv::DataType<double>::type);
-		cv::mulTransposed(m_centroids.row(j), clusterVariance, true);
-		m_clustersVariances.row(j) = m_centroids.row(j) - clusterVariance.diag(0).t();
 		// Wj <- Nj/i
-		m_clustersWeights.col(j) = ((double) m_clustersCounts.at<int>(0, j)) / ((double) i);
+		m_clustersWeights.at<double>(0, j) = ((double) m_clustersCounts.at<int>(0, j)) / ((double) i);
+		// Sums and counts are unchanged since the last computation, so is the center
+		if (m_isDirty[j] == 0) {
+			continue;
+		}
+		// Cj <- Mj/Nj
+		// Rj <- Cj - diag(Cj*Cj'), transactions are binary so the sum of squares is Mj
+		// and the variance of dimension l is Cj(l) - Cj(l)^2
+		const int* sums = m_clustersSums.ptr<int>(j);
+		double* centroid = m_centroids.ptr<double>(j);
+		double* variance = m_clustersVariances.ptr<double>(j);
+		double scale = 1.0 / ((double) m_clustersCounts.at<int>(0, j));
+		for (int l = 0; l < m_centroids.cols; ++l) {
+			centroid[l] = sums[l] * scale;
+			variance[l] = centroid[l] - centroid[l] * centroid[l];
+		}
+		if (refreshDistances) {
+			preComputeDistances(j);
+		}
+		m_isDirty[j] = 0;
 	}
 }
 
@@ -5,6 +5,9 @@
  *      Author: andresf
  */
 
+#include <algorithm>
+#include <limits>
+
 #include <gtest/gtest.h>
 
 #include <FileUtils.hpp>
@@ -384,6 +387,30 @@ TEST(IncrementalKMeans, HandleEmptyClusters) {
 
 }
 
+TEST(IncrementalKMeans, ThreadsAgree) {
+
+	std::vector<std::string> descriptorsFilenames;
+	descriptorsFilenames.push_back("brief.bin");
+	vlr::Mat data(descriptorsFilenames);
+	vlr::IncrementalKMeansParams params;
+	params["num.clusters"] = 10;
+
+	params["num.threads"] = 1;
+	vlr::IncrementalKMeans sequential(data, params);
+	srand(1234);
+	sequential.build();
+
+	params["num.threads"] = 4;
+	vlr::IncrementalKMeans parallel(data, params);
+	srand(1234);
+	parallel.build();
+
+	// Compared byte-wise, centers of clusters left empty are not numbers
+	EXPECT_TRUE(std::equal(sequential.getCentroids().begin<uchar>(), sequential.getCentroids().end<uchar>(), parallel.getCentroids().begin<uchar>()));
+	EXPECT_TRUE(std::equal(sequential.getClustersCounts().begin<int>(), sequential.getClustersCounts().end<int>(), parallel.getClustersCounts().begin<int>()));
+
+}
+
 TEST(IncrementalKMeans, SaveLoad) {
 
 	std::vector<std::string> descriptorsFilenames;
@@ -403,4 +430,77 @@ TEST(IncrementalKMeans, SaveLoad) {
 
 }
 
+TEST(IncrementalKMeans, QuantizeAfterLoad) {
+
+	std::vector<std::string> descriptorsFilenames;
+	descriptorsFilenames.push_back("brief.bin");
+	vlr::Mat data(descriptorsFilenames);
+	vlr::IncrementalKMeansParams params;
+	params["num.clusters"] = 10;
+	vlr::IncrementalKMeans vocabTrainer(data, params);
+
+	vocabTrainer.build();
+	vocabTrainer.save("test_vocab.bin");
+
+	vlr::IncrementalKMeans vocabTrainerLoaded;
+	vocabTrainerLoaded.load("test_vocab.bin");
+
+	EXPECT_EQ(vocabTrainer.getNumClusters(), vocabTrainerLoaded.getNumClusters());
+	EXPECT_EQ(vocabTrainer.getDim(), vocabTrainerLoaded.getDim());
+
+	int clusterIndex, loadedClusterIndex;
+	double distanceToCluster, loadedDistanceToCluster;
+	for (int i = 0; i < vocabTrainer.getNumDatapoints(); ++i) {
+		cv::Mat transaction = data.row(i);
+		vocabTrainer.findNearestNeighbor(transaction, clusterIndex, distanceToCluster);
+		vocabTrainerLoaded.findNearestNeighbor(transaction, loadedClusterIndex, loadedDistanceToCluster);
+		EXPECT_EQ(clusterIndex, loadedClusterIndex);
+		EXPECT_DOUBLE_EQ(distanceToCluster, loadedDistanceToCluster);
+	}
+
+}
+
+TEST(IncrementalKMeans, NearestNeighborMatchesDefinition) {
+
+	std::vector<std::string> descriptorsFilenames;
+	descriptorsFilenames.push_back("brief.bin");
+	vlr::Mat data(descriptorsFilenames);
+	vlr::IncrementalKMeansParams params;
+	params["num.clusters"] = 10;
+	vlr::IncrementalKMeans vocabTrainer(data, params);
+
+	vocabTrainer.build();
+
+	const cv::Mat& centroids = vocabTrainer.getCentroids();
+
+	int clusterIndex;
+	double distanceToCluster;
+	for (int i = 0; i < std::min(20, vocabTrainer.getNumDatapoints()); ++i) {
+		cv::Mat transaction = data.row(i);
+		const uchar* bytes = transaction.ptr<uchar>(0);
+
+		// ||t - Cj||^2 straight from the bits of the transaction, the most
+		// significant bit of each byte being its first dimension
+		int expectedIndex = 0;
+		double expectedDistance = std::numeric_limits<double>::max();
+		for (int j = 0; j < centroids.rows; ++j) {
+			const double* centroid = centroids.ptr<double>(j);
+			double distance = 0;
+			for (int l = 0; l < centroids.cols; ++l) {
+				double diff = ((bytes[l / 8] >> (7 - (l % 8))) & 1) - centroid[l];
+				distance += diff * diff;
+			}
+			if (distance < expectedDistance) {
+				expectedIndex = j;
+				expectedDistance = distance;
+			}
+		}
+
+		vocabTrainer.findNearestNeighbor(transaction, clusterIndex, distanceToCluster);
+		EXPECT_EQ(expectedIndex, clusterIndex);
+		EXPECT_NEAR(expectedDistance, distanceToCluster, 1e-6);
+	}
+
+}
+
 } /* namespace vlr */
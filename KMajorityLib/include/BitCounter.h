@@ -0,0 +1,208 @@
+/*
+ * BitCounter.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: andresf
+ */
+
+#ifndef BITCOUNTER_H_
+#define BITCOUNTER_H_
+
+#include <algorithm>
+#include <cstring>
+#include <stdint.h>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace vlr {
+
+/**
+ * Per-bit population counts of a set of binary descriptors, i.e. the accumulator the
+ * k-majority centroids are voted from.
+ *
+ * Descriptors are added to bit-sliced vertical counters: plane p holds bit p of the
+ * count of every descriptor bit, so adding a descriptor is a ripple of half adders over
+ * 64-bit words instead of one increment per bit. The planes are flushed into plain
+ * integer counts before they can overflow and when votes or counts are requested.
+ *
+ * @note Descriptor bytes are read as little-endian words, as on x86.
+ */
+class BitCounter {
+
+public:
+
+	/**
+	 * @param dim - Length of the descriptors in bytes
+	 */
+	BitCounter(int dim = 0) {
+		reset(dim);
+	}
+
+	/**
+	 * Zeroes the counts, possibly for a new descriptor length.
+	 *
+	 * @param dim - Length of the descriptors in bytes
+	 */
+	void reset(int dim) {
+		m_dim = dim;
+		m_words = (dim + 7) / 8;
+		m_planes.assign(NUM_PLANES * m_words, 0);
+		m_counts.assign(m_words * 64, 0);
+		m_pending = 0;
+		m_total = 0;
+	}
+
+	/**
+	 * Zeroes the counts.
+	 */
+	void reset() {
+		std::fill(m_planes.begin(), m_planes.end(), 0);
+		std::fill(m_counts.begin(), m_counts.end(), 0);
+		m_pending = 0;
+		m_total = 0;
+	}
+
+	/**
+	 * Adds a descriptor to the counts.
+	 *
+	 * @param descriptor - Pointer to the dim bytes of the descriptor
+	 */
+	void add(const unsigned char* descriptor) {
+		if (m_pending == MAX_PENDING) {
+			flush();
+		}
+		for (int w = 0; w < m_words; ++w) {
+			uint64_t x = loadWord(descriptor, w);
+			// Ripple the carry up the planes, stops as soon as no bit carries
+			for (uint64_t* plane = &m_planes[w]; x != 0; plane += m_words) {
+				uint64_t carry = *plane & x;
+				*plane ^= x;
+				x = carry;
+			}
+		}
+		++m_pending;
+		++m_total;
+	}
+
+	/**
+	 * Number of descriptors added since the last reset.
+	 */
+	int total() const {
+		return m_total;
+	}
+
+	/**
+	 * Count of bit t (0 being the least significant) of byte b.
+	 */
+	int count(int b, int t) {
+		flush();
+		return m_counts[8 * b + t];
+	}
+
+	/**
+	 * Adds the counts to an accumulator laid out as by KMajority::cumBitSum, i.e. entry
+	 * 8 * b + l holds the count of bit 7 - l of byte b.
+	 *
+	 * @param acc - Pointer to the dim * 8 integers of the accumulator
+	 */
+	void accumulate(int* acc) {
+		flush();
+		for (int b = 0; b < m_dim; ++b) {
+			for (int t = 0; t < 8; ++t) {
+				acc[8 * b + 7 - t] += m_counts[8 * b + t];
+			}
+		}
+	}
+
+	/**
+	 * Majority vote of the counts, laid out as by KMajority::majorityVoting: the vote
+	 * for bit t of byte b goes to bit t of byte dim - 1 - b. A bit is set when it was
+	 * set in more than half of threshold descriptors, ties are resolved to zero.
+	 *
+	 * @param result - Pointer to the dim bytes of the result
+	 * @param threshold - Typically the number of descriptors added
+	 */
+	void majorityVoting(unsigned char* result, int threshold) {
+		flush();
+		for (int b = 0; b < m_dim; ++b) {
+			result[m_dim - 1 - b] = voteByte(&m_counts[8 * b], threshold);
+		}
+	}
+
+	/**
+	 * Votes 8 counts at once, bit i of the result is set if 2 * counts[i] > threshold.
+	 */
+	static unsigned char voteByte(const int* counts, int threshold) {
+#ifdef __SSE2__
+		__m128i thr = _mm_set1_epi32(threshold);
+		__m128i lo = _mm_loadu_si128((const __m128i*) counts);
+		__m128i hi = _mm_loadu_si128((const __m128i*) (counts + 4));
+		lo = _mm_cmpgt_epi32(_mm_slli_epi32(lo, 1), thr);
+		hi = _mm_cmpgt_epi32(_mm_slli_epi32(hi, 1), thr);
+		__m128i bytes = _mm_packs_epi16(_mm_packs_epi32(lo, hi),
+				_mm_setzero_si128());
+		return (unsigned char) (_mm_movemask_epi8(bytes) & 0xFF);
+#else
+		unsigned char byte = 0;
+		for (int i = 0; i < 8; ++i) {
+			byte |= (unsigned char) ((2 * counts[i] > threshold) << i);
+		}
+		return byte;
+#endif
+	}
+
+private:
+
+	// Number of bit planes, the planes hold counts up to 2^NUM_PLANES - 1
+	static const int NUM_PLANES = 8;
+	static const int MAX_PENDING = (1 << NUM_PLANES) - 1;
+
+	uint64_t loadWord(const unsigned char* descriptor, int w) const {
+		uint64_t word = 0;
+		int bytes = m_dim - 8 * w < 8 ? m_dim - 8 * w : 8;
+		memcpy(&word, descriptor + 8 * w, bytes);
+		return word;
+	}
+
+	/**
+	 * Moves the counts held by the planes into the integer counts.
+	 */
+	void flush() {
+		if (m_pending == 0) {
+			return;
+		}
+		for (int p = 0; p < NUM_PLANES; ++p) {
+			for (int w = 0; w < m_words; ++w) {
+				uint64_t bits = m_planes[p * m_words + w];
+				int* counts = &m_counts[64 * w];
+				while (bits != 0) {
+					counts[__builtin_ctzll(bits)] += 1 << p;
+					bits &= bits - 1;
+				}
+				m_planes[p * m_words + w] = 0;
+			}
+		}
+		m_pending = 0;
+	}
+
+	// Length of the descriptors in bytes
+	int m_dim;
+	// Length of the descriptors in 64-bit words
+	int m_words;
+	// Bit planes of the vertical counters, NUM_PLANES x m_words
+	std::vector<uint64_t> m_planes;
+	// Flushed counts, entry 8 * b + t is the count of bit t of byte b
+	std::vector<int> m_counts;
+	// Number of descriptors held by the planes
+	int m_pending;
+	// Number of descriptors added since the last reset
+	int m_total;
+
+};
+
+} /* namespace vlr */
+
+#endif /* BITCOUNTER_H_ */
@@ -8,13 +8,24 @@
 #ifndef CENTERSCHOOSER_H_
 #define CENTERSCHOOSER_H_
 
+#include <algorithm>
 #include <ctime>
+#include <limits>
+#include <thread>
 
 #include <opencv2/flann/flann.hpp>
 
 #include <DynamicMat.hpp>
 #include <FunctionUtils.hpp>
 
+namespace vlr {
+
+// Scalable k-means++ seeding, not part of the cvflann centers initialization methods
+const cvflann::flann_centers_init_t CENTERS_KMEANSPARALLEL =
+		cvflann::flann_centers_init_t(100);
+
+} /* namespace vlr */
+
 template<typename TDescriptor, typename Distance>
 class CentersChooser {
 public:
@@ -23,8 +34,13 @@ public:
 	virtual void chooseCenters(int k, int* indices, int indices_length,
 			std::vector<int>& centers, int& centers_length, vlr::Mat& dataset,
 			Distance distance = Distance()) = 0;
+	/**
+	 * @param type - Centers initialization method
+	 * @param numThreads - Number of threads computing distances where the method uses
+	 * them, 0 means one per core
+	 */
 	static cv::Ptr<CentersChooser<TDescriptor, Distance> > create(
-			const cvflann::flann_centers_init_t& type);
+			const cvflann::flann_centers_init_t& type, int numThreads = 0);
 
 };
 
@@ -109,6 +125,58 @@ public:
 
 };
 
+template<typename TDescriptor, typename Distance>
+class KmeansParallelCenters: public CentersChooser<TDescriptor, Distance> {
+
+	typedef typename Distance::ResultType DistanceType;
+
+public:
+
+	/**
+	 * @param numThreads - Number of threads computing distances, 0 means one per core
+	 * @param numRounds - Number of oversampling rounds
+	 * @param oversampling - Expected number of candidates per round, as a factor of k
+	 */
+	KmeansParallelCenters(int numThreads = 0, int numRounds = 5,
+			double oversampling = 2.0) :
+			m_numThreads(numThreads), m_numRounds(numRounds), m_oversampling(
+					oversampling) {
+	}
+
+	virtual ~KmeansParallelCenters() {
+	}
+
+	/**
+	 * Chooses the initial centers in the k-means using the k-means|| seeding
+	 * algorithm proposed by Bahmani et al.
+	 *
+	 * Starting from one random candidate, every round samples each point
+	 * independently with probability oversampling * k * D(x) / sum D, where D(x) is
+	 * the distance to the nearest candidate. After a few rounds the candidates are
+	 * weighted by the number of points nearest to them and reduced to k centers by
+	 * weighted k-means++. The data is read once per round instead of once per center,
+	 * and the distance computations are split among threads.
+	 *
+	 * @param k - Number of centers
+	 * @param indices - Vector of indices in the dataset
+	 * @param indices_length - Length of indices vector
+	 * @param centers - Vector of cluster centers
+	 * @param centers_length - Length of centers vectors
+	 * @param dataset
+	 * @param distance
+	 */
+	virtual void chooseCenters(int k, int* indices, int indices_length,
+			std::vector<int>& centers, int& centers_length, vlr::Mat& dataset,
+			Distance distance = Distance());
+
+private:
+
+	int m_numThreads;
+	int m_numRounds;
+	double m_oversampling;
+
+};
+
 // --------------------------------------------------------------------------
 
 template<typename TDescriptor, typename Distance>
@@ -278,9 +346,180 @@ void KmeansppCenters<TDescriptor, Distance>::chooseCenters(int k, int* indices,
 
 // --------------------------------------------------------------------------
 
+template<typename TDescriptor, typename Distance>
+void KmeansParallelCenters<TDescriptor, Distance>::chooseCenters(int k,
+		int* indices, int indices_length, std::vector<int>& centers,
+		int& centers_length, vlr::Mat& dataset, Distance distance) {
+
+	int n = indices_length;
+
+	// Assert there is enough data
+	CV_Assert(k <= n);
+
+	int numThreads =
+			m_numThreads > 0 ?
+					m_numThreads :
+					std::max(1, int(std::thread::hardware_concurrency()));
+	numThreads = std::min(numThreads, n);
+
+	// One copy of the dataset per thread, see vlr::Mat(const Mat&)
+	std::vector<vlr::Mat> datasets(numThreads, dataset);
+	std::vector<int> pointBounds = FunctionUtils::splitEvenly(n, numThreads);
+
+	// Positions in indices of the candidates and a copy of their descriptors
+	std::vector<int> candidates;
+	cv::Mat candidatesData;
+	std::vector<char> isCandidate(n, 0);
+
+	// Distance from every point to its nearest candidate, and that candidate
+	std::vector<DistanceType> closestDist(n,
+			std::numeric_limits<DistanceType>::max());
+	std::vector<int> closest(n, -1);
+
+	// Adds the picked points to the candidates and updates the nearest candidates
+	// with a pass over the data
+	auto addCandidates = [&](const std::vector<int>& picked) {
+		int first = candidates.size();
+		for (int i : picked) {
+			isCandidate[i] = 1;
+			candidates.push_back(i);
+			candidatesData.push_back(dataset.row(indices[i]));
+		}
+		int last = candidates.size();
+		FunctionUtils::runPartitioned(pointBounds,
+				[&](int t, int begin, int end) {
+					for (int i = begin; i < end; ++i) {
+						cv::Mat point = datasets[t].row(indices[i]);
+						for (int c = first; c < last; ++c) {
+							DistanceType dist = distance((TDescriptor*) point.data,
+									(TDescriptor*) candidatesData.row(c).data,
+									dataset.cols);
+							if (dist < closestDist[i]) {
+								closestDist[i] = dist;
+								closest[i] = c;
+							}
+						}
+					}
+				});
+	};
+
+	// Choose one random candidate
+	addCandidates(std::vector<int>(1, cvflann::rand_int(n)));
+
+	// Oversampling rounds, the sampling itself is sequential so that the result
+	// does not depend on the number of threads
+	double expectedPerRound = m_oversampling * k;
+	for (int round = 0; round < m_numRounds; ++round) {
+		double currentPot = 0;
+		for (int i = 0; i < n; ++i) {
+			currentPot += closestDist[i];
+		}
+		if (currentPot <= 0) {
+			break;
+		}
+		std::vector<int> picked;
+		for (int i = 0; i < n; ++i) {
+			if (isCandidate[i] == 0
+					&& cvflann::rand_double(1.0)
+							< expectedPerRound * closestDist[i] / currentPot) {
+				picked.push_back(i);
+			}
+		}
+		addCandidates(picked);
+	}
+
+	// Too few candidates, e.g. many duplicated points, complete them at random
+	if (int(candidates.size()) < k) {
+		cvflann::UniqueRandom r(n);
+		std::vector<int> picked;
+		while (int(candidates.size() + picked.size()) < k) {
+			int rnd = r.next();
+			CV_Assert(rnd >= 0);
+			if (isCandidate[rnd] == 0) {
+				picked.push_back(rnd);
+			}
+		}
+		addCandidates(picked);
+	}
+
+	int m = candidates.size();
+
+	// Weight of every candidate, the number of points nearest to it
+	std::vector<double> weights(m, 0);
+	for (int i = 0; i < n; ++i) {
+		weights[closest[i]] += 1;
+	}
+
+	// Weighted k-means++ on the candidates
+	std::vector<int> chosen;
+	std::vector<double> closestCandDist(m, 1);
+	std::vector<int> candBounds = FunctionUtils::splitEvenly(m,
+			std::min(numThreads, m));
+
+	for (int centerCount = 0; centerCount < k; ++centerCount) {
+
+		// Choose our center - have to be slightly careful to return a valid answer even
+		// accounting for possible rounding errors
+		double currentPot = 0;
+		for (int c = 0; c < m; ++c) {
+			currentPot += weights[c] * closestCandDist[c];
+		}
+		int index = -1;
+		if (currentPot > 0) {
+			double randVal = cvflann::rand_double(currentPot);
+			for (int c = 0; c < m; ++c) {
+				double mass = weights[c] * closestCandDist[c];
+				if (mass > 0) {
+					index = c;
+					if (randVal < mass) {
+						break;
+					}
+					randVal -= mass;
+				}
+			}
+		} else {
+			// The rest of candidates duplicate chosen ones or weigh nothing
+			for (int c = 0; c < m && index == -1; ++c) {
+				if (weights[c] >= 0) {
+					index = c;
+				}
+			}
+		}
+
+		// Chosen candidates are flagged by a negative weight
+		chosen.push_back(index);
+		closestCandDist[index] = 0;
+		weights[index] = -1;
+
+		cv::Mat center = candidatesData.row(index);
+		FunctionUtils::runPartitioned(candBounds,
+				[&](int, int begin, int end) {
+					for (int c = begin; c < end; ++c) {
+						if (weights[c] < 0) {
+							continue;
+						}
+						double dist = distance(
+								(TDescriptor*) candidatesData.row(c).data,
+								(TDescriptor*) center.data, dataset.cols);
+						closestCandDist[c] =
+								centerCount == 0 ?
+										dist : std::min(closestCandDist[c], dist);
+					}
+				});
+	}
+
+	for (int j = 0; j < k; ++j) {
+		centers[j] = indices[candidates[chosen[j]]];
+	}
+	centers_length = k;
+}
+
+// --------------------------------------------------------------------------
+
 template<typename TDescriptor, typename Distance>
 cv::Ptr<CentersChooser<TDescriptor, Distance> > CentersChooser<TDescriptor,
-		Distance>::create(const cvflann::flann_centers_init_t& type) {
+		Distance>::create(const cvflann::flann_centers_init_t& type,
+		int numThreads) {
 
 	cv::Ptr<CentersChooser<TDescriptor, Distance> > cc;
 
@@ -295,6 +534,8 @@ cv::Ptr<CentersChooser<TDescriptor, Distance> > CentersChooser<TDescriptor,
 		cc = new GonzalezCenters<TDescriptor, Distance>();
 	} else if (type == cvflann::FLANN_CENTERS_KMEANSPP) {
 		cc = new KmeansppCenters<TDescriptor, Distance>();
+	} else if (type == vlr::CENTERS_KMEANSPARALLEL) {
+		cc = new KmeansParallelCenters<TDescriptor, Distance>(numThreads);
 	} else {
 		CV_Error(CV_StsBadArg,
 				"Unknown algorithm for choosing initial centers");
@@ -0,0 +1,164 @@
+/*
+ * ClusterReseeder.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: andresf
+ */
+
+#ifndef CLUSTERRESEEDER_H_
+#define CLUSTERRESEEDER_H_
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace vlr {
+
+/**
+ * Repairs the empty clusters left by an assignment step: every empty cluster takes the
+ * farthest point of the biggest cluster and becomes a 1-point cluster.
+ *
+ * The result is the one of handling the empty clusters one at a time in increasing order,
+ * each time scanning for the biggest cluster (the lowest index among equals) and for its
+ * farthest member (the lowest index among equals), but all of them are repaired in one
+ * sweep: a max-heap of the cluster sizes decides how many points each donor cluster gives
+ * away, then a single pass over the points gathers the farthest members of the donors.
+ * This costs O(k + e log k + n log e) for e empty clusters instead of O(e (k + n)).
+ *
+ * Clusters emptied by giving their points away are not refilled, which only happens when
+ * there are about as many points as clusters.
+ */
+class ClusterReseeder {
+
+public:
+
+	/**
+	 * Moves the farthest points of the biggest clusters to the empty clusters.
+	 *
+	 * @param numClusters - Number of clusters
+	 * @param numPoints - Number of points
+	 * @param counts - Number of points in each cluster, updated
+	 * @param belongsTo - Cluster of each point, updated
+	 * @param distanceTo - Distance from each point to its cluster center
+	 * @param refresh - Called on every member of a donor cluster before its distance is
+	 * read, e.g. to replace an upper bound by the exact distance
+	 * @param moved - Output, the points moved to the empty clusters
+	 * @return The number of clusters which were empty
+	 */
+	template<typename DistanceType, typename Refresh>
+	static int reseed(int numClusters, int numPoints, int* counts, int* belongsTo,
+			DistanceType* distanceTo, Refresh refresh, std::vector<int>& moved) {
+
+		moved.clear();
+
+		std::vector<int> empty;
+		for (int k = 0; k < numClusters; ++k) {
+			if (counts[k] == 0) {
+				empty.push_back(k);
+			}
+		}
+
+		if (empty.empty()) {
+			return 0;
+		}
+
+		// 1. Pick the donor of every empty cluster, largest size first and
+		// lowest index among equal sizes
+		std::priority_queue<std::pair<int, int> > sizes;
+		for (int k = 0; k < numClusters; ++k) {
+			if (counts[k] > 0) {
+				sizes.push(std::make_pair(counts[k], -k));
+			}
+		}
+
+		std::vector<int> donors(empty.size(), -1);
+		// Position of each donor in the candidates lists
+		std::vector<int> slot(numClusters, -1);
+		std::vector<int> needed;
+		for (size_t e = 0; e < empty.size() && sizes.empty() == false; ++e) {
+			std::pair<int, int> top = sizes.top();
+			sizes.pop();
+			int j = -top.second;
+			donors[e] = j;
+			if (slot[j] == -1) {
+				slot[j] = needed.size();
+				needed.push_back(0);
+			}
+			++needed[slot[j]];
+			if (top.first > 1) {
+				sizes.push(std::make_pair(top.first - 1, top.second));
+			}
+		}
+
+		// 2. Gather the farthest members of every donor in one pass, each list is a
+		// min-heap on the candidate order so its worst candidate is on top
+		typedef std::pair<DistanceType, int> Candidate;
+		std::vector<std::vector<Candidate> > candidates(needed.size());
+		for (int i = 0; i < numPoints; ++i) {
+			int s = slot[belongsTo[i]];
+			if (s == -1) {
+				continue;
+			}
+			refresh(i);
+			std::vector<Candidate>& heap = candidates[s];
+			Candidate candidate(distanceTo[i], i);
+			if (int(heap.size()) < needed[s]) {
+				heap.push_back(candidate);
+				std::push_heap(heap.begin(), heap.end(), farther<DistanceType>);
+			} else if (farther(candidate, heap.front())) {
+				std::pop_heap(heap.begin(), heap.end(), farther<DistanceType>);
+				heap.back() = candidate;
+				std::push_heap(heap.begin(), heap.end(), farther<DistanceType>);
+			}
+		}
+		for (size_t s = 0; s < candidates.size(); ++s) {
+			std::sort_heap(candidates[s].begin(), candidates[s].end(),
+					farther<DistanceType>);
+		}
+
+		// 3. Move the candidates, farthest first, to the empty clusters
+		std::vector<int> taken(needed.size(), 0);
+		for (size_t e = 0; e < empty.size(); ++e) {
+			int j = donors[e];
+			if (j == -1) {
+				break;
+			}
+			int s = slot[j];
+			int i = candidates[s][taken[s]++].second;
+			--counts[j];
+			++counts[empty[e]];
+			belongsTo[i] = empty[e];
+			moved.push_back(i);
+		}
+
+		return empty.size();
+	}
+
+	/**
+	 * Overload for distances which need no refreshing.
+	 */
+	template<typename DistanceType>
+	static int reseed(int numClusters, int numPoints, int* counts, int* belongsTo,
+			DistanceType* distanceTo, std::vector<int>& moved) {
+		return reseed(numClusters, numPoints, counts, belongsTo, distanceTo,
+				[](int) {}, moved);
+	}
+
+private:
+
+	/**
+	 * Candidate order, a farther point comes first and ties go to the lowest index.
+	 */
+	template<typename DistanceType>
+	static bool farther(const std::pair<DistanceType, int>& a,
+			const std::pair<DistanceType, int>& b) {
+		return a.first > b.first || (a.first == b.first && a.second < b.second);
+	}
+
+};
+
+} /* namespace vlr */
+
+#endif /* CLUSTERRESEEDER_H_ */
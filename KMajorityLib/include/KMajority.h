@@ -12,6 +12,7 @@
 #include <opencv2/features2d/features2d.hpp>
 #include <opencv2/flann/flann.hpp>
 
+#include <BinaryVocabFile.hpp>
 #include <DynamicMat.hpp>
 #include <VocabBase.hpp>
 
@@ -22,22 +23,47 @@ namespace vlr {
 
 // Allowed nearest neighbor index algorithms
 enum indexType {
-	LINEAR = 0, HIERARCHICAL = 1
+	LINEAR = 0, HIERARCHICAL = 1, HCTREE = 2
 };
 
 cvflann::NNIndex<Distance>* createIndexByType(
 		const cvflann::Matrix<typename Distance::ElementType>& dataset,
 		vlr::indexType type, const cvflann::IndexParams& params);
 
+/**
+ * Estimates the number of distances computed by building a nearest neighbors index over
+ * the centers: every tree assigns all the centers to branching centers once per level
+ * above the leaves.
+ *
+ * @param numCenters - Number of centers indexed
+ * @param params - Parameters to the nearest neighbors index
+ * @return The estimated number of distances
+ */
+double estimateIndexBuildCost(int numCenters, const cvflann::IndexParams& params);
+
 struct KMajorityParams: public cvflann::IndexParams {
 	KMajorityParams(int numClusters = 1000000, int maxIterations = 10,
 			vlr::indexType nnType = vlr::HIERARCHICAL,
 			cvflann::flann_centers_init_t centersInitMethod =
-					cvflann::FLANN_CENTERS_RANDOM) {
+					cvflann::FLANN_CENTERS_RANDOM, int numThreads = 0,
+			int indexRebuildThreshold = -1, bool boundsPruning = false) {
 		(*this)["num.clusters"] = numClusters;
 		(*this)["max.iterations"] = maxIterations;
 		(*this)["centers.init.method"] = centersInitMethod;
 		(*this)["nn.type"] = nnType;
+		// Zero or negative to use all available cores
+		(*this)["num.threads"] = numThreads;
+		// Number of changed centers above which the nearest neighbors index is rebuilt,
+		// negative to rebuild it whenever searching them costs more than rebuilding it
+		(*this)["index.rebuild.threshold"] = indexRebuildThreshold;
+		// Skip the search of data points whose distance bounds prove their cluster, LINEAR index only
+		(*this)["bounds.pruning"] = int(boundsPruning);
+		// Directory where the training is checkpointed, empty to disable checkpoints
+		(*this)["checkpoint.dir"] = std::string();
+		// Number of iterations between checkpoints
+		(*this)["checkpoint.every"] = 1;
+		// Whether to continue from the checkpoint found in the checkpoint directory
+		(*this)["checkpoint.resume"] = 0;
 	}
 };
 
@@ -65,12 +91,36 @@ protected:
 	std::vector<int> m_clusterCounts;
 	// Matrix of clusters centers
 	cv::Mat m_centroids;
+	// Mapping of a binary vocabulary the centers point into, if loaded from one
+	cv::Ptr<BinaryVocabFile> m_vocabFile;
 	// Nearest neighbor index type
 	vlr::indexType m_nnType;
 	// Index for addressing nearest neighbors search
 	cvflann::NNIndex<Distance>* m_nnIndex = NULL;
 	// Nearest neighbors index parameters
 	cvflann::IndexParams m_nnIndexParams;
+	// Number of threads quantizing data and computing centers
+	int m_numThreads;
+	// Flags of the centers changed since the index was built
+	std::vector<char> m_isStale;
+	// Centers changed since the index was built, searched linearly besides the index
+	std::vector<int> m_staleCentroids;
+	// Number of changed centers above which the index is rebuilt, negative to decide
+	// by the estimated costs
+	int m_indexRebuildThreshold;
+	// Whether data points are only searched when their distance bounds allow a new cluster
+	bool m_boundsPruning;
+	// Lower bound of the distance from each data point to any cluster but its own,
+	// with bounds pruning m_distanceTo holds an upper bound to its own cluster instead
+	std::vector<DistanceType> m_lowerBound;
+	// Distance each center moved in the last centers computation
+	std::vector<DistanceType> m_drift;
+	// Directory of the checkpoints, empty if disabled
+	std::string m_checkpointDir;
+	// Number of iterations between checkpoints
+	int m_checkpointEvery;
+	// Whether to continue from the last checkpoint
+	bool m_resume;
 
 public:
 
@@ -96,14 +146,15 @@ public:
 	void build();
 
 	/**
-	 * Saves the vocabulary to a file stream.
+	 * Saves the vocabulary to a file stream, as a binary vocabulary if the file name
+	 * has the .bin extension.
 	 *
 	 * @param filename - The name of the file stream where to save the vocabulary
 	 */
 	void save(const std::string& filename) const;
 
 	/**
-	 * Loads the vocabulary to a file stream.
+	 * Loads the vocabulary to a file stream, binary vocabularies are memory mapped.
 	 *
 	 * @param filename - The name of the file stream where to save the vocabulary
 	 */
@@ -125,12 +176,24 @@ public:
 	 * Component wise thresholding of accumulator vector.
 	 *
 	 * @param accVector - Row oriented accumulator vector
-	 * @param result - Row vector containing the thresholding result
+	 * @param result - Row vector overwritten with the thresholding result
 	 * @param threshold - Threshold value, typically the number of data points used to compute the accumulator vector
 	 */
 	static void majorityVoting(const cv::Mat& accVector, cv::Mat& result,
 			const int& threshold);
 
+	/**
+	 * Groups data points by the cluster they belong to.
+	 *
+	 * @param belongsTo - Cluster each data point belongs to, points with a value outside [0, numClusters) are skipped
+	 * @param numClusters - Number of clusters
+	 * @param clusterStart - Output vector of numClusters + 1 offsets into clusterMembers
+	 * @param clusterMembers - Output indices of the data points sorted by cluster, then by index
+	 */
+	static void groupByCluster(const std::vector<int>& belongsTo,
+			int numClusters, std::vector<int>& clusterStart,
+			std::vector<int>& clusterMembers);
+
 	/**** Getters ****/
 
 	const cv::Mat& getCentroids() const;
@@ -139,6 +202,8 @@ public:
 
 	const std::vector<int>& getClusterAssignments() const;
 
+	vlr::indexType getNNType() const;
+
 private:
 
 	/**
@@ -146,16 +211,52 @@ private:
 	 */
 	void initCentroids();
 
+	/**
+	 * Atomically saves the centroids, the cluster assignments and the number of
+	 * iterations done to the checkpoint directory. The index is not saved, the
+	 * caller drops it so that the next iteration rebuilds it as a resumed build does.
+	 *
+	 * @param iteration - Number of iterations done
+	 * @param converged - Whether the last iteration changed no assignment
+	 * @param seed - Seed of the random generator from the checkpoint on
+	 */
+	void saveCheckpoint(int iteration, bool converged, unsigned seed) const;
+
+	/**
+	 * Loads the centroids and the cluster assignments from the checkpoint directory,
+	 * and reseeds the random generator as it was right after the checkpoint.
+	 *
+	 * @param iteration - Output, number of iterations done
+	 * @param converged - Output, whether the last iteration changed no assignment
+	 * @return false if there is no checkpoint
+	 * @throw runtime_error if the checkpoint directory is not set
+	 */
+	bool loadCheckpoint(int& iteration, bool& converged);
+
 	/**
 	 * Implements majority voting scheme for cluster centers computation
 	 * based on component wise majority of bits from data matrix
 	 * as proposed by Grana2013.
+	 *
+	 * The clusters are split into ranges holding about the same number of data points,
+	 * the centroids of each range are voted on their own thread. Centroids whose vote
+	 * changed are flagged as stale for the nearest neighbors index, and the distance
+	 * every centroid moved is kept for bounds pruning.
 	 */
 	void computeCentroids();
 
 	/**
 	 * Assigns data to clusters by means of Hamming distance.
 	 *
+	 * The data points are split into one contiguous range per thread and searched in
+	 * batches, the cluster counts and convergence flags of the threads are then reduced.
+	 * Stale centroids are compared against every data point besides the index search.
+	 *
+	 * With bounds pruning the distance bounds of every data point are first loosened by
+	 * the drift of the centers, as in Hamerly2010. A data point is only read when its
+	 * bounds allow a closer center, and only searched when they still allow one once the
+	 * upper bound is made exact. The assignments are the same as without pruning.
+	 *
 	 * @return true if convergence was achieved (cluster assignment didn't changed), false otherwise
 	 */
 	bool quantize();
@@ -167,6 +268,13 @@ private:
 
 	/**
 	 * Build index for addressing nearest neighbors descriptors search.
+	 *
+	 * The index reads the centroids in place, hence it is only rebuilt, releasing the
+	 * previous one first, when more than index.rebuild.threshold centroids changed since
+	 * it was built. Otherwise it is kept and the changed centroids are searched linearly.
+	 *
+	 * With a negative threshold the index is kept while comparing every data point to the
+	 * changed centroids computes fewer distances than rebuilding the index.
 	 */
 	void updateIndex();
 
@@ -0,0 +1,192 @@
+/*
+ * MiniBatchKMajority.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: andresf
+ */
+
+#ifndef MINIBATCHKMAJORITY_H_
+#define MINIBATCHKMAJORITY_H_
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/flann/flann.hpp>
+
+#include <KMajority.h>
+#include <VocabBase.hpp>
+
+namespace vlr {
+
+struct MiniBatchKMajorityParams: public cvflann::IndexParams {
+	MiniBatchKMajorityParams(int numClusters = 1000000, int batchSize = 100000,
+			int maxIterations = 100, double tolerance = 1e-4,
+			vlr::indexType nnType = vlr::HIERARCHICAL,
+			int indexRebuildThreshold = -1) {
+		(*this)["num.clusters"] = numClusters;
+		// Minimum number of descriptors per batch, whole files are always loaded
+		(*this)["batch.size"] = batchSize;
+		// Maximum number of batches
+		(*this)["max.iterations"] = maxIterations;
+		// Fraction of centroid bits changed by a batch below which training stops
+		(*this)["tolerance"] = tolerance;
+		(*this)["nn.type"] = nnType;
+		// Number of changed centers above which the nearest neighbors index is rebuilt,
+		// negative to rebuild it whenever searching them costs more than rebuilding it
+		(*this)["index.rebuild.threshold"] = indexRebuildThreshold;
+	}
+};
+
+/**
+ * Mini-batch k-majority, as the mini-batch k-means by Sculley2010 but with the centroids
+ * given by the bitwise majority of all the data ever assigned to them.
+ *
+ * Descriptors are never held in memory all at once: every iteration loads a batch of
+ * randomly chosen descriptor files, assigns its descriptors to the nearest centroids and
+ * adds their bits to the per-cluster bit counts, the centroids which received data are
+ * then voted again. Training stops when a batch changes less than a tolerance fraction
+ * of the centroid bits or after the maximum number of batches.
+ *
+ * The nearest neighbors index is kept across batches as by KMajority::updateIndex, a
+ * batch only changes part of the centroids and rebuilding the index over all of them
+ * for every batch would dominate the training time.
+ *
+ * The vocabulary is saved as an AKMAJ vocabulary.
+ */
+class MiniBatchKMajority: public VocabBase {
+
+public:
+
+	/**
+	 * Class constructor.
+	 *
+	 * @param descriptorsFilenames - Names of the binary descriptor files to train from
+	 * @param params - Parameters to the mini-batch k-majority algorithm
+	 * @param nnIndexParams - Parameters to the nearest neighbors index
+	 */
+	MiniBatchKMajority(
+			const std::vector<std::string>& descriptorsFilenames =
+					std::vector<std::string>(),
+			const cvflann::IndexParams& params = MiniBatchKMajorityParams(),
+			const cvflann::IndexParams& nnIndexParams = cvflann::IndexParams());
+
+	/**
+	 * Class destroyer.
+	 */
+	~MiniBatchKMajority();
+
+	/**
+	 * Implements the mini-batch loop.
+	 */
+	void build();
+
+	/**
+	 * Saves the vocabulary to a file stream, readable by KMajority::load, as a binary
+	 * vocabulary if the file name has the .bin extension.
+	 *
+	 * @param filename - The name of the file stream where to save the vocabulary
+	 */
+	void save(const std::string& filename) const;
+
+	size_t size() const {
+		return m_centroids.rows;
+	}
+
+	/**
+	 * Adds the bits of a descriptor to a row of bit counts, entry 8 * b + t counts
+	 * bit t (0 being the least significant) of byte b.
+	 *
+	 * @param descriptor - Pointer to the dim bytes of the descriptor
+	 * @param dim - Length of the descriptor in bytes
+	 * @param bitCounts - Pointer to the dim * 8 bit counts
+	 */
+	static void accumulateBits(const uchar* descriptor, int dim,
+			int* bitCounts);
+
+	/**** Getters ****/
+
+	const cv::Mat& getCentroids() const;
+
+	const std::vector<int>& getClusterCounts() const;
+
+	int getNumIterations() const;
+
+private:
+
+	/**
+	 * Loads randomly chosen descriptor files until the batch holds at least minSize
+	 * descriptors or every file was loaded once.
+	 *
+	 * @param batch - Output matrix with the descriptors of the batch
+	 * @param minSize - Minimum number of descriptors
+	 */
+	void loadBatch(cv::Mat& batch, int minSize);
+
+	/**
+	 * Initializes the centroids with distinct descriptors chosen at random from a batch.
+	 */
+	void initCentroids(const cv::Mat& batch);
+
+	/**
+	 * Rebuilds the nearest neighbors index when searching the centroids changed since
+	 * it was built costs more than rebuilding it, see KMajority::updateIndex.
+	 *
+	 * @param batchSize - Number of descriptors to search in the next batch
+	 */
+	void updateIndex(int batchSize);
+
+	/**
+	 * Assigns the descriptors of a batch to their nearest centroids, those changed since
+	 * the index was built are searched linearly.
+	 */
+	void quantize(const cv::Mat& batch, std::vector<int>& assignments);
+
+	/**
+	 * Adds the descriptors of a batch to the bit counts of their clusters and votes
+	 * again the centroids which received data, marking as stale those which changed.
+	 *
+	 * @return The number of centroid bits which changed
+	 */
+	long long updateCentroids(const cv::Mat& batch,
+			const std::vector<int>& assignments);
+
+	// Names of the descriptor files
+	std::vector<std::string> m_filenames;
+	// Number of clusters
+	int m_numClusters;
+	// Minimum number of descriptors per batch
+	int m_batchSize;
+	// Maximum number of batches
+	int m_maxIterations;
+	// Fraction of changed centroid bits below which training stops
+	double m_tolerance;
+	// Nearest neighbor index type and parameters
+	vlr::indexType m_nnType;
+	cvflann::IndexParams m_nnIndexParams;
+	// Nearest neighbors index over the centroids, kept across batches
+	cvflann::NNIndex<Distance>* m_nnIndex;
+	// Whether each centroid changed since the index was built, and their indices
+	std::vector<char> m_isStale;
+	std::vector<int> m_staleCentroids;
+	// Number of changed centroids above which the index is rebuilt, negative for auto
+	int m_indexRebuildThreshold;
+	// Dimensionality of the data under clustering (in Bytes)
+	int m_dim;
+	// Order the files are loaded in, reshuffled after every pass over them
+	std::vector<int> m_filesOrder;
+	size_t m_nextFile;
+	// Matrix of clusters centers
+	cv::Mat m_centroids;
+	// Bit counts of the data assigned to each cluster, (k x dim*8) integers
+	cv::Mat m_bitCounts;
+	// Number of data points assigned to each cluster
+	std::vector<int> m_clusterCounts;
+	// Number of batches processed by the last build
+	int m_numIterations;
+
+};
+
+} /* namespace vlr */
+
+#endif /* MINIBATCHKMAJORITY_H_ */
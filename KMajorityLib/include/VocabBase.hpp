@@ -13,6 +13,8 @@
 #include <boost/iostreams/filter/gzip.hpp>
 #include <boost/iostreams/filtering_stream.hpp>
 
+#include <BinaryVocabFile.hpp>
+
 namespace vlr {
 
 class VocabBase {
@@ -46,6 +48,11 @@ public:
 
 	static std::string loadVocabType(const std::string& filename) {
 
+		// Binary vocabularies carry the type in their header
+		if (BinaryVocabFile::isBinaryVocab(filename)) {
+			return BinaryVocabFile(filename).getType();
+		}
+
 		std::ifstream inputZippedFileStream;
 		boost::iostreams::filtering_istream inputFileStream;
 
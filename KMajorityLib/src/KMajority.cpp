@@ -6,7 +6,12 @@
  */
 
 #include <KMajority.h>
+#include <BitCounter.h>
 #include <CentersChooser.h>
+#include <ClusterReseeder.h>
+#include <FileUtils.hpp>
+#include <FunctionUtils.hpp>
+#include <HCForestIndex.hpp>
 
 #include <boost/iostreams/filter/gzip.hpp>
 #include <boost/iostreams/filtering_stream.hpp>
@@ -16,13 +21,23 @@
 #include <opencv2/flann/random.h>
 #include <opencv2/flann/dist.h>
 
+#include <algorithm>
 #include <iostream>
 #include <bitset>
+#include <cmath>
+#include <cstring>
+#include <exception>
 #include <fstream>
 #include <functional>
+#include <limits>
+#include <numeric>
+#include <thread>
 
 namespace vlr {
 
+// Number of data points fetched and searched at once by every quantizing thread
+static const int QUANTIZE_BATCH_SIZE = 1024;
+
 KMajority::KMajority(vlr::Mat& data, const cvflann::IndexParams& params,
 		const cvflann::IndexParams& nnIndexParams) :
 		m_dataset(data), m_dim(data.cols), m_nnIndex(NULL), m_nnIndexParams(
@@ -34,6 +49,19 @@ KMajority::KMajority(vlr::Mat& data, const cvflann::IndexParams& params,
 	m_centersInitMethod = cvflann::get_param<cvflann::flann_centers_init_t>(
 			params, "centers.init.method");
 	m_nnType = cvflann::get_param<vlr::indexType>(params, "nn.type");
+	m_numThreads = cvflann::get_param<int>(params, "num.threads", 0);
+	if (m_numThreads <= 0) {
+		m_numThreads = std::max(1, int(std::thread::hardware_concurrency()));
+	}
+	m_indexRebuildThreshold = cvflann::get_param<int>(params,
+			"index.rebuild.threshold", -1);
+	m_boundsPruning = cvflann::get_param<int>(params, "bounds.pruning", 0)
+			!= 0;
+	m_checkpointDir = cvflann::get_param<std::string>(params, "checkpoint.dir",
+			std::string());
+	m_checkpointEvery = std::max(1,
+			cvflann::get_param<int>(params, "checkpoint.every", 1));
+	m_resume = cvflann::get_param<int>(params, "checkpoint.resume", 0) != 0;
 	m_numDatapoints = m_dataset.rows;
 
 	// Initially all transactions belong to any cluster
@@ -70,6 +98,12 @@ void KMajority::build() {
 		throw std::runtime_error("[KMajority::build] Descriptors is empty");
 	}
 
+	// Bounds only prove the assignments of an exact search
+	if (m_boundsPruning && m_nnType != vlr::LINEAR) {
+		throw std::runtime_error("[KMajority::build] "
+				"Bounds pruning requires a LINEAR nearest neighbors index");
+	}
+
 	// Trivial case: less data than clusters, assign one data point per cluster
 	if (m_numDatapoints <= m_numClusters) {
 		m_centroids.create(m_numClusters, m_dim, m_dataset.type());
@@ -85,26 +119,43 @@ void KMajority::build() {
 	printf("-- Bootstrapping clustering process\n");
 #endif
 
-	// Randomly generate clusters
+	int iteration = 0;
+	bool converged = false;
+	bool resumed = m_resume && loadCheckpoint(iteration, converged);
+
+	// Initially no center moved and the bounds prove nothing
+	m_drift.assign(m_numClusters, 0);
+	if (m_boundsPruning) {
+		m_lowerBound.assign(m_numDatapoints, 0);
+	}
+
+	if (resumed) {
+		// The assignments come with the checkpoint, the index is built by the
+		// next iteration
 #if KMAJVERBOSE
-	printf("   Initializing clusters centers.\n");
+		printf("   Resuming from the checkpoint of iteration [%d].\n",
+				iteration);
 #endif
-	initCentroids();
-
-	// Update nearest neighbors index upon new centers
+		m_isStale.assign(m_numClusters, 0);
+	} else {
+		// Randomly generate clusters
 #if KMAJVERBOSE
-	printf("   Updating nearest neighbors index.\n");
+		printf("   Initializing clusters centers.\n");
 #endif
-	updateIndex();
+		initCentroids();
 
-	// Assign data to clusters
+		// Update nearest neighbors index upon new centers
 #if KMAJVERBOSE
-	printf("   Quantizing data into clusters.\n");
+		printf("   Updating nearest neighbors index.\n");
 #endif
-	quantize();
+		updateIndex();
 
-	bool converged = false;
-	int iteration = 0;
+		// Assign data to clusters
+#if KMAJVERBOSE
+		printf("   Quantizing data into clusters.\n");
+#endif
+		quantize();
+	}
 
 	while (converged == false && iteration < m_maxIterations) {
 
@@ -138,12 +189,104 @@ void KMajority::build() {
 		printf("   Handling empty clusters case.\n");
 #endif
 		handleEmptyClusters();
+
+		if (m_checkpointDir.empty() == false
+				&& iteration % m_checkpointEvery == 0) {
+#if KMAJVERBOSE
+			printf("   Saving checkpoint.\n");
+#endif
+			unsigned seed = unsigned(cvflann::rand_int(RAND_MAX));
+			saveCheckpoint(iteration, converged, seed);
+			cvflann::seed_random(seed);
+			// A resumed build has no index, drop this one so both rebuild it
+			// at the next iteration and search the same way
+			delete m_nnIndex;
+			m_nnIndex = NULL;
+		}
 	}
 
 }
 
 // --------------------------------------------------------------------------
 
+void KMajority::saveCheckpoint(int iteration, bool converged,
+		unsigned seed) const {
+
+	std::string filename = m_checkpointDir + "/kmajority.ckpt.bin";
+
+	cv::Mat state(1, 3, CV_32S);
+	state.at<int>(0, 0) = iteration;
+	state.at<int>(0, 1) = converged;
+	state.at<int>(0, 2) = int(seed);
+
+	std::vector<std::string> names;
+	names.push_back("Centers");
+	names.push_back("Labels");
+	names.push_back("State");
+	std::vector<cv::Mat> matrices;
+	matrices.push_back(m_centroids);
+	matrices.push_back(
+			cv::Mat(m_numDatapoints, 1, CV_32S, (void*) m_belongsTo.data()));
+	matrices.push_back(state);
+
+	// Write aside then rename, a crash never leaves a partial checkpoint
+	BinaryVocabFile::save(filename + ".tmp", "AKMAJ.CKPT", names, matrices);
+	FileUtils::replaceFile(filename + ".tmp", filename);
+
+}
+
+// --------------------------------------------------------------------------
+
+bool KMajority::loadCheckpoint(int& iteration, bool& converged) {
+
+	if (m_checkpointDir.empty()) {
+		throw std::runtime_error("[KMajority::loadCheckpoint] "
+				"Resuming requires a checkpoint directory");
+	}
+
+	std::string filename = m_checkpointDir + "/kmajority.ckpt.bin";
+
+	if (FileUtils::checkFileExist(filename) == false) {
+		return false;
+	}
+
+	BinaryVocabFile checkpoint(filename);
+
+	if (checkpoint.getType().compare("AKMAJ.CKPT") != 0) {
+		throw std::runtime_error("[KMajority::loadCheckpoint] "
+				"File [" + filename + "] is not a k-majority checkpoint");
+	}
+
+	cv::Mat centers = checkpoint.getMatrix("Centers");
+	cv::Mat labels = checkpoint.getMatrix("Labels");
+
+	if (centers.rows != m_numClusters || centers.cols != m_dim
+			|| centers.type() != m_dataset.type()
+			|| labels.rows != m_numDatapoints) {
+		throw std::runtime_error("[KMajority::loadCheckpoint] "
+				"Checkpoint [" + filename + "] does not match the parameters");
+	}
+
+	// Deep copy, the matrix points into the mapping
+	m_centroids = centers.clone();
+	m_belongsTo.assign(labels.ptr<int>(0), labels.ptr<int>(0) + labels.rows);
+	m_clusterCounts.assign(m_numClusters, 0);
+	for (int i = 0; i < m_numDatapoints; ++i) {
+		++m_clusterCounts[m_belongsTo[i]];
+	}
+
+	cv::Mat state = checkpoint.getMatrix("State");
+	iteration = state.at<int>(0, 0);
+	converged = state.at<int>(0, 1) != 0;
+
+	// Draw the random numbers the interrupted build would have drawn
+	cvflann::seed_random(unsigned(state.at<int>(0, 2)));
+
+	return true;
+}
+
+// --------------------------------------------------------------------------
+
 void KMajority::initCentroids() {
 
 	// Initializing variables useful for obtaining indexes of random chosen center
@@ -158,8 +301,8 @@ void KMajority::initCentroids() {
 
 	// Randomly chose centers
 	CentersChooser<Distance::ElementType, cv::Hamming>::create(
-			m_centersInitMethod)->chooseCenters(m_numClusters, indices,
-			m_numDatapoints, centers_idx, centers_length, m_dataset);
+			m_centersInitMethod, m_numThreads)->chooseCenters(m_numClusters,
+			indices, m_numDatapoints, centers_idx, centers_length, m_dataset);
 	CV_Assert(centers_length == m_numClusters);
 
 	std::sort(centers_idx.begin(), centers_idx.end());
@@ -179,77 +322,207 @@ void KMajority::initCentroids() {
 
 bool KMajority::quantize() {
 
-	bool converged = true;
+	int numThreads = std::max(1, std::min(m_numThreads, m_numDatapoints));
 
-	// Number of nearest neighbors
-	int knn = 1;
+	// Number of nearest neighbors, the second one gives the lower bound
+	int knn = m_boundsPruning ? std::min(2, m_numClusters) : 1;
 
-	// The indices of the nearest neighbors found (numQueries X numNeighbors)
-	cvflann::Matrix<int> indices(new int[1 * knn], 1, knn);
-
-	// Distances to the nearest neighbors found (numQueries X numNeighbors)
-	cvflann::Matrix<DistanceType> distances(new DistanceType[1 * knn], 1, knn);
-
-	for (int i = 0; i < m_numDatapoints; ++i) {
-		std::fill(indices.data, indices.data + indices.rows * indices.cols, 0);
-		std::fill(distances.data,
-				distances.data + distances.rows * distances.cols, 0.0f);
-
-		cvflann::Matrix<Distance::ElementType> descriptor(
-				(Distance::ElementType*) m_dataset.row(i).data, 1,
-				m_dataset.cols);
-
-		/* Get new cluster it belongs to */
-		m_nnIndex->knnSearch(descriptor, indices, distances, knn,
-				cvflann::SearchParams());
-
-		/* Check if cluster assignment changed */
-		// If it did then algorithm hasn't converged yet
-		if (m_belongsTo[i] != indices[0][0]) {
-			converged = false;
-		}
+	// Every thread searches its own batches, the index must not split them again
+	cvflann::SearchParams searchParams;
+	searchParams["num.threads"] = 1;
 
-		/* Update cluster assignment and cluster counts */
-		// Decrease cluster count in case it was assigned to some valid cluster before.
-		// Recall that initially all transaction are assigned to kth cluster which
-		// is not valid since valid clusters run from 0 to k-1 both inclusive.
-		if (m_belongsTo[i] != m_numClusters) {
-			--m_clusterCounts[m_belongsTo[i]];
+	// Largest drifts, a data point's lower bound shrinks by the largest among other centers
+	int maxDriftIdx = int(
+			std::max_element(m_drift.begin(), m_drift.end()) - m_drift.begin());
+	DistanceType maxDrift = m_drift[maxDriftIdx], secondDrift = 0;
+	for (int j = 0; j < m_numClusters; ++j) {
+		if (j != maxDriftIdx) {
+			secondDrift = std::max(secondDrift, m_drift[j]);
 		}
-		m_belongsTo[i] = indices[0][0];
-		++m_clusterCounts[indices[0][0]];
-		m_distanceTo[i] = distances[0][0];
 	}
 
-	delete[] indices.data;
-	delete[] distances.data;
+	// One copy of the dataset per thread, see vlr::Mat(const Mat&)
+	std::vector<vlr::Mat> datasets(numThreads, m_dataset);
+
+	// Per thread convergence flags, cluster counts and number of distances computed,
+	// reduced once all are done
+	std::vector<char> threadConverged(numThreads, 1);
+	std::vector<std::vector<int> > threadCounts(numThreads);
+	std::vector<long long> threadComputed(numThreads, 0);
+
+	FunctionUtils::runPartitioned(
+			FunctionUtils::splitEvenly(m_numDatapoints, numThreads),
+			[&](int t, int begin, int end) {
+
+				std::vector<int>& counts = threadCounts[t];
+				counts.assign(m_numClusters, 0);
+
+				cv::Mat batch(QUANTIZE_BATCH_SIZE, m_dim, m_dataset.type());
+				std::vector<int> batchPoints(QUANTIZE_BATCH_SIZE);
+				std::vector<int> indices(QUANTIZE_BATCH_SIZE * knn);
+				std::vector<DistanceType> distances(QUANTIZE_BATCH_SIZE * knn);
+				Distance distance;
+
+				for (int i = begin; i < end;) {
+
+					// Fill the batch with the data points whose cluster may change
+					int batchSize = 0;
+					for (; i < end && batchSize < QUANTIZE_BATCH_SIZE; ++i) {
+						int cluster = m_belongsTo[i];
+						bool bounded = m_boundsPruning && cluster != m_numClusters;
+						if (bounded) {
+							DistanceType drift = cluster == maxDriftIdx ?
+									secondDrift : maxDrift;
+							m_distanceTo[i] += m_drift[cluster];
+							m_lowerBound[i] = m_lowerBound[i] > drift ?
+									m_lowerBound[i] - drift : 0;
+							if (m_distanceTo[i] < m_lowerBound[i]) {
+								++counts[cluster];
+								continue;
+							}
+						}
+
+						datasets[t].row(i).copyTo(batch.row(batchSize));
+
+						if (bounded) {
+							// Tighten the upper bound before searching
+							m_distanceTo[i] = distance(batch.ptr<uchar>(batchSize),
+									m_centroids.ptr<uchar>(cluster), m_dim);
+							++threadComputed[t];
+							if (m_distanceTo[i] < m_lowerBound[i]) {
+								++counts[cluster];
+								continue;
+							}
+						}
+
+						batchPoints[batchSize++] = i;
+					}
+
+					if (batchSize == 0) {
+						continue;
+					}
+
+					cvflann::Matrix<Distance::ElementType> queries(
+							(Distance::ElementType*) batch.data, batchSize, m_dim);
+					cvflann::Matrix<int> nnIndices(indices.data(), batchSize, knn);
+					cvflann::Matrix<DistanceType> nnDistances(distances.data(),
+							batchSize, knn);
+
+					/* Get new cluster every data point in the batch belongs to */
+					m_nnIndex->knnSearch(queries, nnIndices, nnDistances, knn,
+							searchParams);
+					threadComputed[t] += (long long) batchSize * m_numClusters;
+
+					// Centroids changed since the index was built may be missed by its search
+					for (int c : m_staleCentroids) {
+						const uchar* centroid = m_centroids.ptr<uchar>(c);
+						for (int b = 0; b < batchSize; ++b) {
+							DistanceType d = distance(batch.ptr<uchar>(b), centroid,
+									m_dim);
+							if (d < distances[b * knn]) {
+								distances[b * knn] = d;
+								indices[b * knn] = c;
+							}
+						}
+					}
+
+					for (int b = 0; b < batchSize; ++b) {
+						int p = batchPoints[b];
+						int nearest = indices[b * knn];
+						/* Check if cluster assignment changed */
+						// If it did then algorithm hasn't converged yet
+						if (m_belongsTo[p] != nearest) {
+							threadConverged[t] = 0;
+						}
+						m_belongsTo[p] = nearest;
+						m_distanceTo[p] = distances[b * knn];
+						if (m_boundsPruning) {
+							m_lowerBound[p] = knn > 1 ? distances[b * knn + 1] :
+									std::numeric_limits<DistanceType>::max();
+						}
+						++counts[nearest];
+					}
+				}
+			});
+
+	// Cluster counts are summed up by ranges of clusters, one range per thread
+	FunctionUtils::runPartitioned(
+			FunctionUtils::splitEvenly(m_numClusters, numThreads),
+			[&](int, int begin, int end) {
+				for (int j = begin; j < end; ++j) {
+					int count = 0;
+					for (int t = 0; t < numThreads; ++t) {
+						count += threadCounts[t][j];
+					}
+					m_clusterCounts[j] = count;
+				}
+			});
+
+#if KMAJVERBOSE
+	if (m_boundsPruning) {
+		long long computed = std::accumulate(threadComputed.begin(),
+				threadComputed.end(), 0LL);
+		printf("   Skipped [%.2f]%% of the distance computations\n",
+				100.0
+						* (1.0
+								- double(computed)
+										/ (double(m_numDatapoints)
+												* m_numClusters)));
+	}
+#endif
 
-	return converged;
+	return std::find(threadConverged.begin(), threadConverged.end(), 0)
+			== threadConverged.end();
 }
 
 // --------------------------------------------------------------------------
 
 void KMajority::computeCentroids() {
 
-	// Warning: using matrix of integers, there might be an overflow when summing too much descriptors
-	cv::Mat bitwiseCount(m_numClusters, m_dim * 8, cv::DataType<int>::type);
-	// Zeroing matrix of cumulative bits
-	bitwiseCount = cv::Scalar::all(0);
-	// Zeroing all cluster centers dimensions
-	m_centroids = cv::Scalar::all(0);
-
-	// Bitwise summing the data into each center
-	for (int i = 0; i < m_numDatapoints; ++i) {
-		cv::Mat b = bitwiseCount.row(m_belongsTo[i]);
-		KMajority::cumBitSum(m_dataset.row(i), b);
+	// Group the data points by cluster with a counting sort, so that every centroid
+	// is voted from a single bit counter instead of a (k x dim*8) integer matrix
+	std::vector<int> clusterStart, clusterMembers;
+	groupByCluster(m_belongsTo, m_numClusters, clusterStart, clusterMembers);
+
+	int numThreads = std::max(1, std::min(m_numThreads, m_numClusters));
+
+	// Split the clusters into ranges holding about the same number of data points,
+	// every thread votes the centroids of its range with its own bit counter
+	std::vector<int> bounds(numThreads + 1, m_numClusters);
+	bounds[0] = 0;
+	for (int t = 1, j = 0; t < numThreads; ++t) {
+		long long target = (long long) clusterStart[m_numClusters] * t
+				/ numThreads;
+		while (j < m_numClusters && clusterStart[j] < target) {
+			++j;
+		}
+		bounds[t] = j;
 	}
 
-	// Bitwise majority voting
-	for (int j = 0; j < m_numClusters; j++) {
-		cv::Mat centroid = m_centroids.row(j);
-		KMajority::majorityVoting(bitwiseCount.row(j), centroid,
-				m_clusterCounts[j]);
-	}
+	std::vector<vlr::Mat> datasets(numThreads, m_dataset);
+
+	FunctionUtils::runPartitioned(bounds, [&](int t, int begin, int end) {
+
+		BitCounter counter(m_dim);
+		std::vector<uchar> centroid(m_dim);
+		Distance distance;
+
+		for (int j = begin; j < end; ++j) {
+			counter.reset();
+			for (int p = clusterStart[j]; p < clusterStart[j + 1]; ++p) {
+				cv::Mat descriptor = datasets[t].row(clusterMembers[p]);
+				counter.add(descriptor.data);
+			}
+			// Bitwise majority voting
+			counter.majorityVoting(centroid.data(), m_clusterCounts[j]);
+			m_drift[j] = distance(centroid.data(), m_centroids.ptr<uchar>(j),
+					m_dim);
+			if (m_drift[j] != 0) {
+				memcpy(m_centroids.ptr<uchar>(j), centroid.data(), m_dim);
+				m_isStale[j] = 1;
+			}
+		}
+	});
 }
 
 // --------------------------------------------------------------------------
@@ -260,6 +533,18 @@ void KMajority::save(const std::string& filename) const {
 		throw std::runtime_error("[KMajority::save] Tree is empty");
 	}
 
+	// The index type is kept so the words are searched as they were trained
+	if (BinaryVocabFile::hasBinaryExtension(filename)) {
+		std::vector<std::string> names;
+		names.push_back("Centers");
+		names.push_back("NNType");
+		std::vector<cv::Mat> matrices;
+		matrices.push_back(m_centroids);
+		matrices.push_back(cv::Mat(1, 1, CV_32S, cv::Scalar::all(m_nnType)));
+		BinaryVocabFile::save(filename, "AKMAJ", names, matrices);
+		return;
+	}
+
 	cv::FileStorage fs(filename.c_str(), cv::FileStorage::WRITE);
 
 	if (fs.isOpened() == false) {
@@ -268,6 +553,7 @@ void KMajority::save(const std::string& filename) const {
 	}
 
 	fs << "type" << "AKMAJ";
+	fs << "nn.type" << int(m_nnType);
 	fs << "Centers" << m_centroids;
 
 	fs.release();
@@ -278,11 +564,29 @@ void KMajority::save(const std::string& filename) const {
 
 void KMajority::load(const std::string& filename) {
 
+	// Vocabularies saved without their index type were always searched hierarchically
+	m_nnType = vlr::HIERARCHICAL;
+
+	// Binary vocabularies are mapped, the centers point into the mapping
+	if (BinaryVocabFile::isBinaryVocab(filename)) {
+		m_vocabFile = new BinaryVocabFile(filename);
+		m_centroids = m_vocabFile->getMatrix("Centers");
+		if (m_vocabFile->hasMatrix("NNType")) {
+			m_nnType = vlr::indexType(
+					m_vocabFile->getMatrix("NNType").at<int>(0, 0));
+		}
+		return;
+	}
+
+	// Detach the centers from a previous mapping before unmapping it
+	m_centroids.release();
+	m_vocabFile.release();
+
 	enum nodeFields {
-		header, start, rows, cols, dt, data
+		header, start, rows, cols, dt, data, nnType
 	};
 	std::string nodeFieldsNames[] = { "YAML", "Centers", "rows:", "cols:",
-			"dt:", "data:" };
+			"dt:", "data:", "nn.type:" };
 
 	std::ifstream inputZippedFileStream;
 	boost::iostreams::filtering_istream inputFileStream;
@@ -324,6 +628,10 @@ void KMajority::load(const std::string& filename) {
 				ss >> _cols;
 			} else if (field.compare(nodeFieldsNames[dt]) == 0) {
 				ss >> _type;
+			} else if (field.compare(nodeFieldsNames[nnType]) == 0) {
+				int type;
+				ss >> type;
+				m_nnType = vlr::indexType(type);
 			} else {
 				if (field.compare(nodeFieldsNames[data]) == 0) {
 					m_centroids = cv::Mat::zeros(_rows, _cols,
@@ -373,16 +681,15 @@ void KMajority::cumBitSum(const cv::Mat& data, cv::Mat& accVector) {
 				"[KMajority::cumBitSum] number of columns in cumResult must be that of data times 8\n");
 	}
 
-	uchar byte = 0;
-	for (int l = 0; l < accVector.cols; l++) {
-		// bit: 7-(l%8) col: (int)l/8 descriptor: i
-		// Load byte every 8 bits
-		if ((l % 8) == 0) {
-			byte = *(data.col((int) l / 8).data);
+	const uchar* bytes = data.ptr<uchar>(0);
+	int* acc = accVector.ptr<int>(0);
+
+	// Accumulator entry 8*b+l holds bit 7-l of byte b, i.e. bits go from the MSB to the LSB
+	for (int b = 0; b < data.cols; ++b, acc += 8) {
+		uchar byte = bytes[b];
+		for (int l = 0; l < 8; ++l) {
+			acc[l] += (byte >> (7 - l)) & 1;
 		}
-		// Note: ignore maybe-uninitialized warning because loop starts with l=0 that means byte gets a value as soon as the loop start
-		// bit at ith position is mod(bitleftshift(byte,i),2) where ith position is 7-mod(l,8) i.e 7, 6, 5, 4, 3, 2, 1, 0
-		accVector.at<int>(0, l) += ((int) ((byte >> (7 - (l % 8))) % 2));
 	}
 
 }
@@ -404,23 +711,47 @@ void KMajority::majorityVoting(const cv::Mat& accVector, cv::Mat& result,
 				"[KMajority::majorityVoting] number of columns in 'accVector' must be that of 'result' times 8\n");
 	}
 
-	// In this point I already have stored in bitwiseCount the bitwise sum of all data assigned to jth cluster
-	for (int l = 0; l < accVector.cols; ++l) {
-		// If the bitcount for jth cluster at dimension l is greater than half of the data assigned to it
-		// then set lth centroid bit to 1 otherwise set it to 0 (break ties randomly)
-		bool bit;
-		// There is a tie if the number of data assigned to jth cluster is even
-		// AND the number of bits set to 1 in lth dimension is the half of the data assigned to jth cluster
-		if (threshold % 2 == 1
-				&& 2 * accVector.at<int>(0, l) == (int) threshold) {
-			bit = rand() % 2;
-		} else {
-			bit = 2 * accVector.at<int>(0, l) > (int) (threshold);
+	const int* acc = accVector.ptr<int>(0);
+	uchar* bytes = result.ptr<uchar>(0);
+
+	// The lth bit is set if its count is greater than half of the data assigned to the cluster,
+	// ties are only possible for an even number of data and resolve to 0.
+	// Results are stored from the LSB to the MSB, hence the vote of entry 8*b+l goes to
+	// bit 7-l of byte cols-1-b and the 8 votes of a byte are compared at once and reversed.
+	for (int b = 0; b < result.cols; ++b) {
+		uchar votes = BitCounter::voteByte(acc + 8 * b, threshold);
+		bytes[result.cols - 1 - b] = (uchar) (((votes * 0x0202020202ULL)
+				& 0x010884422010ULL) % 1023);
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void KMajority::groupByCluster(const std::vector<int>& belongsTo,
+		int numClusters, std::vector<int>& clusterStart,
+		std::vector<int>& clusterMembers) {
+
+	// Counting sort: members of cluster j are clusterMembers[clusterStart[j]..clusterStart[j+1])
+	// in increasing order, data assigned to no valid cluster are left out
+	clusterStart.assign(numClusters + 1, 0);
+	for (int c : belongsTo) {
+		if (c >= 0 && c < numClusters) {
+			++clusterStart[c + 1];
+		}
+	}
+	for (int j = 0; j < numClusters; ++j) {
+		clusterStart[j + 1] += clusterStart[j];
+	}
+
+	clusterMembers.resize(clusterStart[numClusters]);
+	std::vector<int> next(clusterStart.begin(), clusterStart.end() - 1);
+	for (int i = 0; i < (int) belongsTo.size(); ++i) {
+		int c = belongsTo[i];
+		if (c >= 0 && c < numClusters) {
+			clusterMembers[next[c]++] = i;
 		}
-		// Stores the majority voting result from the LSB to the MSB
-		result.at<unsigned char>(0, (int) (accVector.cols - 1 - l) / 8) += (bit)
-				<< ((accVector.cols - 1 - l) % 8);
 	}
+
 }
 
 // --------------------------------------------------------------------------
@@ -431,41 +762,67 @@ void KMajority::handleEmptyClusters() {
 	// 1. Find the biggest cluster.
 	// 2. Find farthest point in the biggest cluster
 	// 3. Exclude the farthest point from the biggest cluster and form a new 1-point cluster.
+	// All the empty clusters are repaired in one sweep, see ClusterReseeder
+
+	std::vector<int> moved;
+	ClusterReseeder::reseed(m_numClusters, m_numDatapoints,
+			m_clusterCounts.data(), m_belongsTo.data(), m_distanceTo.data(),
+			[this](int i) {
+				// With bounds pruning the distance may only be an upper bound
+				if (m_boundsPruning) {
+					cv::Mat descriptor = m_dataset.row(i);
+					m_distanceTo[i] = Distance()(descriptor.data,
+							m_centroids.ptr<uchar>(m_belongsTo[i]), m_dim);
+				}
+			}, moved);
 
-	for (int k = 0; k < m_numClusters; ++k) {
-		if (m_clusterCounts[k] != 0) {
-			continue;
+	// Their bounds no longer hold, force a search on the next quantization
+	if (m_boundsPruning) {
+		for (size_t m = 0; m < moved.size(); ++m) {
+			m_lowerBound[moved[m]] = 0;
 		}
+	}
+}
 
-		// 1. Find the biggest cluster
-		int max_k = 0;
-		for (int k1 = 1; k1 < m_numClusters; ++k1) {
-			if (m_clusterCounts[max_k] < m_clusterCounts[k1])
-				max_k = k1;
-		}
+// --------------------------------------------------------------------------
 
-		// 2. Find farthest point in the biggest cluster
-		DistanceType maxDist(-1);
-		int idxFarthestPt = -1;
-		for (int i = 0; i < m_numDatapoints; ++i) {
-			if (m_belongsTo[i] == max_k) {
-				if (maxDist < m_distanceTo[i]) {
-					maxDist = m_distanceTo[i];
-					idxFarthestPt = i;
-				}
+void KMajority::updateIndex() {
+
+	if (m_nnIndex != NULL) {
+		m_staleCentroids.clear();
+		for (int j = 0; j < m_numClusters; ++j) {
+			if (m_isStale[j]) {
+				m_staleCentroids.push_back(j);
 			}
 		}
 
-		// 3. Exclude the farthest point from the biggest cluster and form a new 1-point cluster
-		--m_clusterCounts[max_k];
-		++m_clusterCounts[k];
-		m_belongsTo[idxFarthestPt] = k;
-	}
-}
+		// A linear index reads the current centroids, nothing needs to be searched apart
+		if (m_nnType == vlr::LINEAR) {
+			m_isStale.assign(m_numClusters, 0);
+			m_staleCentroids.clear();
+			return;
+		}
 
-// --------------------------------------------------------------------------
+		// The index finds the centroids which did not change, the rest are searched
+		// linearly against every data point
+		bool keep = m_indexRebuildThreshold >= 0 ?
+				int(m_staleCentroids.size()) <= m_indexRebuildThreshold :
+				double(m_staleCentroids.size()) * m_numDatapoints
+						<= estimateIndexBuildCost(m_numClusters, m_nnIndexParams);
+		if (keep) {
+#if KMAJVERBOSE
+			printf("   Kept index, [%lu] changed centers searched linearly\n",
+					m_staleCentroids.size());
+#endif
+			return;
+		}
+	}
 
-void KMajority::updateIndex() {
+	// Release the previous index before building the new one
+	delete m_nnIndex;
+	m_nnIndex = NULL;
+	m_isStale.assign(m_numClusters, 0);
+	m_staleCentroids.clear();
 
 	m_nnIndex = vlr::createIndexByType(
 			cvflann::Matrix<Distance::ElementType>(
@@ -473,7 +830,7 @@ void KMajority::updateIndex() {
 					m_centroids.cols), m_nnType, m_nnIndexParams);
 
 	double mytime = cv::getTickCount();
-        m_nnIndex->buildIndex();
+	m_nnIndex->buildIndex();
 	mytime = ((double) cv::getTickCount() - mytime) / cv::getTickFrequency() * 1000;
 
 	printf("   Index built in [%lf] ms\n", mytime);
@@ -500,6 +857,12 @@ const std::vector<int>& KMajority::getClusterAssignments() const {
 
 // --------------------------------------------------------------------------
 
+vlr::indexType KMajority::getNNType() const {
+	return m_nnType;
+}
+
+// --------------------------------------------------------------------------
+
 cvflann::NNIndex<Distance>* createIndexByType(
 		const cvflann::Matrix<typename Distance::ElementType>& dataset,
 		vlr::indexType type, const cvflann::IndexParams& userDefParams) {
@@ -529,6 +892,15 @@ cvflann::NNIndex<Distance>* createIndexByType(
 		nnIndex = new cvflann::HierarchicalClusteringIndex<Distance>(dataset,
 				params, Distance());
 		break;
+	case vlr::HCTREE:
+		printf("-- Creating [HCForest] index\n");
+		params = vlr::HCForestIndexParams();
+		for (it = userDefParams.begin(); it != userDefParams.end(); ++it) {
+			int value = it->second.cast<int>();
+			params[it->first] = value;
+		}
+		nnIndex = new vlr::HCForestIndex<Distance>(dataset, params, Distance());
+		break;
 	default:
 		throw std::runtime_error("Unknown index type");
 	}
@@ -540,4 +912,24 @@ cvflann::NNIndex<Distance>* createIndexByType(
 	return nnIndex;
 }
 
+// --------------------------------------------------------------------------
+
+double estimateIndexBuildCost(int numCenters,
+		const cvflann::IndexParams& params) {
+
+	// Defaults of both the cvflann and the HCForest indexes
+	int trees = std::max(1, cvflann::get_param(params, "trees", 4));
+	int branching = std::max(2, cvflann::get_param(params, "branching", 32));
+	int leafSize = std::max(1, cvflann::get_param(params, "leaf_size", 100));
+
+	double levels =
+			numCenters > leafSize ?
+					std::ceil(
+							std::log(double(numCenters) / leafSize)
+									/ std::log(double(branching))) :
+					0;
+
+	return double(trees) * numCenters * branching * std::max(1.0, levels);
+}
+
 } /* namespace vlr */
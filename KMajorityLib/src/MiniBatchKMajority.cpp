@@ -0,0 +1,356 @@
+/*
+ * MiniBatchKMajority.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: andresf
+ */
+
+#include <MiniBatchKMajority.h>
+#include <BitCounter.h>
+
+#include <opencv2/flann/random.h>
+
+#include <FileUtils.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace vlr {
+
+MiniBatchKMajority::MiniBatchKMajority(
+		const std::vector<std::string>& descriptorsFilenames,
+		const cvflann::IndexParams& params,
+		const cvflann::IndexParams& nnIndexParams) :
+		m_filenames(descriptorsFilenames), m_nnIndexParams(nnIndexParams), m_nnIndex(
+				NULL), m_dim(0), m_nextFile(0), m_numIterations(0) {
+
+	// Attributes initialization
+	m_numClusters = cvflann::get_param<int>(params, "num.clusters");
+	m_batchSize = cvflann::get_param<int>(params, "batch.size");
+	m_maxIterations = cvflann::get_param<int>(params, "max.iterations");
+	m_tolerance = cvflann::get_param<double>(params, "tolerance");
+	m_nnType = cvflann::get_param<vlr::indexType>(params, "nn.type");
+	m_indexRebuildThreshold = cvflann::get_param<int>(params,
+			"index.rebuild.threshold", -1);
+
+}
+
+// --------------------------------------------------------------------------
+
+MiniBatchKMajority::~MiniBatchKMajority() {
+	delete m_nnIndex;
+}
+
+// --------------------------------------------------------------------------
+
+void MiniBatchKMajority::build() {
+
+	if (m_filenames.empty()) {
+		throw std::runtime_error(
+				"[MiniBatchKMajority::build] No descriptor files to train from");
+	}
+
+	m_filesOrder.resize(m_filenames.size());
+	for (size_t i = 0; i < m_filesOrder.size(); ++i) {
+		m_filesOrder[i] = int(i);
+	}
+	m_nextFile = m_filesOrder.size();
+
+	// The first batch must hold enough data to choose the centroids from
+	cv::Mat batch;
+	loadBatch(batch, std::max(m_batchSize, m_numClusters));
+
+	if (batch.rows < m_numClusters) {
+		throw std::runtime_error("[MiniBatchKMajority::build] "
+				"Got less descriptors than clusters");
+	}
+
+#if KMAJVERBOSE
+	printf("-- Initializing [%d] clusters centers\n", m_numClusters);
+#endif
+	initCentroids(batch);
+
+	std::vector<int> assignments;
+	double totalBits = double(m_numClusters) * m_dim * 8;
+
+	for (m_numIterations = 1; m_numIterations <= m_maxIterations;
+			++m_numIterations) {
+
+		if (m_numIterations > 1) {
+			loadBatch(batch, m_batchSize);
+		}
+
+		updateIndex(batch.rows);
+
+		quantize(batch, assignments);
+
+		double changed = updateCentroids(batch, assignments) / totalBits;
+
+#if KMAJVERBOSE
+		printf("-- Batch=[%d] descriptors=[%d] changed bits=[%f]\n",
+				m_numIterations, batch.rows, changed);
+		fflush(stdout);
+#endif
+
+		if (changed < m_tolerance) {
+			break;
+		}
+	}
+
+	m_numIterations = std::min(m_numIterations, m_maxIterations);
+
+	delete m_nnIndex;
+	m_nnIndex = NULL;
+
+}
+
+// --------------------------------------------------------------------------
+
+void MiniBatchKMajority::loadBatch(cv::Mat& batch, int minSize) {
+
+	batch.release();
+
+	cv::Mat descriptors;
+
+	for (size_t loaded = 0;
+			loaded < m_filesOrder.size() && batch.rows < minSize; ++loaded) {
+
+		// Shuffle the files again after every pass over them
+		if (m_nextFile == m_filesOrder.size()) {
+			std::random_shuffle(m_filesOrder.begin(), m_filesOrder.end(),
+					[](int n) {return cvflann::rand_int(n);});
+			m_nextFile = 0;
+		}
+
+		const std::string& filename = m_filenames[m_filesOrder[m_nextFile++]];
+		FileUtils::loadDescriptors(filename, descriptors);
+
+		if (descriptors.empty()) {
+			continue;
+		}
+
+		if (descriptors.type() != CV_8U) {
+			throw std::runtime_error("[MiniBatchKMajority::loadBatch] "
+					"Descriptors in [" + filename + "] are not binary");
+		}
+
+		if (m_dim == 0) {
+			m_dim = descriptors.cols;
+		} else if (descriptors.cols != m_dim) {
+			throw std::runtime_error("[MiniBatchKMajority::loadBatch] "
+					"Descriptors in [" + filename + "] have a different length");
+		}
+
+		batch.push_back(descriptors);
+	}
+
+	if (batch.empty()) {
+		throw std::runtime_error(
+				"[MiniBatchKMajority::loadBatch] Descriptor files are empty");
+	}
+
+}
+
+// --------------------------------------------------------------------------
+
+void MiniBatchKMajority::initCentroids(const cv::Mat& batch) {
+
+	cvflann::UniqueRandom random(batch.rows);
+
+	m_centroids.create(m_numClusters, m_dim, CV_8U);
+	for (int j = 0; j < m_numClusters; ++j) {
+		batch.row(random.next()).copyTo(m_centroids.row(j));
+	}
+
+	m_bitCounts = cv::Mat::zeros(m_numClusters, m_dim * 8, CV_32S);
+	m_clusterCounts.assign(m_numClusters, 0);
+
+	// The index of a previous build pointed to the old centroids
+	delete m_nnIndex;
+	m_nnIndex = NULL;
+
+}
+
+// --------------------------------------------------------------------------
+
+void MiniBatchKMajority::updateIndex(int batchSize) {
+
+	if (m_nnIndex != NULL) {
+		// A linear index reads the current centroids, nothing needs to be searched apart
+		if (m_nnType == vlr::LINEAR) {
+			m_isStale.assign(m_numClusters, 0);
+			m_staleCentroids.clear();
+			return;
+		}
+
+		m_staleCentroids.clear();
+		for (int j = 0; j < m_numClusters; ++j) {
+			if (m_isStale[j]) {
+				m_staleCentroids.push_back(j);
+			}
+		}
+
+		bool keep = m_indexRebuildThreshold >= 0 ?
+				int(m_staleCentroids.size()) <= m_indexRebuildThreshold :
+				double(m_staleCentroids.size()) * batchSize
+						<= estimateIndexBuildCost(m_numClusters, m_nnIndexParams);
+		if (keep) {
+#if KMAJVERBOSE
+			printf("   Kept index, [%lu] changed centers searched linearly\n",
+					m_staleCentroids.size());
+#endif
+			return;
+		}
+	}
+
+	// Release the previous index before building the new one
+	delete m_nnIndex;
+	m_nnIndex = NULL;
+	m_isStale.assign(m_numClusters, 0);
+	m_staleCentroids.clear();
+
+	m_nnIndex = vlr::createIndexByType(
+			cvflann::Matrix<Distance::ElementType>(
+					(Distance::ElementType*) m_centroids.data, m_centroids.rows,
+					m_centroids.cols), m_nnType, m_nnIndexParams);
+	m_nnIndex->buildIndex();
+
+}
+
+// --------------------------------------------------------------------------
+
+void MiniBatchKMajority::quantize(const cv::Mat& batch,
+		std::vector<int>& assignments) {
+
+	assignments.resize(batch.rows);
+	std::vector<DistanceType> distances(batch.rows);
+
+	cvflann::Matrix<int> nnIndices(assignments.data(), batch.rows, 1);
+	cvflann::Matrix<DistanceType> nnDistances(distances.data(), batch.rows, 1);
+
+	m_nnIndex->knnSearch(
+			cvflann::Matrix<Distance::ElementType>(
+					(Distance::ElementType*) batch.data, batch.rows, batch.cols),
+			nnIndices, nnDistances, 1, cvflann::SearchParams());
+
+	// Centroids changed since the index was built may be missed by its search
+	Distance distance;
+	for (int c : m_staleCentroids) {
+		const uchar* centroid = m_centroids.ptr<uchar>(c);
+		for (int i = 0; i < batch.rows; ++i) {
+			DistanceType d = distance(batch.ptr<uchar>(i), centroid, m_dim);
+			if (d < distances[i]) {
+				distances[i] = d;
+				assignments[i] = c;
+			}
+		}
+	}
+
+}
+
+// --------------------------------------------------------------------------
+
+long long MiniBatchKMajority::updateCentroids(const cv::Mat& batch,
+		const std::vector<int>& assignments) {
+
+	std::vector<char> touched(m_numClusters, 0);
+
+	for (int i = 0; i < batch.rows; ++i) {
+		int j = assignments[i];
+		accumulateBits(batch.ptr<uchar>(i), m_dim, m_bitCounts.ptr<int>(j));
+		++m_clusterCounts[j];
+		touched[j] = 1;
+	}
+
+	// Centroids which received no data keep their bits
+	long long changed = 0;
+	for (int j = 0; j < m_numClusters; ++j) {
+		if (touched[j] == 0) {
+			continue;
+		}
+		const int* bitCounts = m_bitCounts.ptr<int>(j);
+		uchar* centroid = m_centroids.ptr<uchar>(j);
+		long long changedBits = 0;
+		for (int b = 0; b < m_dim; ++b) {
+			uchar byte = BitCounter::voteByte(bitCounts + 8 * b,
+					m_clusterCounts[j]);
+			changedBits += __builtin_popcount(byte ^ centroid[b]);
+			centroid[b] = byte;
+		}
+		if (changedBits > 0) {
+			m_isStale[j] = 1;
+		}
+		changed += changedBits;
+	}
+
+	return changed;
+}
+
+// --------------------------------------------------------------------------
+
+void MiniBatchKMajority::accumulateBits(const uchar* descriptor, int dim,
+		int* bitCounts) {
+
+	for (int b = 0; b < dim; ++b, bitCounts += 8) {
+		uchar byte = descriptor[b];
+		for (int t = 0; t < 8; ++t) {
+			bitCounts[t] += (byte >> t) & 1;
+		}
+	}
+
+}
+
+// --------------------------------------------------------------------------
+
+void MiniBatchKMajority::save(const std::string& filename) const {
+
+	if (m_centroids.empty()) {
+		throw std::runtime_error("[MiniBatchKMajority::save] Vocabulary is empty");
+	}
+
+	// Saved as KMajority::save does, index type included
+	if (BinaryVocabFile::hasBinaryExtension(filename)) {
+		std::vector<std::string> names;
+		names.push_back("Centers");
+		names.push_back("NNType");
+		std::vector<cv::Mat> matrices;
+		matrices.push_back(m_centroids);
+		matrices.push_back(cv::Mat(1, 1, CV_32S, cv::Scalar::all(m_nnType)));
+		BinaryVocabFile::save(filename, "AKMAJ", names, matrices);
+		return;
+	}
+
+	cv::FileStorage fs(filename.c_str(), cv::FileStorage::WRITE);
+
+	if (fs.isOpened() == false) {
+		throw std::runtime_error("[MiniBatchKMajority::save] "
+				"Unable to open file [" + filename + "] for writing");
+	}
+
+	fs << "type" << "AKMAJ";
+	fs << "nn.type" << int(m_nnType);
+	fs << "Centers" << m_centroids;
+
+	fs.release();
+
+}
+
+// --------------------------------------------------------------------------
+
+const cv::Mat& MiniBatchKMajority::getCentroids() const {
+	return m_centroids;
+}
+
+// --------------------------------------------------------------------------
+
+const std::vector<int>& MiniBatchKMajority::getClusterCounts() const {
+	return m_clusterCounts;
+}
+
+// --------------------------------------------------------------------------
+
+int MiniBatchKMajority::getNumIterations() const {
+	return m_numIterations;
+}
+
+} /* namespace vlr */
@@ -0,0 +1,81 @@
+/*
+ * BitCounter_test.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: andresf
+ */
+
+#include <gtest/gtest.h>
+
+#include <BitCounter.h>
+#include <KMajority.h>
+
+TEST(BitCounter, Empty) {
+
+	vlr::BitCounter counter(4);
+
+	EXPECT_EQ(0, counter.total());
+
+	uchar result[4] = { 1, 1, 1, 1 };
+	counter.majorityVoting(result, 0);
+
+	for (int b = 0; b < 4; ++b) {
+		EXPECT_EQ(0, result[b]);
+	}
+
+}
+
+TEST(BitCounter, Count) {
+
+	vlr::BitCounter counter(2);
+
+	uchar data[] = { 0x01, 0x80 };
+	// Enough additions to overflow the bit planes several times
+	for (int i = 0; i < 1000; ++i) {
+		counter.add(data);
+	}
+
+	EXPECT_EQ(1000, counter.total());
+	EXPECT_EQ(1000, counter.count(0, 0));
+	EXPECT_EQ(0, counter.count(0, 7));
+	EXPECT_EQ(1000, counter.count(1, 7));
+	EXPECT_EQ(0, counter.count(1, 0));
+
+}
+
+TEST(BitCounter, EqualsCumBitSum) {
+
+	cv::RNG rng(0xFFFFFFFF);
+
+	// Lengths not multiple of a word included
+	int dims[] = { 4, 13, 32, 64 };
+	int sizes[] = { 1, 2, 255, 256, 1001 };
+
+	for (int dim : dims) {
+		for (int n : sizes) {
+			cv::Mat data(n, dim, CV_8U);
+			rng.fill(data, cv::RNG::UNIFORM, 0, 256);
+
+			cv::Mat acc = cv::Mat::zeros(1, dim * 8, CV_32S);
+			vlr::BitCounter counter(dim);
+			for (int i = 0; i < n; ++i) {
+				vlr::KMajority::cumBitSum(data.row(i), acc);
+				counter.add(data.ptr<uchar>(i));
+			}
+
+			cv::Mat counterAcc = cv::Mat::zeros(1, dim * 8, CV_32S);
+			counter.accumulate(counterAcc.ptr<int>(0));
+
+			EXPECT_EQ(0, cv::countNonZero(acc != counterAcc));
+
+			cv::Mat expected = cv::Mat::zeros(1, dim, CV_8U);
+			vlr::KMajority::majorityVoting(acc, expected, n);
+
+			cv::Mat result(1, dim, CV_8U);
+			counter.majorityVoting(result.ptr<uchar>(0), n);
+
+			EXPECT_EQ(0, cv::countNonZero(expected != result));
+		}
+	}
+
+}
@@ -6,3 +6,42 @@
  */
 
 #include <CentersChooser.h>
+
+#include <gtest/gtest.h>
+
+#include <set>
+
+TEST(CentersChooser, KmeansParallel) {
+
+	std::vector<std::string> filenames;
+	filenames.push_back("brief_0.bin");
+	vlr::Mat descriptors(filenames);
+
+	int k = 50;
+	std::vector<int> indices(descriptors.rows);
+	for (int i = 0; i < descriptors.rows; ++i) {
+		indices[i] = i;
+	}
+
+	std::vector<int> centers[2];
+	int threads[] = { 1, 4 };
+	for (int t = 0; t < 2; ++t) {
+		cvflann::seed_random(1234);
+		centers[t].resize(k);
+		int centers_length = 0;
+		CentersChooser<uchar, cv::Hamming>::create(vlr::CENTERS_KMEANSPARALLEL,
+				threads[t])->chooseCenters(k, indices.data(), descriptors.rows,
+				centers[t], centers_length, descriptors);
+		ASSERT_EQ(k, centers_length);
+
+		// Centers are distinct data points
+		std::set<int> distinct(centers[t].begin(), centers[t].end());
+		EXPECT_EQ(size_t(k), distinct.size());
+		EXPECT_LE(0, *distinct.begin());
+		EXPECT_GT(descriptors.rows, *distinct.rbegin());
+	}
+
+	// The sampling does not depend on the number of threads
+	EXPECT_TRUE(centers[0] == centers[1]);
+
+}
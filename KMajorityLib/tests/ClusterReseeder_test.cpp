@@ -0,0 +1,108 @@
+/*
+ * ClusterReseeder_test.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: andresf
+ */
+
+#include <gtest/gtest.h>
+
+#include <ClusterReseeder.h>
+
+#include <cstdlib>
+#include <vector>
+
+TEST(ClusterReseeder, NoEmptyClusters) {
+
+	int belongsTo[] = { 0, 1, 1, 2 };
+	int counts[] = { 1, 2, 1 };
+	int distanceTo[] = { 3, 1, 2, 0 };
+
+	std::vector<int> moved;
+	EXPECT_EQ(0,
+			vlr::ClusterReseeder::reseed(3, 4, counts, belongsTo, distanceTo,
+					moved));
+	EXPECT_TRUE(moved.empty());
+	EXPECT_EQ(2, counts[1]);
+
+}
+
+TEST(ClusterReseeder, FarthestOfBiggest) {
+
+	// Cluster 0 is the biggest, its farthest points are 3 then 1 (lowest index on ties)
+	int belongsTo[] = { 0, 0, 2, 0, 0, 2 };
+	int counts[] = { 4, 0, 2, 0 };
+	int distanceTo[] = { 1, 5, 9, 7, 5, 0 };
+
+	std::vector<int> moved;
+	EXPECT_EQ(2,
+			vlr::ClusterReseeder::reseed(4, 6, counts, belongsTo, distanceTo,
+					moved));
+
+	ASSERT_EQ(2u, moved.size());
+	EXPECT_EQ(3, moved[0]);
+	EXPECT_EQ(1, moved[1]);
+	EXPECT_EQ(1, belongsTo[3]);
+	EXPECT_EQ(3, belongsTo[1]);
+	EXPECT_EQ(2, counts[0]);
+	EXPECT_EQ(1, counts[1]);
+	EXPECT_EQ(2, counts[2]);
+	EXPECT_EQ(1, counts[3]);
+
+}
+
+TEST(ClusterReseeder, EqualsSequentialScan) {
+
+	srand(1234);
+
+	for (int trial = 0; trial < 200; ++trial) {
+		int k = 1 + rand() % 20;
+		int n = 2 * k + rand() % 60;
+		std::vector<int> belongsTo(n), counts(k, 0), distanceTo(n);
+		for (int i = 0; i < n; ++i) {
+			// Skew the assignments to leave some clusters empty
+			belongsTo[i] = rand() % 2 == 0 ? rand() % k : rand() % 3 % k;
+			++counts[belongsTo[i]];
+			distanceTo[i] = rand() % 5;
+		}
+
+		// Handle the empty clusters one at a time
+		std::vector<int> expectedBelongsTo = belongsTo;
+		std::vector<int> expectedCounts = counts;
+		bool degenerate = false;
+		for (int j = 0; j < k && degenerate == false; ++j) {
+			if (expectedCounts[j] != 0) {
+				continue;
+			}
+			int max_k = 0;
+			for (int k1 = 1; k1 < k; ++k1) {
+				if (expectedCounts[max_k] < expectedCounts[k1]) {
+					max_k = k1;
+				}
+			}
+			int maxDist = -1, idxFarthestPt = -1;
+			for (int i = 0; i < n; ++i) {
+				if (expectedBelongsTo[i] == max_k && maxDist < distanceTo[i]) {
+					maxDist = distanceTo[i];
+					idxFarthestPt = i;
+				}
+			}
+			degenerate = expectedCounts[max_k] <= 1;
+			--expectedCounts[max_k];
+			++expectedCounts[j];
+			expectedBelongsTo[idxFarthestPt] = j;
+		}
+
+		if (degenerate) {
+			continue;
+		}
+
+		std::vector<int> moved;
+		vlr::ClusterReseeder::reseed(k, n, counts.data(), belongsTo.data(),
+				distanceTo.data(), moved);
+
+		EXPECT_TRUE(expectedBelongsTo == belongsTo);
+		EXPECT_TRUE(expectedCounts == counts);
+	}
+
+}
@@ -5,7 +5,9 @@
  *      Author: andresf
  */
 
+#include <cstdio>
 #include <ctime>
+#include <stdexcept>
 
 #include <gtest/gtest.h>
 
@@ -38,10 +40,56 @@ TEST(KMajority, InstantiateOnStack) {
 
 TEST(KMajority, CumBitSum) {
 
+	uchar bytes[] = { 0x81, 0x0F };
+	cv::Mat data(1, 2, CV_8U, bytes);
+
+	cv::Mat acc = cv::Mat::zeros(1, 16, CV_32S);
+	vlr::KMajority::cumBitSum(data, acc);
+	vlr::KMajority::cumBitSum(data, acc);
+
+	// Bits are accumulated from the MSB to the LSB of every byte
+	int expected[] = { 2, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 2, 2, 2, 2 };
+	for (int l = 0; l < 16; ++l) {
+		EXPECT_EQ(expected[l], acc.at<int>(0, l));
+	}
+
 }
 
 TEST(KMajority, MajorityVoting) {
 
+	// Counts out of 4 data points, ties resolve to 0
+	int counts[] = { 3, 2, 0, 4, 1, 3, 2, 4, 4, 4, 4, 4, 0, 0, 0, 3 };
+	cv::Mat acc(1, 16, CV_32S, counts);
+
+	cv::Mat result = cv::Mat::zeros(1, 2, CV_8U);
+	vlr::KMajority::majorityVoting(acc, result, 4);
+
+	// The vote of entry l goes to bit (15 - l) % 8 of byte (15 - l) / 8
+	EXPECT_EQ(0xF1, result.at<uchar>(0, 0));
+	EXPECT_EQ(0x95, result.at<uchar>(0, 1));
+
+}
+
+TEST(KMajority, GroupByCluster) {
+
+	int labels[] = { 2, 0, 3, 2, 0, 1, 2 };
+	std::vector<int> belongsTo(labels, labels + 7);
+
+	std::vector<int> clusterStart, clusterMembers;
+	vlr::KMajority::groupByCluster(belongsTo, 3, clusterStart,
+			clusterMembers);
+
+	// Label 3 is not a valid cluster and is left out
+	int expectedStart[] = { 0, 2, 3, 6 };
+	int expectedMembers[] = { 1, 4, 5, 0, 3, 6 };
+	EXPECT_TRUE(
+			std::equal(clusterStart.begin(), clusterStart.end(),
+					expectedStart));
+	ASSERT_EQ(6u, clusterMembers.size());
+	EXPECT_TRUE(
+			std::equal(clusterMembers.begin(), clusterMembers.end(),
+					expectedMembers));
+
 }
 
 TEST(KMajority, Clustering) {
@@ -78,6 +126,97 @@ TEST(KMajority, Clustering) {
 
 }
 
+TEST(KMajority, ThreadsAgree) {
+
+	std::vector<std::string> filenames;
+	filenames.push_back("brief_0.bin");
+
+	vlr::Mat descriptors(filenames);
+
+	vlr::KMajorityParams params;
+	params["num.clusters"] = 10;
+	params["max.iterations"] = 10;
+	params["nn.type"] = vlr::indexType::LINEAR;
+
+	// Same initial centers for both runs
+	params["num.threads"] = 1;
+	cvflann::seed_random(1234);
+	vlr::KMajority serial(descriptors, params);
+	serial.build();
+
+	params["num.threads"] = 4;
+	cvflann::seed_random(1234);
+	vlr::KMajority parallel(descriptors, params);
+	parallel.build();
+
+	EXPECT_EQ(0,
+			cv::countNonZero(serial.getCentroids() != parallel.getCentroids()));
+	EXPECT_TRUE(serial.getClusterAssignments() == parallel.getClusterAssignments());
+	EXPECT_TRUE(serial.getClusterCounts() == parallel.getClusterCounts());
+
+}
+
+TEST(KMajority, KeepIndex) {
+
+	std::vector<std::string> filenames;
+	filenames.push_back("brief_0.bin");
+
+	vlr::Mat descriptors(filenames);
+
+	vlr::KMajorityParams params;
+	params["num.clusters"] = 10;
+	params["max.iterations"] = 10;
+	params["nn.type"] = vlr::indexType::HIERARCHICAL;
+	// Rebuild the index on every iteration
+	params["index.rebuild.threshold"] = 0;
+
+	cvflann::seed_random(1234);
+	vlr::KMajority rebuilt(descriptors, params);
+	rebuilt.build();
+
+	// Never rebuild the index, changed centers are searched linearly
+	params["index.rebuild.threshold"] = 10;
+
+	cvflann::seed_random(1234);
+	vlr::KMajority kept(descriptors, params);
+	kept.build();
+
+	// The centers fit in a single leaf, hence both searches are exact
+	EXPECT_EQ(0,
+			cv::countNonZero(rebuilt.getCentroids() != kept.getCentroids()));
+	EXPECT_TRUE(rebuilt.getClusterAssignments() == kept.getClusterAssignments());
+	EXPECT_TRUE(rebuilt.getClusterCounts() == kept.getClusterCounts());
+
+}
+
+TEST(KMajority, BoundsPruning) {
+
+	std::vector<std::string> filenames;
+	filenames.push_back("brief_0.bin");
+
+	vlr::Mat descriptors(filenames);
+
+	vlr::KMajorityParams params;
+	params["num.clusters"] = 10;
+	params["max.iterations"] = 10;
+	params["nn.type"] = vlr::indexType::LINEAR;
+
+	cvflann::seed_random(1234);
+	vlr::KMajority plain(descriptors, params);
+	plain.build();
+
+	params["bounds.pruning"] = 1;
+	cvflann::seed_random(1234);
+	vlr::KMajority pruned(descriptors, params);
+	pruned.build();
+
+	// Pruning must not change the clustering
+	EXPECT_EQ(0,
+			cv::countNonZero(plain.getCentroids() != pruned.getCentroids()));
+	EXPECT_TRUE(plain.getClusterAssignments() == pruned.getClusterAssignments());
+
+}
+
 TEST(KMajority, SaveLoad) {
 
 	std::vector<std::string> filenames;
@@ -103,6 +242,109 @@ TEST(KMajority, SaveLoad) {
 
 }
 
+TEST(KMajority, SaveLoadBinary) {
+
+	std::vector<std::string> filenames;
+	filenames.push_back("brief_0.bin");
+	vlr::Mat descriptors(filenames);
+
+	vlr::KMajorityParams params;
+	params["num.clusters"] = 10;
+	params["max.iterations"] = 10;
+	params["nn.type"] = vlr::indexType::LINEAR;
+
+	vlr::KMajority bofModel(descriptors, params);
+	bofModel.build();
+	bofModel.save("test_vocab.bin");
+
+	EXPECT_EQ("AKMAJ", vlr::VocabBase::loadVocabType("test_vocab.bin"));
+
+	vlr::KMajority bofModelLoaded;
+	bofModelLoaded.load("test_vocab.bin");
+
+	EXPECT_EQ(bofModel.getCentroids().rows, bofModelLoaded.getCentroids().rows);
+	// The words are searched with the index they were trained with
+	EXPECT_EQ(vlr::LINEAR, bofModelLoaded.getNNType());
+	EXPECT_TRUE(
+			std::equal(bofModel.getCentroids().begin<uchar>(),
+					bofModel.getCentroids().end<uchar>(),
+					bofModelLoaded.getCentroids().begin<uchar>()));
+
+}
+
+static void expectSameAfterResume(vlr::indexType nnType) {
+
+	std::vector<std::string> filenames;
+	filenames.push_back("brief_0.bin");
+	vlr::Mat descriptors(filenames);
+
+	vlr::KMajorityParams params;
+	params["num.clusters"] = 10;
+	params["max.iterations"] = 5;
+	params["nn.type"] = nnType;
+	params["checkpoint.dir"] = std::string(".");
+
+	std::remove("./kmajority.ckpt.bin");
+	cvflann::seed_random(1234);
+	vlr::KMajority bofModel(descriptors, params);
+	bofModel.build();
+
+	// Stop the same build after its second iteration
+	params["max.iterations"] = 2;
+
+	std::remove("./kmajority.ckpt.bin");
+	cvflann::seed_random(1234);
+	vlr::KMajority bofModelStopped(descriptors, params);
+	bofModelStopped.build();
+
+	EXPECT_TRUE(FileUtils::checkFileExist("./kmajority.ckpt.bin"));
+
+	// Finish it from the checkpoint, with another seed
+	params["max.iterations"] = 5;
+	params["checkpoint.resume"] = 1;
+
+	cvflann::seed_random(4321);
+	vlr::KMajority bofModelResumed(descriptors, params);
+	bofModelResumed.build();
+
+	std::remove("./kmajority.ckpt.bin");
+
+	// The resumed build must give the clustering of the uninterrupted one
+	EXPECT_TRUE(
+			std::equal(bofModel.getCentroids().begin<uchar>(),
+					bofModel.getCentroids().end<uchar>(),
+					bofModelResumed.getCentroids().begin<uchar>()));
+	EXPECT_TRUE(
+			bofModel.getClusterAssignments()
+					== bofModelResumed.getClusterAssignments());
+
+}
+
+TEST(KMajority, CheckpointResume) {
+	expectSameAfterResume(vlr::indexType::LINEAR);
+}
+
+TEST(KMajority, CheckpointResumeHierarchical) {
+	// The approximate index may be kept across iterations, the resumed build
+	// must search with the same one
+	expectSameAfterResume(vlr::indexType::HIERARCHICAL);
+}
+
+TEST(KMajority, ResumeWithoutCheckpointDir) {
+
+	std::vector<std::string> filenames;
+	filenames.push_back("brief_0.bin");
+	vlr::Mat descriptors(filenames);
+
+	vlr::KMajorityParams params;
+	params["num.clusters"] = 10;
+	params["checkpoint.resume"] = 1;
+
+	vlr::KMajority bofModel(descriptors, params);
+	EXPECT_THROW(bofModel.build(), std::runtime_error);
+
+}
+
 TEST(KMajority, Regression) {
 
 	std::vector<std::string> filenames;
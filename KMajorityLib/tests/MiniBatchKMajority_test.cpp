@@ -0,0 +1,96 @@
+/*
+ * MiniBatchKMajority_test.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: andresf
+ */
+
+#include <gtest/gtest.h>
+
+#include <KMajority.h>
+#include <MiniBatchKMajority.h>
+
+TEST(MiniBatchKMajority, AccumulateBits) {
+
+	uchar bytes[] = { 0x81, 0x0F };
+	int counts[16] = { 0 };
+
+	vlr::MiniBatchKMajority::accumulateBits(bytes, 2, counts);
+	vlr::MiniBatchKMajority::accumulateBits(bytes, 2, counts);
+
+	// Entry 8 * b + t counts bit t of byte b, from the LSB to the MSB
+	int expected[] = { 2, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 2, 0, 0, 0, 0 };
+	for (int l = 0; l < 16; ++l) {
+		EXPECT_EQ(expected[l], counts[l]);
+	}
+
+}
+
+TEST(MiniBatchKMajority, BuildSaveLoad) {
+
+	std::vector<std::string> filenames;
+	filenames.push_back("brief_0.bin");
+	filenames.push_back("brief_1.bin");
+
+	vlr::MiniBatchKMajorityParams params;
+	params["num.clusters"] = 10;
+	params["batch.size"] = 100;
+	params["max.iterations"] = 5;
+	params["nn.type"] = vlr::indexType::LINEAR;
+
+	vlr::MiniBatchKMajority bofModel(filenames, params);
+	bofModel.build();
+
+	EXPECT_EQ(10u, bofModel.size());
+	EXPECT_GE(bofModel.getNumIterations(), 1);
+	EXPECT_LE(bofModel.getNumIterations(), 5);
+
+	// Saved as an AKMAJ vocabulary
+	bofModel.save("test_mbvocab.yaml.gz");
+
+	EXPECT_EQ(std::string("AKMAJ"),
+			vlr::VocabBase::loadVocabType("test_mbvocab.yaml.gz"));
+
+	vlr::KMajority bofModelLoaded;
+	bofModelLoaded.load("test_mbvocab.yaml.gz");
+
+	EXPECT_TRUE(
+			std::equal(bofModel.getCentroids().begin<uchar>(),
+					bofModel.getCentroids().end<uchar>(),
+					bofModelLoaded.getCentroids().begin<uchar>()));
+
+}
+
+TEST(MiniBatchKMajority, KeepIndex) {
+
+	std::vector<std::string> filenames;
+	filenames.push_back("brief_0.bin");
+	filenames.push_back("brief_1.bin");
+
+	vlr::MiniBatchKMajorityParams params;
+	params["num.clusters"] = 10;
+	// Every batch holds all the descriptors, hence its order does not matter
+	params["batch.size"] = 1000000;
+	params["max.iterations"] = 5;
+	params["nn.type"] = vlr::indexType::HIERARCHICAL;
+	// Rebuild the index for every batch
+	params["index.rebuild.threshold"] = 0;
+
+	cvflann::seed_random(1234);
+	vlr::MiniBatchKMajority rebuilt(filenames, params);
+	rebuilt.build();
+
+	// Never rebuild the index, changed centers are searched linearly
+	params["index.rebuild.threshold"] = 10;
+
+	cvflann::seed_random(1234);
+	vlr::MiniBatchKMajority kept(filenames, params);
+	kept.build();
+
+	// The centers fit in a single leaf, hence both searches are exact
+	EXPECT_EQ(0,
+			cv::countNonZero(rebuilt.getCentroids() != kept.getCentroids()));
+	EXPECT_TRUE(rebuilt.getClusterCounts() == kept.getClusterCounts());
+	EXPECT_EQ(rebuilt.getNumIterations(), kept.getNumIterations());
+
+}
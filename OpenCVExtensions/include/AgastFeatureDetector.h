@@ -16,6 +16,39 @@
 
 namespace cv {
 
+/**
+ * Detects AGAST corners on a single scale of an image.
+ *
+ * @param image - Input image, converted to gray scale if needed
+ * @param keypoints - Vector where the detected keypoints are appended
+ * @param threshold - AGAST threshold
+ * @param nonmaxsuppression - Whether to apply non-maximum suppression
+ * @param type - One of AgastFeatureDetector::AST_PATTERN
+ */
+void AGAST(const Mat& image, std::vector<KeyPoint>& keypoints,
+		const int& threshold, const bool& nonmaxsuppression, const int& type);
+
+/**
+ * Detects AGAST corners on a pyramid of the image. Every level is split into tiles
+ * overlapping by the radius of the corner test plus the suppression window, the tiles
+ * of all levels are detected concurrently and only the corners falling in the
+ * non-overlapping part of a tile are kept, hence tiling does not change the corners
+ * of a level. Keypoints of neighboring levels are then suppressed in favor of the
+ * strongest one and the strongest maxKeypoints are retained.
+ *
+ * @param image - Input image, converted to gray scale if needed
+ * @param keypoints - Vector where the detected keypoints are appended
+ * @param threshold - AGAST threshold
+ * @param nonmaxsuppression - Whether to apply non-maximum suppression
+ * @param type - One of AgastFeatureDetector::AST_PATTERN
+ * @param octaves - Number of pyramid levels
+ * @param tileSize - Side of the tiles, 0 to detect on whole levels
+ * @param maxKeypoints - Maximum number of keypoints, 0 for no limit
+ */
+void PyramidAGAST(const Mat& image, std::vector<KeyPoint>& keypoints,
+		int threshold, bool nonmaxsuppression, int type, int octaves,
+		int tileSize, int maxKeypoints);
+
 class CV_EXPORTS_W AgastFeatureDetector: public FeatureDetector {
 public:
 
@@ -25,12 +58,15 @@ public:
 
 	//! the full constructor
 	AgastFeatureDetector() :
-			threshold(10), type(TYPE_OAST9_16), nonmaxsuppression(true) {
+			threshold(10), type(TYPE_OAST9_16), nonmaxsuppression(true), octaves(
+					1), tileSize(0), maxKeypoints(0) {
 		;
 	}
-	AgastFeatureDetector(int _threshold, int _type, bool _nonmaxsuppression) :
+	AgastFeatureDetector(int _threshold, int _type, bool _nonmaxsuppression,
+			int _octaves = 1, int _tileSize = 0, int _maxKeypoints = 0) :
 			threshold(_threshold), type(_type), nonmaxsuppression(
-					_nonmaxsuppression) {
+					_nonmaxsuppression), octaves(_octaves), tileSize(_tileSize), maxKeypoints(
+					_maxKeypoints) {
 		;
 	}
 	~AgastFeatureDetector() {
@@ -53,6 +89,12 @@ protected:
 	int threshold;
 	int type;
 	bool nonmaxsuppression;
+	// Number of pyramid levels, each one half the size of the previous
+	int octaves;
+	// Side of the square tiles detected concurrently, 0 to detect on whole levels
+	int tileSize;
+	// Number of keypoints with the highest response kept, 0 to keep all
+	int maxKeypoints;
 
 };
 
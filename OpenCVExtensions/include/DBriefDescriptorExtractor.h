@@ -8,12 +8,25 @@
 #ifndef DBRIEFDESCRIPTOREXTRACTOR_H_
 #define DBRIEFDESCRIPTOREXTRACTOR_H_
 
+#include <bitset>
+
 #include <opencv2/features2d/features2d.hpp>
 
 #include <Dbrief/Dbrief.h>
 
 namespace cv {
 
+/**
+ * Packs a D-BRIEF descriptor into bytes, bit j of the bitset goes to bit j % 8 of
+ * byte numBytes - 1 - j / 8.
+ *
+ * @param desc - D-BRIEF descriptor as computed by CVLAB::Dbrief
+ * @param bytes - Output buffer of numBytes bytes
+ * @param numBytes - Size in bytes of the descriptor
+ */
+void packDbriefDescriptor(const std::bitset<CVLAB::DESC_LEN>& desc,
+		unsigned char* bytes, int numBytes);
+
 class DBriefDescriptorExtractor: public cv::DescriptorExtractor {
 public:
 	DBriefDescriptorExtractor();
@@ -7,6 +7,9 @@
 
 #include <AgastFeatureDetector.h>
 
+#include <algorithm>
+#include <cstdlib>
+
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/core/types_c.h>
@@ -31,7 +34,7 @@ void AGAST(const Mat& _img, std::vector<KeyPoint>& keypoints,
 		const int& threshold, const bool& nonmaxsuppression, const int& type) {
 
 	// Obtain detector instance
-	AstDetector* detector;
+	Ptr<AstDetector> detector;
 
 	switch (type) {
 	case AgastFeatureDetector::TYPE_OAST9_16:
@@ -56,6 +59,10 @@ void AGAST(const Mat& _img, std::vector<KeyPoint>& keypoints,
 	if (_img.type() != CV_8U)
 		cvtColor(_img, grayImage, COLOR_BGR2GRAY);
 
+	// The detector walks the image assuming rows are contiguous, e.g. not for a ROI
+	if (grayImage.isContinuous() == false)
+		grayImage = grayImage.clone();
+
 	// Detect keypoints
 	detector->processImage(grayImage.data);
 	vector<CvPoint> corners;
@@ -81,10 +88,206 @@ void AGAST(const Mat& _img, std::vector<KeyPoint>& keypoints,
 
 }
 
+// Overlap between tiles: radius of the largest corner test plus the 3x3 suppression window
+static const int AGAST_TILE_BORDER = 4;
+
+// Size assigned to the keypoints of the first pyramid level
+static const float AGAST_KEYPOINT_SIZE = 7.f;
+
+/**
+ * A tile of a pyramid level, the corners are detected on the padded area
+ * but only those falling in the core area are kept.
+ */
+struct AgastTile {
+	int level;
+	Rect core;
+	Rect padded;
+};
+
+class AgastTileInvoker: public ParallelLoopBody {
+public:
+
+	AgastTileInvoker(const std::vector<Mat>& levels,
+			const std::vector<AgastTile>& tiles,
+			std::vector<std::vector<KeyPoint> >& tileKeypoints, int threshold,
+			bool nonmaxsuppression, int type) :
+			m_levels(levels), m_tiles(tiles), m_tileKeypoints(tileKeypoints), m_threshold(
+					threshold), m_nonmaxsuppression(nonmaxsuppression), m_type(
+					type) {
+	}
+
+	void operator()(const Range& range) const {
+		std::vector<KeyPoint> corners;
+		for (int t = range.start; t < range.end; ++t) {
+			const AgastTile& tile = m_tiles[t];
+			float scale = float(1 << tile.level);
+
+			corners.clear();
+			AGAST(m_levels[tile.level](tile.padded), corners, m_threshold,
+					m_nonmaxsuppression, m_type);
+
+			std::vector<KeyPoint>& keypoints = m_tileKeypoints[t];
+			for (KeyPoint& k : corners) {
+				Point2f pt(k.pt.x + tile.padded.x, k.pt.y + tile.padded.y);
+				if (tile.core.contains(Point(int(pt.x), int(pt.y)))) {
+					// Back to the coordinates of the input image
+					k.pt = Point2f(pt.x * scale, pt.y * scale);
+					k.size = AGAST_KEYPOINT_SIZE * scale;
+					k.octave = tile.level;
+					keypoints.push_back(k);
+				}
+			}
+		}
+	}
+
+private:
+
+	const std::vector<Mat>& m_levels;
+	const std::vector<AgastTile>& m_tiles;
+	std::vector<std::vector<KeyPoint> >& m_tileKeypoints;
+	int m_threshold;
+	bool m_nonmaxsuppression;
+	int m_type;
+
+};
+
+static bool responseGreater(const KeyPoint& k1, const KeyPoint& k2) {
+	return k1.response > k2.response;
+}
+
+/**
+ * Greedy suppression across pyramid levels: keypoints are visited by decreasing
+ * response and one is dropped if a kept keypoint of a neighboring level lies within
+ * half the size of the coarser of the two. Keypoints of the same level were already
+ * suppressed by the detector and are left alone.
+ */
+static void suppressAcrossLevels(std::vector<KeyPoint>& keypoints,
+		int octaves) {
+
+	if (octaves <= 1 || keypoints.empty()) {
+		return;
+	}
+
+	std::stable_sort(keypoints.begin(), keypoints.end(), responseGreater);
+
+	// Grid of cells the size of the largest suppression radius
+	float cellSize = 0.5f * AGAST_KEYPOINT_SIZE * float(1 << (octaves - 1));
+	float maxX = 0, maxY = 0;
+	for (const KeyPoint& k : keypoints) {
+		maxX = std::max(maxX, k.pt.x);
+		maxY = std::max(maxY, k.pt.y);
+	}
+	int gridCols = int(maxX / cellSize) + 1;
+	int gridRows = int(maxY / cellSize) + 1;
+	std::vector<std::vector<int> > grid(gridCols * gridRows);
+
+	std::vector<KeyPoint> kept;
+	kept.reserve(keypoints.size());
+
+	for (const KeyPoint& k : keypoints) {
+		int cx = int(k.pt.x / cellSize), cy = int(k.pt.y / cellSize);
+		bool suppressed = false;
+		for (int y = std::max(cy - 1, 0);
+				y <= std::min(cy + 1, gridRows - 1) && suppressed == false;
+				++y) {
+			for (int x = std::max(cx - 1, 0);
+					x <= std::min(cx + 1, gridCols - 1) && suppressed == false;
+					++x) {
+				for (int idx : grid[y * gridCols + x]) {
+					const KeyPoint& other = kept[idx];
+					if (other.octave == k.octave
+							|| std::abs(other.octave - k.octave) > 1) {
+						continue;
+					}
+					float radius = 0.5f * std::max(other.size, k.size);
+					float dx = other.pt.x - k.pt.x, dy = other.pt.y - k.pt.y;
+					if (dx * dx + dy * dy <= radius * radius) {
+						suppressed = true;
+						break;
+					}
+				}
+			}
+		}
+		if (suppressed == false) {
+			grid[cy * gridCols + cx].push_back(int(kept.size()));
+			kept.push_back(k);
+		}
+	}
+
+	keypoints.swap(kept);
+}
+
+void PyramidAGAST(const Mat& image, std::vector<KeyPoint>& keypoints,
+		int threshold, bool nonmaxsuppression, int type, int octaves,
+		int tileSize, int maxKeypoints) {
+
+	CV_Assert(octaves >= 1 && tileSize >= 0 && maxKeypoints >= 0);
+
+	// Build the pyramid, levels too small to hold a corner are dropped
+	std::vector<Mat> levels(1);
+	if (image.type() != CV_8U)
+		cvtColor(image, levels[0], COLOR_BGR2GRAY);
+	else
+		levels[0] = image;
+
+	for (int l = 1; l < octaves; ++l) {
+		if (levels.back().cols < 4 * AGAST_TILE_BORDER
+				|| levels.back().rows < 4 * AGAST_TILE_BORDER) {
+			break;
+		}
+		Mat next;
+		pyrDown(levels.back(), next);
+		levels.push_back(next);
+	}
+
+	// Split every level into tiles overlapping by AGAST_TILE_BORDER
+	std::vector<AgastTile> tiles;
+	for (int l = 0; l < (int) levels.size(); ++l) {
+		Rect bounds(0, 0, levels[l].cols, levels[l].rows);
+		int side = tileSize > 0 ? tileSize : std::max(bounds.width, bounds.height);
+		for (int y = 0; y < bounds.height; y += side) {
+			for (int x = 0; x < bounds.width; x += side) {
+				AgastTile tile;
+				tile.level = l;
+				tile.core = Rect(x, y, side, side) & bounds;
+				tile.padded = Rect(x - AGAST_TILE_BORDER, y - AGAST_TILE_BORDER,
+						side + 2 * AGAST_TILE_BORDER,
+						side + 2 * AGAST_TILE_BORDER) & bounds;
+				tiles.push_back(tile);
+			}
+		}
+	}
+
+	std::vector<std::vector<KeyPoint> > tileKeypoints(tiles.size());
+	parallel_for_(Range(0, (int) tiles.size()),
+			AgastTileInvoker(levels, tiles, tileKeypoints, threshold,
+					nonmaxsuppression, type));
+
+	// Merge in tile order so that the output does not depend on the scheduling
+	std::vector<KeyPoint> merged;
+	for (std::vector<KeyPoint>& k : tileKeypoints) {
+		merged.insert(merged.end(), k.begin(), k.end());
+	}
+
+	suppressAcrossLevels(merged, (int) levels.size());
+
+	if (maxKeypoints > 0) {
+		KeyPointsFilter::retainBest(merged, maxKeypoints);
+	}
+
+	keypoints.insert(keypoints.end(), merged.begin(), merged.end());
+}
+
 void AgastFeatureDetector::operator ()(const Mat& image,
 		std::vector<KeyPoint>& keypoints) const {
-	AGAST(image, keypoints, this->threshold, this->nonmaxsuppression,
-			this->type);
+	if (this->octaves <= 1 && this->tileSize <= 0 && this->maxKeypoints <= 0) {
+		AGAST(image, keypoints, this->threshold, this->nonmaxsuppression,
+				this->type);
+	} else {
+		PyramidAGAST(image, keypoints, this->threshold, this->nonmaxsuppression,
+				this->type, std::max(this->octaves, 1),
+				std::max(this->tileSize, 0), std::max(this->maxKeypoints, 0));
+	}
 }
 
 void AgastFeatureDetector::detectImpl(const Mat& image,
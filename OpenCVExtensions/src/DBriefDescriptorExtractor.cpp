@@ -6,11 +6,34 @@
  */
 
 #include <DBriefDescriptorExtractor.h>
+#include <algorithm>
 #include <iostream>
 #include <string>
 
 namespace cv {
 
+void packDbriefDescriptor(const std::bitset<CVLAB::DESC_LEN>& desc,
+		unsigned char* bytes, int numBytes) {
+
+	if (CVLAB::DESC_LEN <= 8 * (int) sizeof(unsigned long long)) {
+		// Short descriptors fit a machine word, peel it off byte by byte
+		unsigned long long bits = desc.to_ullong();
+		for (int b = numBytes - 1; b >= 0; --b, bits >>= 8) {
+			bytes[b] = (unsigned char) (bits & 0xFF);
+		}
+	} else {
+		for (int b = 0; b < numBytes; ++b) {
+			int first = (numBytes - 1 - b) * 8;
+			unsigned char byte = 0;
+			for (int k = 0; k < 8 && first + k < (int) desc.size(); ++k) {
+				byte |= (unsigned char) (desc.test(first + k) << k);
+			}
+			bytes[b] = byte;
+		}
+	}
+
+}
+
 void DBrief(const Mat& image, vector<KeyPoint>& keypoints, Mat& descriptors,
 		const int& size, const int& type) {
 
@@ -28,22 +51,18 @@ void DBrief(const Mat& image, vector<KeyPoint>& keypoints, Mat& descriptors,
 	dbrief.getDbriefDescriptors(descs, keypoints, &ipl_grayImage);
 
 	descriptors.create((int) keypoints.size(), size, type);
-	// Initializing matrix with zeros
-	std::fill_n(descriptors.data, descriptors.rows * descriptors.cols, 0);
 
+	// Bit j of a bitset goes to bit j % 8 of byte (cols - 1 - j / 8), i.e. the
+	// bytes are the big-endian representation of the bitset value, so every
+	// byte is written at once instead of accumulating it bit by bit
 	for (int i = 0; i < (int) descs.size(); i++) {
-		bitset<CVLAB::DESC_LEN> desc = descs[i];
-		//printf("String formatted: %s\n", desc.to_string<char, char_traits<char>, allocator<char> >().c_str());
-
-		// Doing a reverse loop because the most significant bit on a bitset is the last element
-		// e.g. 1100 is stored as 0011
-		for (int j = (int) desc.size() - 1; j >= 0; j--) {
-			// Incrementally composing descriptor by
-			// splitting the 32 length bitset in chunks of 8 bits (1 byte)
-			// and converting it into its uint representation
-			descriptors.at<unsigned char>(i, descriptors.cols - 1 - (int) j / 8) +=
-					(desc.test(j) << (j % 8));
-		}
+		packDbriefDescriptor(descs[i], descriptors.ptr<unsigned char>(i),
+				descriptors.cols);
+	}
+
+	// Rows without a computed descriptor are left to zero
+	for (int i = (int) descs.size(); i < descriptors.rows; i++) {
+		std::fill_n(descriptors.ptr<unsigned char>(i), descriptors.cols, 0);
 	}
 
 }
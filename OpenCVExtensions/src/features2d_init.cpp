@@ -12,7 +12,7 @@
 namespace cv {
 
 CV_INIT_ALGORITHM(AgastFeatureDetector, "Feature2D.AGAST",
-		obj.info()->addParam(obj, "threshold", obj.threshold); obj.info()->addParam(obj, "nonmaxsuppression", obj.nonmaxsuppression); obj.info()->addParam(obj, "type", obj.type))
+		obj.info()->addParam(obj, "threshold", obj.threshold); obj.info()->addParam(obj, "nonmaxsuppression", obj.nonmaxsuppression); obj.info()->addParam(obj, "type", obj.type); obj.info()->addParam(obj, "octaves", obj.octaves); obj.info()->addParam(obj, "tileSize", obj.tileSize); obj.info()->addParam(obj, "maxKeypoints", obj.maxKeypoints))
 ;
 
 CV_INIT_ALGORITHM(DBriefDescriptorExtractor, "Feature2D.DBRIEF", obj.info())
@@ -7,6 +7,8 @@
 
 #include <AgastFeatureDetector.h>
 
+#include <algorithm>
+
 #include <gtest/gtest.h>
 #include <opencv2/extensions/features2d.hpp>
 #include <opencv2/features2d/features2d.hpp>
@@ -49,3 +51,61 @@ TEST(AgastFeatureDetector, Detect) {
 	ASSERT_TRUE(keypoints.size() != 0);
 
 }
+
+static bool keypointPositionLess(const cv::KeyPoint& k1,
+		const cv::KeyPoint& k2) {
+	return k1.pt.y < k2.pt.y || (k1.pt.y == k2.pt.y && k1.pt.x < k2.pt.x);
+}
+
+TEST(AgastFeatureDetector, Tiles) {
+
+	cv::Mat img = cv::imread("test.jpg", CV_LOAD_IMAGE_GRAYSCALE);
+
+	cv::Ptr<cv::FeatureDetector> detector = cv::FeatureDetector::create(
+			"AGAST");
+
+	std::vector<cv::KeyPoint> keypoints, tiledKeypoints;
+	detector->detect(img, keypoints);
+
+	// Tiling a single level must not change the detected corners
+	detector->set("tileSize", 64);
+	detector->detect(img, tiledKeypoints);
+
+	ASSERT_EQ(keypoints.size(), tiledKeypoints.size());
+
+	std::sort(keypoints.begin(), keypoints.end(), keypointPositionLess);
+	std::sort(tiledKeypoints.begin(), tiledKeypoints.end(),
+			keypointPositionLess);
+
+	for (size_t i = 0; i < keypoints.size(); ++i) {
+		EXPECT_EQ(keypoints[i].pt.x, tiledKeypoints[i].pt.x);
+		EXPECT_EQ(keypoints[i].pt.y, tiledKeypoints[i].pt.y);
+		EXPECT_EQ(keypoints[i].response, tiledKeypoints[i].response);
+	}
+
+}
+
+TEST(AgastFeatureDetector, Pyramid) {
+
+	cv::Mat img = cv::imread("test.jpg", CV_LOAD_IMAGE_GRAYSCALE);
+
+	cv::Ptr<cv::FeatureDetector> detector = cv::FeatureDetector::create(
+			"AGAST");
+	detector->set("octaves", 3);
+	detector->set("tileSize", 128);
+	detector->set("maxKeypoints", 500);
+
+	std::vector<cv::KeyPoint> keypoints;
+	detector->detect(img, keypoints);
+
+	ASSERT_TRUE(keypoints.size() != 0);
+	ASSERT_TRUE(keypoints.size() <= 500);
+
+	for (cv::KeyPoint& k : keypoints) {
+		EXPECT_TRUE(k.octave >= 0 && k.octave < 3);
+		EXPECT_FLOAT_EQ(7.f * (1 << k.octave), k.size);
+		EXPECT_TRUE(k.pt.x >= 0 && k.pt.x < img.cols);
+		EXPECT_TRUE(k.pt.y >= 0 && k.pt.y < img.rows);
+	}
+
+}
@@ -52,3 +52,40 @@ TEST(DBriefFeatureExtractor,Extract) {
 	ASSERT_FALSE(descriptors.empty());
 
 }
+
+TEST(DBriefFeatureExtractor, PackedBytes) {
+
+	cv::Mat img = cv::imread("test.jpg", CV_LOAD_IMAGE_GRAYSCALE);
+
+	cv::Ptr<cv::FeatureDetector> detector = cv::FeatureDetector::create("FAST");
+
+	std::vector<cv::KeyPoint> keypoints;
+	detector->detect(img, keypoints);
+
+	cv::Ptr<cv::DescriptorExtractor> extractor =
+			cv::DescriptorExtractor::create("DBRIEF");
+
+	cv::Mat descriptors;
+	extractor->compute(img, keypoints, descriptors);
+
+	// Reference descriptors packed bit by bit from the raw bitsets
+	CVLAB::Dbrief dbrief;
+	IplImage ipl_img = img;
+	std::vector<std::bitset<CVLAB::DESC_LEN> > descs;
+	dbrief.getDbriefDescriptors(descs, keypoints, &ipl_img);
+
+	ASSERT_EQ((int) descs.size(), descriptors.rows);
+	ASSERT_EQ(CVLAB::DESC_LEN / 8, descriptors.cols);
+
+	for (int i = 0; i < descriptors.rows; i++) {
+		std::vector<unsigned char> expected(descriptors.cols, 0);
+		for (int j = (int) descs[i].size() - 1; j >= 0; j--) {
+			expected[descriptors.cols - 1 - j / 8] += (descs[i].test(j)
+					<< (j % 8));
+		}
+		for (int b = 0; b < descriptors.cols; b++) {
+			EXPECT_EQ(expected[b], descriptors.at<unsigned char>(i, b));
+		}
+	}
+
+}
@@ -0,0 +1,343 @@
+/*
+ * RetrievalPipeline.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: andresf
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include <VocabDB.hpp>
+
+#include <BoundedQueue.hpp>
+#include <FileUtils.hpp>
+#include <FunctionUtils.hpp>
+
+#include <CandidateVerifier.hpp>
+#include <matching.hpp>
+
+double mytime;
+
+/**
+ * A query scored against the database, handed from the scoring to the verification stage.
+ */
+struct ScoredQuery {
+	// Position of the query in the list of queries
+	size_t index;
+	// Base name of the query image
+	std::string base;
+	// Already loaded query features
+	std::vector<cv::KeyPoint> keypoints;
+	cv::Mat descriptors;
+	// Ids of the database images sorted by decreasing score
+	std::vector<int> ranking;
+};
+
+// Scoring stage
+//	 - For each query
+//		 - Load its keys and descriptors
+//		 - Score its BoF vector against the database
+//		 - Push the ranked image ids and the loaded features into the queue
+// Verification stage
+//	 - For each scored query popped from the queue
+//		 - Verify its top ranked candidates
+//		 - Re-order the top candidates by number of inliers and save the ranked list
+
+int main(int argc, char **argv) {
+
+	if (argc < 9 || (argc > 9 && std::string(argv[9]).compare("-opts") != 0)) {
+		printf(
+				"\nUsage:\n\t"
+						"RetrievalPipeline <in.vocab> <in.inverted.index> <in.db.desc.list> <in.db.keypoints.folder>"
+						" <in.queries.list> <in.queries.keypoints.folder> <out.ranked.files.folder> <in.top.candidates>"
+						" [-opts <key>=<value>]\n\n"
+						"Scoring options:\n"
+						"\tnorm=L2\t\t\tscoring=COS\n"
+						"\tnn.index=nn_index.bin\tbof.folder=\n\n"
+						"Pipeline options:\n"
+						"\tqueue.size=4\t\tkeys.extension=.yaml.gz\n\n"
+						"Matching options:\n"
+						"\ttop.keypoints=500\tratio.thr=0.8\n"
+						"\tdistance.thr=90\t\tmin.matches=8\n"
+						"\transac.thr=10\n\n");
+		VerificationParams::printUsage();
+		printf("Ranked lists:\n"
+				"\tThe re-ranked lists are saved to out.ranked.files.folder, the lists ranked by\n"
+				"\tBoF score alone are only saved when bof.folder is given\n\n");
+		return EXIT_FAILURE;
+	}
+
+	std::string in_vocab = argv[1];
+	std::string in_inverted_index = argv[2];
+	std::string in_db_desc_list = argv[3];
+	std::string in_db_keys_folder = argv[4];
+	std::string in_queries_desc_list = argv[5];
+	std::string in_queries_keys_folder = argv[6];
+	std::string out_ranked_files_folder = argv[7];
+	int topCandidates = atoi(argv[8]);
+
+	std::string in_norm = "L2";
+	std::string in_scoring = "COS";
+	std::string in_nn_index = "nn_index.bin";
+	std::string out_bof_folder;
+	int queueSize = 4;
+	std::string keysExtension = ".yaml.gz";
+
+	VerificationParams params;
+	params.visualizeFolder = out_ranked_files_folder;
+
+	for (int var = 10; var < argc; ++var) {
+		std::string arg = argv[var];
+		size_t delimPos = arg.find("=");
+		CV_Assert(delimPos != std::string::npos);
+		std::string key = arg.substr(0, delimPos);
+		std::string value = arg.substr(delimPos + 1, arg.length());
+		if (key.compare("norm") == 0) {
+			in_norm = value;
+		} else if (key.compare("scoring") == 0) {
+			in_scoring = value;
+		} else if (key.compare("nn.index") == 0) {
+			in_nn_index = value;
+		} else if (key.compare("bof.folder") == 0) {
+			out_bof_folder = value;
+		} else if (key.compare("queue.size") == 0) {
+			queueSize = atoi(value.c_str());
+		} else if (key.compare("keys.extension") == 0) {
+			keysExtension = value;
+		} else if (key.compare("top.keypoints") == 0) {
+			params.topKeypoints = atoi(value.c_str());
+		} else if (key.compare("ratio.thr") == 0) {
+			params.ratioThreshold = atof(value.c_str());
+		} else if (key.compare("distance.thr") == 0) {
+			params.distanceThreshold = atof(value.c_str());
+		} else if (key.compare("min.matches") == 0) {
+			params.minMatches = atoi(value.c_str());
+		} else if (key.compare("ransac.thr") == 0) {
+			params.ransacThreshold = atof(value.c_str());
+		} else {
+			try {
+				if (params.set(key, value) == false) {
+					fprintf(stderr, "Unknown option [%s]\n", key.c_str());
+					return EXIT_FAILURE;
+				}
+			} catch (const std::runtime_error& error) {
+				fprintf(stderr, "%s\n", error.what());
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	if (queueSize <= 0) {
+		fprintf(stderr, "Queue size must be positive\n");
+		return EXIT_FAILURE;
+	}
+
+	// Step 1/4: load vocabulary + inverted index
+	cv::Ptr<vlr::VocabDB> db;
+
+	std::string in_type = vlr::VocabBase::loadVocabType(in_vocab);
+
+	if (in_type.compare("HKM") == 0) {
+		// Instantiate a DB supported by a HKM vocabulary
+		db = new vlr::HKMDB(false);
+	} else if (in_type.compare("HKMAJ") == 0) {
+		// Instantiate a DB supported by a HKMaj vocabulary
+		db = new vlr::HKMDB(true);
+	} else {
+		// Instantiate a DB supported by a AKMaj vocabulary
+		db = new vlr::AKMajDB();
+	}
+
+	printf("-- Loading vocabulary from [%s]\n", in_vocab.c_str());
+
+	mytime = cv::getTickCount();
+	db->loadBoFModel(in_vocab);
+	mytime = ((double) cv::getTickCount() - mytime) / cv::getTickFrequency()
+			* 1000;
+	printf("   Vocabulary loaded in [%lf] ms, got [%lu] words \n", mytime,
+			db->getNumOfWords());
+
+	// Load nearest neighbor index when scoring using an AKMaj vocabulary
+	if (in_type.compare("HKM") != 0 && in_type.compare("HKMAJ") != 0) {
+		printf("-- Loading nearest neighbors index from [%s]\n",
+				in_nn_index.c_str());
+		((cv::Ptr<vlr::AKMajDB>) db)->loadNNIndex(in_nn_index);
+	}
+
+	printf("-- Loading inverted index [%s]\n", in_inverted_index.c_str());
+	db->loadInvertedIndex(in_inverted_index);
+
+	// Step 2/4: load names of database and query files
+	printf("-- Loading names of database files\n");
+	std::vector<std::string> db_desc_list;
+	FileUtils::loadList(in_db_desc_list, db_desc_list);
+	printf("   Loaded, got [%lu] entries\n", db_desc_list.size());
+
+	printf("-- Loading list of queries descriptors\n");
+	std::vector<FileUtils::Query> query_filenames;
+	FileUtils::loadQueriesList(in_queries_desc_list, query_filenames);
+	printf("   Loaded, got [%lu] entries\n", query_filenames.size());
+
+	vlr::NormType norm = in_norm.compare("L2") == 0 ? vlr::NORM_L2 :
+			vlr::NORM_L1;
+
+	vlr::ScoringType distance = vlr::COS;
+	if (in_scoring.compare("L1") == 0) {
+		distance = vlr::L1;
+	} else if (in_scoring.compare("L2") == 0) {
+		distance = vlr::L2;
+	}
+
+	printf("-- Scoring and verifying [%lu] queries against [%d] database "
+			"images, topCandidates=[%d] queue.size=[%d]\n",
+			query_filenames.size(), db->getInvertedIndex()->m_numDbImages,
+			topCandidates, queueSize);
+	params.print();
+
+	// Step 3/4: scoring stage, runs concurrently with the verification
+	BoundedQueue<ScoredQuery> queue(queueSize);
+	std::string scoringError;
+	bool is_binary = in_type.compare("HKM") != 0;
+
+	std::thread scoring([&]() {
+		try {
+			cv::Mat scores, perm;
+			for (size_t i = 0; i < query_filenames.size(); ++i) {
+				ScoredQuery query;
+				query.index = i;
+				query.base = FunctionUtils::basify(query_filenames[i].name);
+
+				FileUtils::loadDescriptors(query_filenames[i].name,
+						query.descriptors);
+				FileUtils::loadKeypoints(
+						in_queries_keys_folder + "/" + query.base + keysExtension,
+						query.keypoints);
+
+				if (query.descriptors.empty() == false) {
+					if ((query.descriptors.type() == CV_8U) != is_binary) {
+						throw std::runtime_error("Descriptor type of query ["
+								+ query.base + "] does not coincide "
+								"with the vocabulary type");
+					}
+
+					db->scoreQuery(query.descriptors, scores, norm, distance);
+
+					// Note: recall that the index of the images in the inverted file corresponds
+					// to the zero-based line number in the file used to build the database.
+					cv::sortIdx(scores, perm,
+							cv::SORT_EVERY_ROW + cv::SORT_DESCENDING);
+					query.ranking.assign(perm.ptr<int>(0),
+							perm.ptr<int>(0) + perm.cols);
+				}
+
+				if (out_bof_folder.empty() == false) {
+					std::vector<std::string> ranked_list;
+					for (int id : query.ranking) {
+						ranked_list.push_back(
+								FunctionUtils::basify(db_desc_list[id]));
+					}
+					std::stringstream ranked_list_fname;
+					ranked_list_fname << out_bof_folder << "/query_" << i
+							<< "_ranked.txt";
+					FileUtils::saveList(ranked_list_fname.str(), ranked_list);
+				}
+
+				queue.push(std::move(query));
+			}
+		} catch (const std::exception& error) {
+			scoringError = error.what();
+		}
+		queue.close();
+	});
+
+	// Step 4/4: verification stage
+	CandidateVerifier verifier(params);
+
+	ScoredQuery query;
+	std::vector<cv::KeyPoint> candidateKeypoints;
+	cv::Mat candidateDescriptors;
+	std::vector<int> candidates_inliers;
+	std::vector<size_t> candidates_inliers_idx;
+	std::vector<std::string> geom_ranked_candidates_list;
+
+	int status = EXIT_SUCCESS;
+
+	while (queue.pop(query)) {
+		printf("-- Verifying query [%lu] - [%s]\n", query.index,
+				query.base.c_str());
+
+		mytime = cv::getTickCount();
+
+		int top = MIN(int(query.ranking.size()), topCandidates);
+
+		candidates_inliers.clear();
+		candidates_inliers.resize(top, 0);
+
+		try {
+			verifier.setQuery(query.base, query.keypoints, query.descriptors);
+
+			for (int j = 0; j < top; ++j) {
+				const std::string& candidateName =
+						db_desc_list[query.ranking[j]];
+				std::string candidateBase = FunctionUtils::basify(
+						candidateName);
+
+				FileUtils::loadKeypoints(
+						in_db_keys_folder + "/" + candidateBase + keysExtension,
+						candidateKeypoints);
+				FileUtils::loadDescriptors(candidateName, candidateDescriptors);
+
+				candidates_inliers[j] = verifier.verify(candidateBase,
+						candidateKeypoints, candidateDescriptors);
+			}
+		} catch (const std::exception& error) {
+			fprintf(stderr, "%s\n", error.what());
+			status = EXIT_FAILURE;
+			break;
+		}
+
+		// Re-order top candidates by their number of inliers, the rest keep the BoF order
+		sortAndKeepIdx(candidates_inliers, candidates_inliers_idx,
+				CV_SORT_DESCENDING);
+
+		geom_ranked_candidates_list.clear();
+		for (int j = 0; j < int(query.ranking.size()); ++j) {
+			int id = j < top ?
+					query.ranking[candidates_inliers_idx[j]] :
+					query.ranking[j];
+			geom_ranked_candidates_list.push_back(
+					FunctionUtils::basify(db_desc_list[id]));
+		}
+
+		std::stringstream ranked_list_fname;
+		ranked_list_fname << out_ranked_files_folder << "/query_"
+				<< query.index << "_ranked.txt";
+		FileUtils::saveList(ranked_list_fname.str(),
+				geom_ranked_candidates_list);
+
+		mytime = ((double) cv::getTickCount() - mytime)
+				/ cv::getTickFrequency() * 1000;
+
+		printf("   Done, re-ranked top [%d] candidates out of [%lu] in [%lf] ms\n",
+				top, geom_ranked_candidates_list.size(), mytime);
+	}
+
+	// Unblock the scoring stage if verification stopped early
+	queue.close();
+	scoring.join();
+
+	if (scoringError.empty() == false) {
+		fprintf(stderr, "%s\n", scoringError.c_str());
+		status = EXIT_FAILURE;
+	}
+
+	return status;
+}
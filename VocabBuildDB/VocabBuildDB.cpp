@@ -18,6 +18,7 @@
 #include <VocabTree.h>
 #include <VocabDB.hpp>
 
+#include <BinaryVocabFile.hpp>
 #include <FileUtils.hpp>
 
 double mytime;
@@ -59,9 +60,11 @@ int main(int argc, char **argv) {
 
 	boost::regex expression("^(.+)(\\.)(yaml|xml)(\\.)(gz)$");
 
-	if (boost::regex_match(in_vocab, expression) == false) {
+	if (boost::regex_match(in_vocab, expression) == false
+			&& BinaryVocabFile::isBinaryVocab(in_vocab) == false) {
 		fprintf(stderr,
-				"Input vocabulary file must have the extension .yaml.gz or .xml.gz\n");
+				"Input vocabulary file must have the extension .yaml.gz or .xml.gz"
+						" or be a binary vocabulary\n");
 		return EXIT_FAILURE;
 	}
 
@@ -18,10 +18,12 @@
 #include <opencv2/legacy/legacy.hpp>
 #include <opencv2/nonfree/nonfree.hpp>
 
+#include <BinaryVocabFile.hpp>
 #include <FileUtils.hpp>
 #include <FunctionUtils.hpp>
 #include <IncrementalKMeans.hpp>
 #include <KMajority.h>
+#include <MiniBatchKMajority.h>
 #include <VocabBase.hpp>
 #include <VocabTree.h>
 
@@ -31,34 +33,56 @@ double mytime;
 
 int main(int argc, char **argv) {
 
-	if (argc < 4 || argc == 5
-			|| (argc > 5 && std::string(argv[4]).compare("-opts") != 0)) {
+	// Continue from the last checkpoint
+	bool resume = argc > 4 && std::string(argv[4]).compare("-resume") == 0;
+	// Position of the -opts flag
+	int optsIdx = resume ? 5 : 4;
+
+	if (argc < 4 || argc == optsIdx + 1
+			|| (argc > optsIdx + 1
+					&& std::string(argv[optsIdx]).compare("-opts") != 0)) {
 		printf(
 				"\nUsage:\n"
-						"\tVocabLearn <in.training.images.list> <in.vocab.type> <out.vocab> [-opts <key>=<value>]\n\n"
+						"\tVocabLearn <in.training.images.list> <in.vocab.type> <out.vocab> [-resume] [-opts <key>=<value>]\n\n"
+						"\t-resume: continue from the checkpoint in checkpoint.dir (HKM and HKMAJ in memory, AKMAJ)\n\n"
 						"Vocabulary type:\n"
 						"\tHKM: Hierarchical K-Means\n"
 						"\tHKMAJ: Hierarchical K-Majority\n"
 						"\tAKM: Approximate K-Means (Not yet supported)\n"
 						"\tAKMAJ: Approximate K-Majority\n"
+						"\tMBKMAJ: Mini-Batch K-Majority, trained out-of-core and saved as AKMAJ\n"
 						"\tIKM: Incremental K-Means\n\n"
 						"HKM and HKMAJ options:\n"
 						"\tdepth=6\t\t\tbranch.factor=10\n"
-						"\tmax.iterations=10\tcenters.init.method=RANDOM\n\n"
+						"\tmax.iterations=10\tcenters.init.method=RANDOM\n"
+						"\tbounds.pruning=0 (HKMAJ only)\tout.of.core=0\n\n"
 						"AKMAJ options:\n"
 						"\tnum.clusters=1000000\t\tmax.iterations=10\n"
 						"\tcenters.init.method=RANDOM\tnn.type=HIERARCHICAL\n"
 						"\ttrees.number=4\t\t\ttrees.branch.factor=32\n"
-						"\ttrees.max.leaf.size=100\t\ttrees.number.checks=32\n\n"
+						"\ttrees.max.leaf.size=100\t\ttrees.number.checks=32\n"
+						"\tnum.threads=0\t\t\tindex.rebuild.threshold=-1\n"
+						"\tbounds.pruning=0 (LINEAR only)\n\n"
+						"HKM, HKMAJ and AKMAJ checkpoint options:\n"
+						"\tcheckpoint.dir=\n"
+						"\tcheckpoint.every=50000000 descriptors (HKM, HKMAJ), 1 iteration (AKMAJ)\n"
+						"\tcheckpoint.stop.after=0 (HKM, HKMAJ)\n\n"
+						"MBKMAJ options:\n"
+						"\tnum.clusters=1000000\t\tbatch.size=100000\n"
+						"\tmax.iterations=100\t\ttolerance=0.0001\n"
+						"\tnn.type=HIERARCHICAL\t\ttrees.*\n"
+						"\tindex.rebuild.threshold=-1\n\n"
 						"IKM options:\n"
-						"\tnum.clusters=1000000\n\n"
+						"\tnum.clusters=1000000\t\tnum.threads=0\n\n"
 						"Centers initialization algorithms:\n"
 						"\tRANDOM: in a random manner\n"
 						"\tKMEANSPP: using k-means++ by Arthur and Vassilvitskii\n"
-						"\tGONZALEZ: using Gonzalez algorithm\n\n"
+						"\tGONZALEZ: using Gonzalez algorithm\n"
+						"\tKMEANSPARALLEL: using k-means|| by Bahmani et al.\n\n"
 						"Nearest Neighbors index type:\n"
 						"\tLINEAR:\n"
-						"\tHIERARCHICAL:\n\n"
+						"\tHIERARCHICAL:\n"
+						"\tHCTREE: forest of randomized clustering trees, uses trees.*\n\n"
 				// Centers are spaced apart from each other
 				);
 		return EXIT_FAILURE;
@@ -68,10 +92,19 @@ int main(int argc, char **argv) {
 	std::string in_vocab_type = argv[2];
 	std::string out_vocab = argv[3];
 
-	if (out_vocab.substr(out_vocab.length() - 8, out_vocab.length()).compare(
-			".yaml.gz") != 0) {
+	// Flat vocabularies can also be saved in the memory mapped binary format
+	bool binaryVocab = BinaryVocabFile::hasBinaryExtension(out_vocab)
+			&& (in_vocab_type.compare("AKMAJ") == 0
+					|| in_vocab_type.compare("MBKMAJ") == 0
+					|| in_vocab_type.compare("IKM") == 0);
+
+	if (binaryVocab == false
+			&& (out_vocab.length() < 8
+					|| out_vocab.substr(out_vocab.length() - 8).compare(
+							".yaml.gz") != 0)) {
 		fprintf(stderr,
-				"Output file containing vocabulary must have the extension .yaml.gz\n");
+				"Output file containing vocabulary must have the extension .yaml.gz"
+						" (or .bin for AKMAJ, MBKMAJ and IKM)\n");
 		return EXIT_FAILURE;
 	}
 
@@ -83,16 +116,23 @@ int main(int argc, char **argv) {
 	} else if (in_vocab_type.compare("AKMAJ") == 0) {
 		vocabParams = vlr::KMajorityParams();
 		nnIndexParams = cvflann::IndexParams();
+	} else if (in_vocab_type.compare("MBKMAJ") == 0) {
+		vocabParams = vlr::MiniBatchKMajorityParams();
+		nnIndexParams = cvflann::IndexParams();
 	} else if (in_vocab_type.compare("IKM") == 0) {
 		vocabParams = vlr::IncrementalKMeansParams();
 	} else {
-		fprintf(stderr, "Invalid vocabulary type, choose among HKM, HKMAJ or AKMAJ\n");
+		fprintf(stderr, "Invalid vocabulary type, choose among HKM, HKMAJ, AKMAJ, MBKMAJ or IKM\n");
 		return EXIT_FAILURE;
 	}
 
+	if (resume) {
+		vocabParams["checkpoint.resume"] = 1;
+	}
+
 	// Generalize arguments to any vocabulary
-	if (argc >= 5) {
-		for (int var = 5; var < argc; ++var) {
+	if (argc > optsIdx) {
+		for (int var = optsIdx + 1; var < argc; ++var) {
 			std::string arg = argv[var];
 			size_t delimPos = arg.find("=");
 			CV_Assert(delimPos != std::string::npos);
@@ -105,12 +145,16 @@ int main(int argc, char **argv) {
 					centersInitMethod = cvflann::FLANN_CENTERS_KMEANSPP;
 				} else if (value.compare("GONZALEZ") == 0) {
 					centersInitMethod = cvflann::FLANN_CENTERS_GONZALES;
+				} else if (value.compare("KMEANSPARALLEL") == 0) {
+					centersInitMethod = vlr::CENTERS_KMEANSPARALLEL;
 				}
 				vocabParams[key] = centersInitMethod;
 			} else if (key.compare("nn.type") == 0) {
 				vlr::indexType nnMethod = vlr::HIERARCHICAL;
 				if (value.compare("LINEAR") == 0) {
 					nnMethod = vlr::LINEAR;
+				} else if (value.compare("HCTREE") == 0) {
+					nnMethod = vlr::HCTREE;
 				}
 				vocabParams[key] = nnMethod;
 			} else if (key.substr(0, 6).compare("trees.") == 0) {
@@ -125,6 +169,10 @@ int main(int argc, char **argv) {
 					nnIndexParam = "checks";
 				}
 				nnIndexParams[nnIndexParam] = atoi(value.c_str());
+			} else if (key.compare("tolerance") == 0) {
+				vocabParams[key] = atof(value.c_str());
+			} else if (key.compare("checkpoint.dir") == 0) {
+				vocabParams[key] = value;
 			} else {
 				vocabParams[key] = atoi(value.c_str());
 			}
@@ -137,14 +185,41 @@ int main(int argc, char **argv) {
 	FileUtils::loadList(in_train_list, descriptorsFilenames);
 	printf("   Loaded, got [%lu] entries\n", descriptorsFilenames.size());
 
+	// Mini-batch training and level-wise trees stream the descriptor files themselves
+	bool outOfCore = in_vocab_type.compare("MBKMAJ") == 0
+			|| ((in_vocab_type.compare("HKM") == 0
+					|| in_vocab_type.compare("HKMAJ") == 0)
+					&& cvflann::get_param(vocabParams, "out.of.core", 0) != 0);
+
+	// Only the in memory trees and k-majority write checkpoints
+	if (resume
+			&& (outOfCore || in_vocab_type.compare("MBKMAJ") == 0
+					|| in_vocab_type.compare("IKM") == 0)) {
+		fprintf(stderr, "Option -resume is only supported by HKM and HKMAJ"
+				" in memory, and by AKMAJ\n");
+		return EXIT_FAILURE;
+	}
+
+	// Without a directory there is nothing to resume from, the build would start over
+	if (resume
+			&& cvflann::get_param<std::string>(vocabParams, "checkpoint.dir",
+					std::string()).empty()) {
+		fprintf(stderr, "Option -resume requires checkpoint.dir\n");
+		return EXIT_FAILURE;
+	}
+
 	// Step 2: setup data-set
-	printf("-- Initializing dynamic descriptors matrix\n");
-	vlr::Mat dataset(descriptorsFilenames);
-	printf("   Initialized, got [%d] descriptors\n", dataset.rows);
+	vlr::Mat dataset;
+	if (outOfCore == false) {
+		printf("-- Initializing dynamic descriptors matrix\n");
+		dataset = vlr::Mat(descriptorsFilenames);
+		printf("   Initialized, got [%d] descriptors\n", dataset.rows);
+	}
 
 	// Step 3: check vocabulary type and data type agree
-	if (in_vocab_type.compare("HKM") == 0 ?
-			dataset.type() != CV_32F : dataset.type() != CV_8U) {
+	if (outOfCore == false
+			&& (in_vocab_type.compare("HKM") == 0 ?
+					dataset.type() != CV_32F : dataset.type() != CV_8U)) {
 		fprintf(stderr, "Vocabulary type does not coincide with data type\n");
 		return EXIT_FAILURE;
 	}
@@ -152,17 +227,29 @@ int main(int argc, char **argv) {
 	// Step 4: build vocabulary
 	cv::Ptr<vlr::VocabBase> vocab;
 	if (in_vocab_type.compare("HKM") == 0) {
-		vocab = new vlr::VocabTreeReal(dataset, vocabParams);
+		vocab = outOfCore ?
+				new vlr::VocabTreeReal(descriptorsFilenames, vocabParams) :
+				new vlr::VocabTreeReal(dataset, vocabParams);
 	} else if (in_vocab_type.compare("HKMAJ") == 0) {
-		vocab = new vlr::VocabTreeBin(dataset, vocabParams);
+		vocab = outOfCore ?
+				new vlr::VocabTreeBin(descriptorsFilenames, vocabParams) :
+				new vlr::VocabTreeBin(dataset, vocabParams);
 	} else if (in_vocab_type.compare("AKMAJ") == 0) {
 		vocab = new vlr::KMajority(dataset, vocabParams, nnIndexParams);
+	} else if (in_vocab_type.compare("MBKMAJ") == 0) {
+		vocab = new vlr::MiniBatchKMajority(descriptorsFilenames, vocabParams,
+				nnIndexParams);
 	} else if (in_vocab_type.compare("IKM") == 0) {
 		vocab = new vlr::IncrementalKMeans(dataset, vocabParams);
 	}
 
-	printf("-- Building [%s] vocabulary from [%d] feature vectors",
-			in_vocab_type.c_str(), dataset.rows);
+	if (outOfCore) {
+		printf("-- Building [%s] vocabulary from [%lu] descriptor files",
+				in_vocab_type.c_str(), descriptorsFilenames.size());
+	} else {
+		printf("-- Building [%s] vocabulary from [%d] feature vectors",
+				in_vocab_type.c_str(), dataset.rows);
+	}
 	for (cvflann::IndexParams::iterator it = vocabParams.begin();
 			it != vocabParams.end(); ++it) {
 		if (it->first.compare("centers.init.method") == 0) {
@@ -174,12 +261,20 @@ int main(int argc, char **argv) {
 					centersInitMethod == cvflann::FLANN_CENTERS_KMEANSPP ?
 							"KMEANSPP" :
 					centersInitMethod == cvflann::FLANN_CENTERS_GONZALES ?
-							"GONZALEZ" : "UNKNOWN");
+							"GONZALEZ" :
+					centersInitMethod == vlr::CENTERS_KMEANSPARALLEL ?
+							"KMEANSPARALLEL" : "UNKNOWN");
 		} else if (it->first.compare("nn.type") == 0) {
 			vlr::indexType nnMethod = it->second.cast<vlr::indexType>();
 			printf(", %s=%s", it->first.c_str(),
 					nnMethod == vlr::LINEAR ? "LINEAR" :
-					nnMethod == vlr::HIERARCHICAL ? "HIERARCHICAL" : "UNKNOWN");
+					nnMethod == vlr::HIERARCHICAL ? "HIERARCHICAL" :
+					nnMethod == vlr::HCTREE ? "HCTREE" : "UNKNOWN");
+		} else if (it->first.compare("tolerance") == 0) {
+			printf(", %s=%f", it->first.c_str(), it->second.cast<double>());
+		} else if (it->first.compare("checkpoint.dir") == 0) {
+			printf(", %s=%s", it->first.c_str(),
+					it->second.cast<std::string>().c_str());
 		} else {
 			printf(", %s=%d", it->first.c_str(), it->second.cast<int>());
 		}
@@ -207,9 +302,14 @@ int main(int argc, char **argv) {
 	vocab->build();
 	mytime = ((double) cv::getTickCount() - mytime) / cv::getTickFrequency()
 			* 1000;
-	printf(
-			"   Vocabulary created from [%d] descriptors in [%lf] ms with [%lu] words\n",
-			dataset.rows, mytime, vocab->size());
+	if (outOfCore) {
+		printf("   Vocabulary created in [%lf] ms with [%lu] words\n", mytime,
+				vocab->size());
+	} else {
+		printf(
+				"   Vocabulary created from [%d] descriptors in [%lf] ms with [%lu] words\n",
+				dataset.rows, mytime, vocab->size());
+	}
 
 	printf("-- Saving vocabulary to [%s]\n", out_vocab.c_str());
 
@@ -44,7 +44,10 @@
 #include <opencv2/core/core_c.h>
 #include <opencv2/flann/flann.hpp>
 
+#include <BitCounter.h>
 #include <CentersChooser.h>
+#include <ClusterReseeder.h>
+#include <DataStaging.hpp>
 #include <DirectIndex.hpp>
 #include <DynamicMat.hpp>
 #include <FileUtils.hpp>
@@ -53,21 +56,42 @@
 #include <KMajority.h>
 #include <VocabBase.hpp>
 
+#include <cstring>
 #include <fstream>
+#include <functional>
+#include <map>
+#include <stdint.h>
 
 namespace vlr {
 
 struct VocabTreeParams: public cvflann::IndexParams {
 	VocabTreeParams(int branching = 10, int depth = 6, int maxIterations = 10,
 			cvflann::flann_centers_init_t centersInitMethod =
-					cvflann::FLANN_CENTERS_RANDOM) {
+					cvflann::FLANN_CENTERS_RANDOM, bool boundsPruning = false) {
 		(*this)["depth"] = depth;
 		(*this)["branch.factor"] = branching;
 		(*this)["max.iterations"] = maxIterations;
 		(*this)["centers.init.method"] = centersInitMethod;
+		// Skip the search of data whose distance bounds prove their cluster, binary data only
+		(*this)["bounds.pruning"] = int(boundsPruning);
+		// Maximum size (in Bytes) of the local copy of the data of a node
+		(*this)["staging.max.bytes"] = 1 << 30;
+		// Directory where the build is checkpointed, empty to disable checkpoints
+		(*this)["checkpoint.dir"] = std::string();
+		// Number of descriptors clustered between checkpoints
+		(*this)["checkpoint.every"] = 50000000;
+		// Whether to continue from the checkpoint found in the checkpoint directory
+		(*this)["checkpoint.resume"] = 0;
+		// Number of checkpoints after which the build stops, e.g. to split it into
+		// several jobs, zero to never stop
+		(*this)["checkpoint.stop.after"] = 0;
 	}
 };
 
+// Magic of the vocabulary tree checkpoints
+static const char VTREE_CHECKPOINT_MAGIC[8] = { 'V', 'L', 'R', 'V', 'T', 'C',
+		'K', 'P' };
+
 // --------------------------------------------------------------------------
 
 class VocabTreeBase: public VocabBase {
@@ -130,6 +154,20 @@ private:
 	typedef typename Distance::ResultType DistanceType;
 	typedef VocabTreeNode<TDescriptor>* VocabTreeNodePtr;
 
+	/**
+	 * Node waiting to be clustered by the recursive build.
+	 */
+	struct PendingNode {
+		VocabTreeNodePtr node;
+		int level;
+		// Range of the node data in the build indices
+		int start;
+		int length;
+		bool fitted;
+		// Local copy of the node data, if any
+		cv::Mat staged;
+	};
+
 protected:
 
 	/** Attributes useful for building the tree **/
@@ -137,8 +175,31 @@ protected:
 	cvflann::flann_centers_init_t m_centers_init;
 	// Maximum number of iterations to use when performing k-means clustering
 	int m_iterations;
+	// Whether Hamming k-majority only searches data whose bounds allow a new cluster
+	bool m_boundsPruning;
+	// Maximum size (in Bytes) of the local copy of the data of a node
+	int m_stagingMaxBytes;
 	// The data set used by this index
 	vlr::Mat& m_dataset;
+	// Names of the descriptor files streamed by the level-wise build
+	std::vector<std::string> m_filenames;
+	// Directory of the checkpoints, empty if disabled
+	std::string m_checkpointDir;
+	// Number of descriptors clustered between checkpoints
+	int m_checkpointEvery;
+	// Whether to continue from the last checkpoint
+	bool m_resume;
+	// Number of checkpoints after which the build stops, zero to never stop
+	int m_stopAfter;
+	// Number of checkpoints written by the build
+	int m_numCheckpoints;
+	// Indices of the data under clustering, the children of a node own consecutive
+	// ranges of them
+	std::vector<int> m_indices;
+	// Nodes waiting to be clustered, the next one on top
+	std::vector<PendingNode> m_pending;
+	// Number of descriptors clustered since the last checkpoint
+	long long m_sinceCheckpoint;
 
 	/** Attributes of the tree **/
 	// Branching factor (number of partitions in which
@@ -170,6 +231,16 @@ public:
 	VocabTree(vlr::Mat& inputData = vlr::DEFAULT_INPUTDATA,
 			const cvflann::IndexParams& params = VocabTreeParams());
 
+	/**
+	 * Class constructor for the out-of-core build, the tree is built level by level
+	 * streaming the descriptor files instead of holding all the data.
+	 *
+	 * @param descriptorsFilenames - Names of the descriptor files to train from
+	 * @param params - Parameters to the hierarchical k-means algorithm
+	 */
+	VocabTree(const std::vector<std::string>& descriptorsFilenames,
+			const cvflann::IndexParams& params);
+
 	/**
 	 * Class destroyer, releases the memory used by the tree.
 	 */
@@ -183,6 +254,8 @@ public:
 	 * @note Interior nodes have only 'center' and 'children' information,
 	 * 		 while leaf nodes have only 'center' and 'word_id', all weights for
 	 * 		 interior nodes are 0 while weights for leaf nodes are 1.
+	 * @note If the tree was given descriptor files it is built level by level,
+	 * 		 see buildLevelWise.
 	 */
 	void build();
 
@@ -251,9 +324,96 @@ private:
 	 * @param node - The node to cluster
 	 * @param indices - Indices of the points belonging to the current node
 	 * @param indices_length
+	 * @param staged - Local copy of the data of the node, one row per index, or an
+	 * empty matrix if it is read from the data set
 	 */
 	void computeClustering(VocabTreeNodePtr node, int* indices,
-			int indices_length, int level, bool fitted);
+			int indices_length, int level, bool fitted,
+			cv::Mat staged = cv::Mat());
+
+	/**
+	 * Clusters the pending nodes until only the given number of them are left, the
+	 * recursion of the build. Writes a checkpoint when due before every node, then
+	 * reseeds the random generator with a seed kept in the checkpoint, so a resumed
+	 * build draws the same random numbers as an uninterrupted one.
+	 *
+	 * @param base - Number of pending nodes left untouched
+	 */
+	void clusterPending(size_t base);
+
+	/**
+	 * Atomically saves to the checkpoint directory the tree built so far, the
+	 * build indices and the pending nodes.
+	 *
+	 * @param seed - Seed of the random generator from the checkpoint on
+	 */
+	void saveCheckpoint(unsigned seed) const;
+
+	/**
+	 * Loads the partial tree, the build indices and the pending nodes from the
+	 * checkpoint directory, and reseeds the random generator as it was right after the
+	 * checkpoint.
+	 *
+	 * @return false if there is no checkpoint
+	 * @throw runtime_error if the checkpoint directory is not set
+	 */
+	bool loadCheckpoint();
+
+	/**
+	 * Writes in depth-first order the nodes of a partial tree, pending nodes are marked
+	 * as such.
+	 */
+	void writeCheckpointNode(std::ofstream& os, VocabTreeNodePtr node,
+			const std::map<VocabTreeNodePtr, int>& pendingNodes) const;
+
+	/**
+	 * Reads a partial tree written by writeCheckpointNode, collecting its nodes in
+	 * depth-first order.
+	 */
+	void readCheckpointNode(std::ifstream& is, VocabTreeNodePtr& node,
+			std::vector<VocabTreeNodePtr>& nodes);
+
+	/**
+	 * Builds the tree level by level from the descriptor files. All the nodes of a level
+	 * are clustered at once: every k-means iteration streams the files one time, routes
+	 * each descriptor down the levels already built and adds it to the accumulator of
+	 * the nearest center of its node. Memory use is O(nodes x branching x veclen)
+	 * instead of O(descriptors).
+	 *
+	 * Initial centers are drawn at random by reservoir sampling in an extra pass per
+	 * level. An empty cluster takes as center the farthest descriptor of the biggest
+	 * cluster of its node seen during the pass. Bounds pruning is not available since
+	 * it needs per-descriptor bounds.
+	 */
+	void buildLevelWise();
+
+	/**
+	 * Streams the descriptor files once, calling a function on every descriptor which
+	 * reaches a node of the given level being clustered.
+	 *
+	 * @param level - Level of the nodes being clustered
+	 * @param slots - Position of each node being clustered, indexed by node id, -1
+	 * for other nodes
+	 * @param visit - Function called with the position of the node and the descriptor
+	 */
+	void streamLevel(int level, const std::vector<int>& slots,
+			const std::function<void(int, TDescriptor*)>& visit);
+
+	/**
+	 * Loads a descriptor file checking its type and length agree with the tree.
+	 */
+	void loadDescriptorsFile(const std::string& filename, cv::Mat& descriptors);
+
+	/**
+	 * Turns a node into a leaf, i.e. a word of the vocabulary.
+	 */
+	void makeWord(VocabTreeNodePtr node);
+
+	/**
+	 * Numbers the nodes and the words in depth-first order, as the recursive build
+	 * and the loading do.
+	 */
+	void numberDepthFirst(VocabTreeNodePtr node);
 
 	/**
 	 * Saves the vocabulary tree starting at a given node to a stream.
@@ -316,6 +476,17 @@ VocabTree<TDescriptor, Distance>::VocabTree(vlr::Mat& inputData,
 	m_depth = cvflann::get_param<int>(params, "depth");
 	m_centers_init = cvflann::get_param<cvflann::flann_centers_init_t>(params,
 			"centers.init.method");
+	m_boundsPruning = cvflann::get_param<int>(params, "bounds.pruning", 0) != 0;
+	m_stagingMaxBytes = cvflann::get_param<int>(params, "staging.max.bytes",
+			1 << 30);
+	m_checkpointDir = cvflann::get_param<std::string>(params, "checkpoint.dir",
+			std::string());
+	m_checkpointEvery = std::max(1,
+			cvflann::get_param<int>(params, "checkpoint.every", 50000000));
+	m_resume = cvflann::get_param<int>(params, "checkpoint.resume", 0) != 0;
+	m_stopAfter = cvflann::get_param<int>(params, "checkpoint.stop.after", 0);
+	m_numCheckpoints = 0;
+	m_sinceCheckpoint = 0;
 
 	if (m_iterations < 0) {
 		m_iterations = std::numeric_limits<int>::max();
@@ -325,6 +496,16 @@ VocabTree<TDescriptor, Distance>::VocabTree(vlr::Mat& inputData,
 
 // --------------------------------------------------------------------------
 
+template<class TDescriptor, class Distance>
+VocabTree<TDescriptor, Distance>::VocabTree(
+		const std::vector<std::string>& descriptorsFilenames,
+		const cvflann::IndexParams& params) :
+		VocabTree(vlr::DEFAULT_INPUTDATA, params) {
+	m_filenames = descriptorsFilenames;
+}
+
+// --------------------------------------------------------------------------
+
 template<class TDescriptor, class Distance>
 VocabTree<TDescriptor, Distance>::~VocabTree() {
 	if (m_root != NULL) {
@@ -361,6 +542,11 @@ void VocabTree<TDescriptor, Distance>::build() {
 				" must be at least 1");
 	}
 
+	if (m_filenames.empty() == false) {
+		buildLevelWise();
+		return;
+	}
+
 	if (m_dataset.empty() == true) {
 		throw std::runtime_error("[VocabTree::build] Error, data set is empty"
 				" cannot proceed with clustering");
@@ -369,27 +555,41 @@ void VocabTree<TDescriptor, Distance>::build() {
 	// Number of features in the data set
 	int size = m_dataset.rows;
 
-	//  Array of descriptors indices
-	int* indices = new int[size];
-	for (int i = 0; i < size; ++i) {
-		indices[i] = i;
-	}
+	m_pending.clear();
+	m_sinceCheckpoint = 0;
+	m_numCheckpoints = 0;
 
-	m_root = new VocabTreeNode<TDescriptor>();
-	m_root->center = new TDescriptor[m_veclen];
-	std::fill(m_root->center, m_root->center + m_veclen, 0);
+	if (m_resume && loadCheckpoint()) {
+#if VTREEVERBOSE
+		printf("[VocabTree::build] Resuming clustering, [%lu] pending nodes\n",
+				m_pending.size());
+#endif
+	} else {
+		//  Array of descriptors indices
+		m_indices.resize(size);
+		for (int i = 0; i < size; ++i) {
+			m_indices[i] = i;
+		}
+
+		m_root = new VocabTreeNode<TDescriptor>();
+		m_root->center = new TDescriptor[m_veclen];
+		std::fill(m_root->center, m_root->center + m_veclen, 0);
+
+		PendingNode root = { m_root, 0, 0, size, false, cv::Mat() };
+		m_pending.push_back(root);
 
 #if VTREEVERBOSE
-	printf("[VocabTree::build] Started clustering\n");
+		printf("[VocabTree::build] Started clustering\n");
 #endif
+	}
 
-	computeClustering(m_root, indices, size, 0, false);
+	clusterPending(0);
 
 #if VTREEVERBOSE
 	printf("[VocabTree::build] Finished clustering\n");
 #endif
 
-	delete[] indices;
+	std::vector<int>().swap(m_indices);
 }
 
 // --------------------------------------------------------------------------
@@ -658,7 +858,8 @@ void VocabTree<TDescriptor, Distance>::load_tree(
 
 template<class TDescriptor, class Distance>
 void VocabTree<TDescriptor, Distance>::computeClustering(VocabTreeNodePtr node,
-		int* indices, int indices_length, int level, bool fitted) {
+		int* indices, int indices_length, int level, bool fitted,
+		cv::Mat staged) {
 
 	node->node_id = m_size;
 	++m_size;
@@ -666,7 +867,11 @@ void VocabTree<TDescriptor, Distance>::computeClustering(VocabTreeNodePtr node,
 	// Sort descriptors, caching leverages this fact
 	// Note: it doesn't affect the clustering process since all descriptors referenced by indices belong to the same cluster
 	if (level > 1) {
-		std::sort(indices, indices + indices_length);
+		if (staged.empty()) {
+			std::sort(indices, indices + indices_length);
+		} else {
+			DataStaging::sortByIndex(indices, indices_length, staged);
+		}
 	}
 
 	// Recursion base case: done when the last level is reached
@@ -696,6 +901,22 @@ void VocabTree<TDescriptor, Distance>::computeClustering(VocabTreeNodePtr node,
 	fflush(stdout);
 #endif
 
+	// Copy the data of the node once, the k-means iterations and the sub-trees
+	// then read it locally instead of fetching it from the data set every time
+	if (staged.empty()) {
+		DataStaging::gather(m_dataset, indices, indices_length,
+				m_stagingMaxBytes, staged);
+	}
+	// Returns the i-th descriptor of the node, valid until the next call
+	cv::Mat fetched;
+	auto descriptorAt = [&](int i) -> TDescriptor* {
+		if (staged.empty() == false) {
+			return staged.ptr<TDescriptor>(i);
+		}
+		fetched = m_dataset.row(indices[i]);
+		return (TDescriptor*) fetched.data;
+	};
+
 	std::vector<int> centers_idx(m_branching);
 	int centers_length = 0;
 
@@ -758,23 +979,44 @@ void VocabTree<TDescriptor, Distance>::computeClustering(VocabTreeNodePtr node,
 #endif
 #endif
 
+	// Bounds pruning as in Hamerly2010, only valid for the Hamming distance since
+	// the squared L2 distance does not satisfy the triangle inequality
+	bool pruning = m_boundsPruning && m_dataset.type() == CV_8U;
+	// Upper bound of the distance to the own center and lower bound to any other
+	std::vector<DistanceType> upper_bound, lower_bound;
+	// Distance each center moved in the last iteration
+	std::vector<DistanceType> drift;
+	cv::Mat prev_centers;
+	if (pruning) {
+		upper_bound.resize(indices_length);
+		lower_bound.resize(indices_length);
+		drift.resize(m_branching);
+	}
+
 	std::vector<int> belongs_to(indices_length);
 	std::vector<DistanceType> distance_to(indices_length);
 	for (int i = 0; i < indices_length; ++i) {
-		distance_to[i] = m_distance(
-				(TDescriptor*) m_dataset.row(indices[i]).data,
+		TDescriptor* descriptor = descriptorAt(i);
+		distance_to[i] = m_distance(descriptor,
 				(TDescriptor*) dcenters.row(0).data, m_veclen);
 		belongs_to[i] = 0;
+		DistanceType second_dist = std::numeric_limits<DistanceType>::max();
 		for (int j = 1; j < m_branching; ++j) {
-			DistanceType new_sq_dist = m_distance(
-					(TDescriptor*) m_dataset.row(indices[i]).data,
+			DistanceType new_sq_dist = m_distance(descriptor,
 					(TDescriptor*) dcenters.row(j).data, m_veclen);
 			if (distance_to[i] > new_sq_dist) {
 				belongs_to[i] = j;
+				second_dist = distance_to[i];
 				distance_to[i] = new_sq_dist;
+			} else if (second_dist > new_sq_dist) {
+				second_dist = new_sq_dist;
 			}
 		}
 		++count[belongs_to[i]];
+		if (pruning) {
+			upper_bound[i] = distance_to[i];
+			lower_bound[i] = second_dist;
+		}
 	}
 
 #if DEBUG
@@ -783,6 +1025,12 @@ void VocabTree<TDescriptor, Distance>::computeClustering(VocabTreeNodePtr node,
 #endif
 #endif
 
+	// Buffers of the k-majority centroids computation
+	std::vector<int> clusterStart, clusterMembers;
+	// Points moved to empty clusters
+	std::vector<int> reseeded;
+	BitCounter bitCounter(m_dataset.type() == CV_8U ? m_veclen : 0);
+
 	bool converged = false;
 	int iteration = 0;
 	while (converged == false && iteration < m_iterations) {
@@ -801,34 +1049,34 @@ void VocabTree<TDescriptor, Distance>::computeClustering(VocabTreeNodePtr node,
 #endif
 #endif
 
+		// Keep the previous centers to measure how far each one moves
+		if (pruning) {
+			dcenters.copyTo(prev_centers);
+		}
+
 		// Zeroing all the centroids dimensions
 		dcenters = cv::Scalar::all(0);
 
 		if (m_dataset.type() == CV_8U) {
-			// Warning: using matrix of integers, there might be
-			// an overflow when summing too much descriptors
-			cv::Mat bitwiseCount(m_branching, m_veclen * 8,
-					cv::DataType<int>::type);
-			// Zeroing matrix of cumulative bits
-			bitwiseCount = cv::Scalar::all(0);
-			// Bitwise summing the data into each centroid
-			for (int i = 0; i < indices_length; ++i) {
-				int j = belongs_to[i];
-				cv::Mat b = bitwiseCount.row(j);
-				KMajority::cumBitSum(m_dataset.row(indices[i]), b);
-			}
-			// Bitwise majority voting
+			// Group the data by cluster and vote every centroid from a bit counter
+			KMajority::groupByCluster(belongs_to, m_branching, clusterStart,
+					clusterMembers);
 			for (int j = 0; j < m_branching; ++j) {
-				cv::Mat centroid = dcenters.row(j);
-				KMajority::majorityVoting(bitwiseCount.row(j), centroid,
-						count[j]);
+				bitCounter.reset();
+				for (int p = clusterStart[j]; p < clusterStart[j + 1]; ++p) {
+					bitCounter.add(
+							(const uchar*) descriptorAt(clusterMembers[p]));
+				}
+				// Bitwise majority voting
+				bitCounter.majorityVoting(dcenters.ptr<uchar>(j), count[j]);
 			}
 		} else {
 			// Accumulate data into its corresponding cluster accumulator
 			for (int i = 0; i < indices_length; ++i) {
+				TDescriptor* descriptor = descriptorAt(i);
+				TDescriptor* center = dcenters.ptr<TDescriptor>(belongs_to[i]);
 				for (unsigned int k = 0; k < m_veclen; ++k) {
-					dcenters.at<TDescriptor>(belongs_to[i], k) += m_dataset.row(
-							indices[i]).at<TDescriptor>(0, k);
+					center[k] += descriptor[k];
 				}
 			}
 			// Divide accumulated data by the number transaction assigned to the cluster
@@ -852,27 +1100,105 @@ void VocabTree<TDescriptor, Distance>::computeClustering(VocabTreeNodePtr node,
 #endif
 #endif
 
-		for (int i = 0; i < indices_length; ++i) {
-			DistanceType sq_dist = m_distance(
-					(TDescriptor*) m_dataset.row(indices[i]).data,
-					(TDescriptor*) dcenters.row(0).data, m_veclen);
-			int new_centroid = 0;
-			for (int j = 1; j < m_branching; ++j) {
-				DistanceType new_sq_dist = m_distance(
-						(TDescriptor*) m_dataset.row(indices[i]).data,
+		if (pruning) {
+			// The upper bound grows by the drift of the own center and the lower
+			// bound shrinks by the largest drift among the other centers
+			int max_drift_idx = 0;
+			for (int j = 0; j < m_branching; ++j) {
+				drift[j] = m_distance(
+						(TDescriptor*) prev_centers.row(j).data,
 						(TDescriptor*) dcenters.row(j).data, m_veclen);
-				if (sq_dist > new_sq_dist) {
-					new_centroid = j;
-					sq_dist = new_sq_dist;
+				if (drift[j] > drift[max_drift_idx]) {
+					max_drift_idx = j;
+				}
+			}
+			DistanceType second_drift = 0;
+			for (int j = 0; j < m_branching; ++j) {
+				if (j != max_drift_idx && drift[j] > second_drift) {
+					second_drift = drift[j];
 				}
 			}
-			if (new_centroid != belongs_to[i]) {
-				--count[belongs_to[i]];
-				++count[new_centroid];
-				belongs_to[i] = new_centroid;
-				distance_to[i] = sq_dist;
 
-				converged = false;
+			size_t computed = 0;
+			for (int i = 0; i < indices_length; ++i) {
+				int a = belongs_to[i];
+				DistanceType other_drift =
+						a == max_drift_idx ? second_drift : drift[max_drift_idx];
+				upper_bound[i] += drift[a];
+				lower_bound[i] =
+						lower_bound[i] > other_drift ?
+								lower_bound[i] - other_drift : 0;
+				if (upper_bound[i] < lower_bound[i]) {
+					continue;
+				}
+
+				// Tighten the upper bound before searching
+				TDescriptor* descriptor = descriptorAt(i);
+				upper_bound[i] = m_distance(descriptor,
+						(TDescriptor*) dcenters.row(a).data, m_veclen);
+				++computed;
+				if (upper_bound[i] < lower_bound[i]) {
+					continue;
+				}
+
+				// Same search and tie breaking as without bounds
+				DistanceType sq_dist = m_distance(descriptor,
+						(TDescriptor*) dcenters.row(0).data, m_veclen);
+				DistanceType second_dist =
+						std::numeric_limits<DistanceType>::max();
+				int new_centroid = 0;
+				for (int j = 1; j < m_branching; ++j) {
+					DistanceType new_sq_dist = m_distance(descriptor,
+							(TDescriptor*) dcenters.row(j).data, m_veclen);
+					if (sq_dist > new_sq_dist) {
+						new_centroid = j;
+						second_dist = sq_dist;
+						sq_dist = new_sq_dist;
+					} else if (second_dist > new_sq_dist) {
+						second_dist = new_sq_dist;
+					}
+				}
+				computed += m_branching;
+				upper_bound[i] = sq_dist;
+				lower_bound[i] = second_dist;
+
+				if (new_centroid != belongs_to[i]) {
+					--count[belongs_to[i]];
+					++count[new_centroid];
+					belongs_to[i] = new_centroid;
+					distance_to[i] = sq_dist;
+
+					converged = false;
+				}
+			}
+#if VTREEVERBOSE
+			printf("[VocabTree::computeClustering] (level %d): skipped [%.2f]%% "
+					"of the distance computations\n", level,
+					100.0 * (1.0 - double(computed)
+							/ (double(indices_length) * m_branching)));
+#endif
+		} else {
+			for (int i = 0; i < indices_length; ++i) {
+				TDescriptor* descriptor = descriptorAt(i);
+				DistanceType sq_dist = m_distance(descriptor,
+						(TDescriptor*) dcenters.row(0).data, m_veclen);
+				int new_centroid = 0;
+				for (int j = 1; j < m_branching; ++j) {
+					DistanceType new_sq_dist = m_distance(descriptor,
+							(TDescriptor*) dcenters.row(j).data, m_veclen);
+					if (sq_dist > new_sq_dist) {
+						new_centroid = j;
+						sq_dist = new_sq_dist;
+					}
+				}
+				if (new_centroid != belongs_to[i]) {
+					--count[belongs_to[i]];
+					++count[new_centroid];
+					belongs_to[i] = new_centroid;
+					distance_to[i] = sq_dist;
+
+					converged = false;
+				}
 			}
 		}
 
@@ -892,35 +1218,16 @@ void VocabTree<TDescriptor, Distance>::computeClustering(VocabTreeNodePtr node,
 		// 1. Find the biggest cluster.
 		// 2. Find farthest point in the biggest cluster
 		// 3. Exclude the farthest point from the biggest cluster and form a new 1-point cluster.
+		// All the empty clusters are repaired in one sweep, see ClusterReseeder
 
-		for (int k = 0; k < m_branching; ++k) {
-			if (count[k] != 0) {
-				continue;
-			}
+		ClusterReseeder::reseed(m_branching, indices_length, count.data(),
+				belongs_to.data(), distance_to.data(), reseeded);
 
-			// 1. Find the biggest cluster
-			int max_k = 0;
-			for (int k1 = 1; k1 < m_branching; ++k1) {
-				if (count[max_k] < count[k1])
-					max_k = k1;
+		// Their bounds no longer hold, force a search on the next iteration
+		if (pruning) {
+			for (size_t m = 0; m < reseeded.size(); ++m) {
+				lower_bound[reseeded[m]] = 0;
 			}
-
-			// 2. Find farthest point in the biggest cluster
-			DistanceType maxDist(-1);
-			int idxFarthestPt = -1;
-			for (int i = 0; i < indices_length; ++i) {
-				if (belongs_to[i] == max_k) {
-					if (maxDist < distance_to[i]) {
-						maxDist = distance_to[i];
-						idxFarthestPt = i;
-					}
-				}
-			}
-
-			// 3. Exclude the farthest point from the biggest cluster and form a new 1-point cluster
-			--count[max_k];
-			++count[k];
-			belongs_to[idxFarthestPt] = k;
 		}
 
 #if DEBUG
@@ -940,36 +1247,574 @@ void VocabTree<TDescriptor, Distance>::computeClustering(VocabTreeNodePtr node,
 		}
 	}
 
-	// Compute k-means clustering for each of the resulting clusters
-	node->children = new VocabTreeNodePtr[m_branching];
-	int start = 0;
-	int end = start;
+	// Re-order indices by chunks in clustering order, along with the staged data
+	std::vector<int> bounds(m_branching + 1, 0);
+	int end = 0;
 	for (int c = 0; c < m_branching; ++c) {
-
-#if VTREEVERBOSE
-		printf(
-				"[VocabTree::computeClustering] Clustering over resulting clusters, level=[%d] branch=[%d]\n",
-				level, c);
-#endif
-
-		// Re-order indices by chunks in clustering order
 		for (int i = 0; i < indices_length; ++i) {
 			if (belongs_to[i] == c) {
 				std::swap(indices[i], indices[end]);
 				std::swap(belongs_to[i], belongs_to[end]);
+				if (staged.empty() == false) {
+					DataStaging::swapRows(staged, i, end);
+				}
 				++end;
 			}
 		}
+		bounds[c + 1] = end;
+	}
 
+	node->children = new VocabTreeNodePtr[m_branching];
+	for (int c = 0; c < m_branching; ++c) {
 		node->children[c] = new VocabTreeNode<TDescriptor>();
 		node->children[c]->center = centers[c];
-		computeClustering(node->children[c], indices + start, end - start,
-				level + 1, fitted);
-		start = end;
 	}
 
 	dcenters.release();
 	delete[] centers;
+
+	// Compute k-means clustering for each of the resulting clusters, queued in
+	// reverse order so the first one is on top
+	size_t base = m_pending.size();
+	int offset = indices - m_indices.data();
+	for (int c = m_branching - 1; c >= 0; --c) {
+		PendingNode child = { node->children[c], level + 1, offset + bounds[c],
+				bounds[c + 1] - bounds[c], fitted,
+				staged.empty() ?
+						cv::Mat() : staged.rowRange(bounds[c], bounds[c + 1]) };
+		m_pending.push_back(child);
+	}
+
+	m_sinceCheckpoint += indices_length;
+	clusterPending(base);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class Distance>
+void VocabTree<TDescriptor, Distance>::clusterPending(size_t base) {
+
+	while (m_pending.size() > base) {
+
+		if (m_checkpointDir.empty() == false
+				&& m_sinceCheckpoint >= m_checkpointEvery) {
+#if VTREEVERBOSE
+			printf("[VocabTree::clusterPending] Saving checkpoint, [%lu] pending"
+					" nodes\n", m_pending.size());
+#endif
+			unsigned seed = unsigned(cvflann::rand_int(RAND_MAX));
+			saveCheckpoint(seed);
+			cvflann::seed_random(seed);
+			m_sinceCheckpoint = 0;
+
+			if (++m_numCheckpoints == m_stopAfter) {
+				throw std::runtime_error("[VocabTree::clusterPending] "
+						"Build stopped after the requested number of checkpoints,"
+						" resume it to continue");
+			}
+		}
+
+		PendingNode next = m_pending.back();
+		m_pending.pop_back();
+
+#if VTREEVERBOSE
+		printf(
+				"[VocabTree::clusterPending] Clustering over resulting clusters, level=[%d] features=[%d]\n",
+				next.level, next.length);
+#endif
+
+		computeClustering(next.node, m_indices.data() + next.start, next.length,
+				next.level, next.fitted, next.staged);
+	}
+
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class Distance>
+void VocabTree<TDescriptor, Distance>::saveCheckpoint(unsigned seed) const {
+
+	std::string filename = m_checkpointDir + "/vocabtree.ckpt";
+
+	// Pending nodes are referred to by their position in the pending list
+	std::map<VocabTreeNodePtr, int> pendingNodes;
+	for (size_t p = 0; p < m_pending.size(); ++p) {
+		pendingNodes[m_pending[p].node] = p;
+	}
+
+	std::ofstream os((filename + ".tmp").c_str(),
+			std::ios::out | std::ios::trunc | std::ios::binary);
+
+	if (os.good() == false) {
+		throw std::runtime_error("[VocabTree::saveCheckpoint] "
+				"Unable to open file [" + filename + ".tmp] for writing");
+	}
+
+	int32_t header[] = { int32_t(m_veclen), m_branching, m_depth,
+			int32_t(m_size), int32_t(m_indices.size()), int32_t(m_pending.size()),
+			int32_t(seed) };
+	os.write(VTREE_CHECKPOINT_MAGIC, sizeof(VTREE_CHECKPOINT_MAGIC));
+	os.write((const char*) header, sizeof(header));
+	os.write((const char*) m_indices.data(), m_indices.size() * sizeof(int));
+
+	for (size_t p = 0; p < m_pending.size(); ++p) {
+		int32_t pending[] = { m_pending[p].level, m_pending[p].start,
+				m_pending[p].length, m_pending[p].fitted };
+		os.write((const char*) pending, sizeof(pending));
+	}
+
+	writeCheckpointNode(os, m_root, pendingNodes);
+
+	if (os.good() == false) {
+		throw std::runtime_error("[VocabTree::saveCheckpoint] "
+				"Error while writing file [" + filename + ".tmp]");
+	}
+
+	os.close();
+
+	// A crash never leaves a partial checkpoint
+	FileUtils::replaceFile(filename + ".tmp", filename);
+
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class Distance>
+void VocabTree<TDescriptor, Distance>::writeCheckpointNode(std::ofstream& os,
+		VocabTreeNodePtr node,
+		const std::map<VocabTreeNodePtr, int>& pendingNodes) const {
+
+	typename std::map<VocabTreeNodePtr, int>::const_iterator it =
+			pendingNodes.find(node);
+
+	// Pending nodes are written as their position in the pending list, other
+	// nodes as -1, then a flag tells whether children follow
+	int32_t fields[] = { node->node_id, node->word_id,
+			it == pendingNodes.end() ? -1 : it->second, node->children != NULL };
+	os.write((const char*) fields, sizeof(fields));
+	os.write((const char*) node->center, m_veclen * sizeof(TDescriptor));
+
+	if (node->children != NULL) {
+		for (int c = 0; c < m_branching; ++c) {
+			writeCheckpointNode(os, node->children[c], pendingNodes);
+		}
+	}
+
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class Distance>
+bool VocabTree<TDescriptor, Distance>::loadCheckpoint() {
+
+	if (m_checkpointDir.empty()) {
+		throw std::runtime_error("[VocabTree::loadCheckpoint] "
+				"Resuming requires a checkpoint directory");
+	}
+
+	std::string filename = m_checkpointDir + "/vocabtree.ckpt";
+
+	if (FileUtils::checkFileExist(filename) == false) {
+		return false;
+	}
+
+	std::ifstream is(filename.c_str(), std::ios::in | std::ios::binary);
+
+	char magic[sizeof(VTREE_CHECKPOINT_MAGIC)];
+	int32_t header[7];
+	is.read(magic, sizeof(magic));
+	is.read((char*) header, sizeof(header));
+
+	if (is.good() == false
+			|| memcmp(magic, VTREE_CHECKPOINT_MAGIC, sizeof(magic)) != 0) {
+		throw std::runtime_error("[VocabTree::loadCheckpoint] "
+				"File [" + filename + "] is not a vocabulary tree checkpoint");
+	}
+
+	if (header[0] != int32_t(m_veclen) || header[1] != m_branching
+			|| header[2] != m_depth || header[4] != m_dataset.rows) {
+		throw std::runtime_error("[VocabTree::loadCheckpoint] "
+				"Checkpoint [" + filename + "] does not match the parameters");
+	}
+
+	m_indices.resize(header[4]);
+	is.read((char*) m_indices.data(), m_indices.size() * sizeof(int));
+
+	m_pending.resize(header[5]);
+	for (size_t p = 0; p < m_pending.size(); ++p) {
+		int32_t pending[4];
+		is.read((char*) pending, sizeof(pending));
+		m_pending[p].level = pending[0];
+		m_pending[p].start = pending[1];
+		m_pending[p].length = pending[2];
+		m_pending[p].fitted = pending[3] != 0;
+	}
+
+	std::vector<VocabTreeNodePtr> nodes;
+	readCheckpointNode(is, m_root, nodes);
+
+	if (is.good() == false) {
+		throw std::runtime_error("[VocabTree::loadCheckpoint] "
+				"Checkpoint [" + filename + "] is truncated");
+	}
+
+	m_size = header[3];
+
+	// Draw the random numbers the interrupted build would have drawn
+	cvflann::seed_random(unsigned(header[6]));
+
+	// Finished leaves come in word order
+	m_words.clear();
+	for (size_t n = 0; n < nodes.size(); ++n) {
+		if (nodes[n]->word_id != -1) {
+			m_words.push_back(nodes[n]);
+		}
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class Distance>
+void VocabTree<TDescriptor, Distance>::readCheckpointNode(std::ifstream& is,
+		VocabTreeNodePtr& node, std::vector<VocabTreeNodePtr>& nodes) {
+
+	int32_t fields[4];
+	is.read((char*) fields, sizeof(fields));
+
+	if (is.good() == false) {
+		throw std::runtime_error("[VocabTree::readCheckpointNode] "
+				"Checkpoint is truncated");
+	}
+
+	node = new VocabTreeNode<TDescriptor>();
+	node->node_id = fields[0];
+	node->word_id = fields[1];
+	node->center = new TDescriptor[m_veclen];
+	is.read((char*) node->center, m_veclen * sizeof(TDescriptor));
+	nodes.push_back(node);
+
+	if (fields[2] != -1) {
+		CV_Assert(fields[2] < int32_t(m_pending.size()));
+		m_pending[fields[2]].node = node;
+	}
+
+	if (fields[3] != 0) {
+		node->children = new VocabTreeNodePtr[m_branching];
+		for (int c = 0; c < m_branching; ++c) {
+			readCheckpointNode(is, node->children[c], nodes);
+		}
+	}
+
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class Distance>
+void VocabTree<TDescriptor, Distance>::buildLevelWise() {
+
+	if (m_centers_init != cvflann::FLANN_CENTERS_RANDOM) {
+		throw std::runtime_error("[VocabTree::buildLevelWise] Error, only random"
+				" centers initialization is supported when streaming the data");
+	}
+
+	// Find out the length of the descriptors
+	cv::Mat descriptors;
+	m_veclen = 0;
+	for (size_t f = 0; f < m_filenames.size() && m_veclen == 0; ++f) {
+		loadDescriptorsFile(m_filenames[f], descriptors);
+	}
+
+	if (m_veclen == 0) {
+		throw std::runtime_error("[VocabTree::buildLevelWise] Error, descriptor"
+				" files are empty cannot proceed with clustering");
+	}
+	descriptors.release();
+
+	int type = cv::DataType<TDescriptor>::type;
+
+	m_root = new VocabTreeNode<TDescriptor>();
+	m_root->node_id = m_size++;
+	m_root->center = new TDescriptor[m_veclen];
+	std::fill(m_root->center, m_root->center + m_veclen, 0);
+
+#if VTREEVERBOSE
+	printf("[VocabTree::buildLevelWise] Started clustering\n");
+#endif
+
+	// Nodes of the current level to be clustered
+	std::vector<VocabTreeNodePtr> frontier(1, m_root);
+
+	for (int level = 0; frontier.empty() == false; ++level) {
+
+		if (level == m_depth) {
+			for (size_t s = 0; s < frontier.size(); ++s) {
+				makeWord(frontier[s]);
+			}
+			break;
+		}
+
+		int numSlots = frontier.size();
+		std::vector<int> slots(m_size, -1);
+		for (int s = 0; s < numSlots; ++s) {
+			slots[frontier[s]->node_id] = s;
+		}
+
+#if VTREEVERBOSE
+		printf("[VocabTree::buildLevelWise] (level %d): sampling centers of"
+				" [%d] nodes\n", level, numSlots);
+		fflush(stdout);
+#endif
+
+		// 1. Count the data of every node and draw its initial centers by
+		// reservoir sampling, row s * m_branching + j holds center j of node s
+		cv::Mat centers(numSlots * m_branching, m_veclen, type);
+		std::vector<int> sizes(numSlots, 0);
+		streamLevel(level, slots, [&](int s, TDescriptor* descriptor) {
+			int n = sizes[s]++;
+			int j = n < m_branching ? n : cvflann::rand_int(n + 1);
+			if (j < m_branching) {
+				std::copy(descriptor, descriptor + m_veclen,
+						centers.ptr<TDescriptor>(s * m_branching + j));
+			}
+		});
+
+		// Nodes with less data than clusters are leaves
+		for (int s = 0; s < numSlots; ++s) {
+			if (sizes[s] < m_branching) {
+				makeWord(frontier[s]);
+				slots[frontier[s]->node_id] = -1;
+			}
+		}
+
+		// 2. Run k-means on all the nodes at once, one pass per iteration
+		std::vector<int> count(numSlots * m_branching);
+		std::vector<BitCounter> bitCounters;
+		cv::Mat sums;
+		// Farthest descriptor of every cluster, the candidates to fill empty clusters
+		cv::Mat farthest(numSlots * m_branching, m_veclen, type);
+		std::vector<DistanceType> farthestDistance(numSlots * m_branching);
+
+		bool converged = false;
+		for (int iteration = 0; converged == false && iteration < m_iterations;
+				++iteration) {
+
+#if VTREEVERBOSE
+			printf("[VocabTree::buildLevelWise] (level %d): iteration=[%d]\n",
+					level, iteration);
+			fflush(stdout);
+#endif
+
+			std::fill(count.begin(), count.end(), 0);
+			if (type == CV_8U) {
+				bitCounters.assign(numSlots * m_branching, BitCounter(m_veclen));
+			} else {
+				sums = cv::Mat::zeros(numSlots * m_branching, m_veclen, CV_64F);
+			}
+
+			streamLevel(level, slots, [&](int s, TDescriptor* descriptor) {
+				// Same search and tie breaking as the in-memory build
+				int first = s * m_branching;
+				DistanceType sq_dist = m_distance(descriptor,
+						centers.ptr<TDescriptor>(first), m_veclen);
+				int c = first;
+				for (int j = first + 1; j < first + m_branching; ++j) {
+					DistanceType new_sq_dist = m_distance(descriptor,
+							centers.ptr<TDescriptor>(j), m_veclen);
+					if (sq_dist > new_sq_dist) {
+						c = j;
+						sq_dist = new_sq_dist;
+					}
+				}
+				if (type == CV_8U) {
+					bitCounters[c].add((const uchar*) descriptor);
+				} else {
+					double* sum = sums.ptr<double>(c);
+					for (size_t k = 0; k < m_veclen; ++k) {
+						sum[k] += descriptor[k];
+					}
+				}
+				if (count[c]++ == 0 || sq_dist > farthestDistance[c]) {
+					farthestDistance[c] = sq_dist;
+					std::copy(descriptor, descriptor + m_veclen,
+							farthest.ptr<TDescriptor>(c));
+				}
+			});
+
+			converged = true;
+			std::vector<TDescriptor> center(m_veclen);
+			for (int s = 0; s < numSlots; ++s) {
+				if (slots[frontier[s]->node_id] == -1) {
+					continue;
+				}
+				int first = s * m_branching;
+				for (int c = first; c < first + m_branching; ++c) {
+					if (count[c] == 0) {
+						continue;
+					}
+					if (type == CV_8U) {
+						bitCounters[c].majorityVoting((uchar*) center.data(),
+								count[c]);
+					} else {
+						const double* sum = sums.ptr<double>(c);
+						for (size_t k = 0; k < m_veclen; ++k) {
+							center[k] = TDescriptor(sum[k] / count[c]);
+						}
+					}
+					TDescriptor* previous = centers.ptr<TDescriptor>(c);
+					if (std::equal(center.begin(), center.end(), previous) == false) {
+						std::copy(center.begin(), center.end(), previous);
+						converged = false;
+					}
+				}
+
+				// Every empty cluster takes the farthest descriptor of the biggest
+				// cluster left, lowest index first among equal sizes
+				std::vector<std::pair<int, int> > donors;
+				for (int c = first; c < first + m_branching; ++c) {
+					if (count[c] > 1) {
+						donors.push_back(std::make_pair(-count[c], c));
+					}
+				}
+				std::sort(donors.begin(), donors.end());
+				size_t d = 0;
+				for (int c = first; c < first + m_branching && d < donors.size();
+						++c) {
+					if (count[c] == 0) {
+						int donor = donors[d++].second;
+						farthest.row(donor).copyTo(centers.row(c));
+						converged = false;
+					}
+				}
+			}
+		}
+
+		// 3. Attach the children of the clustered nodes, next level clusters them
+		std::vector<VocabTreeNodePtr> next;
+		for (int s = 0; s < numSlots; ++s) {
+			if (slots[frontier[s]->node_id] == -1) {
+				continue;
+			}
+			VocabTreeNodePtr node = frontier[s];
+			node->children = new VocabTreeNodePtr[m_branching];
+			for (int j = 0; j < m_branching; ++j) {
+				VocabTreeNodePtr child = new VocabTreeNode<TDescriptor>();
+				child->node_id = m_size++;
+				child->center = new TDescriptor[m_veclen];
+				const TDescriptor* center = centers.ptr<TDescriptor>(
+						s * m_branching + j);
+				std::copy(center, center + m_veclen, child->center);
+				node->children[j] = child;
+				next.push_back(child);
+			}
+		}
+		frontier.swap(next);
+	}
+
+	// Nodes were numbered level by level
+	m_size = 0;
+	m_words.clear();
+	numberDepthFirst(m_root);
+
+#if VTREEVERBOSE
+	printf("[VocabTree::buildLevelWise] Finished clustering\n");
+#endif
+
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class Distance>
+void VocabTree<TDescriptor, Distance>::streamLevel(int level,
+		const std::vector<int>& slots,
+		const std::function<void(int, TDescriptor*)>& visit) {
+
+	cv::Mat descriptors;
+
+	for (size_t f = 0; f < m_filenames.size(); ++f) {
+
+		loadDescriptorsFile(m_filenames[f], descriptors);
+
+		for (int i = 0; i < descriptors.rows; ++i) {
+			TDescriptor* descriptor = descriptors.ptr<TDescriptor>(i);
+
+			// Route the descriptor down the levels already built
+			VocabTreeNodePtr node = m_root;
+			for (int l = 0; l < level && node->children != NULL; ++l) {
+				int best = 0;
+				DistanceType best_dist = m_distance(descriptor,
+						node->children[0]->center, m_veclen);
+				for (int c = 1; c < m_branching; ++c) {
+					DistanceType dist = m_distance(descriptor,
+							node->children[c]->center, m_veclen);
+					if (best_dist > dist) {
+						best = c;
+						best_dist = dist;
+					}
+				}
+				node = node->children[best];
+			}
+
+			// The descriptor ended at a leaf
+			int s = slots[node->node_id];
+			if (s != -1) {
+				visit(s, descriptor);
+			}
+		}
+	}
+
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class Distance>
+void VocabTree<TDescriptor, Distance>::loadDescriptorsFile(
+		const std::string& filename, cv::Mat& descriptors) {
+
+	FileUtils::loadDescriptors(filename, descriptors);
+
+	if (descriptors.empty()) {
+		return;
+	}
+
+	if (descriptors.type() != cv::DataType<TDescriptor>::type) {
+		throw std::runtime_error("[VocabTree::loadDescriptorsFile] "
+				"Descriptors in [" + filename + "] do not match the tree type");
+	}
+
+	if (m_veclen == 0) {
+		m_veclen = descriptors.cols;
+	} else if (size_t(descriptors.cols) != m_veclen) {
+		throw std::runtime_error("[VocabTree::loadDescriptorsFile] "
+				"Descriptors in [" + filename + "] have a different length");
+	}
+
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class Distance>
+void VocabTree<TDescriptor, Distance>::makeWord(VocabTreeNodePtr node) {
+	node->children = NULL;
+	node->word_id = m_words.size();
+	m_words.push_back(node);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class Distance>
+void VocabTree<TDescriptor, Distance>::numberDepthFirst(
+		VocabTreeNodePtr node) {
+	node->node_id = m_size++;
+	if (node->children == NULL) {
+		node->word_id = m_words.size();
+		m_words.push_back(node);
+	} else {
+		for (int c = 0; c < m_branching; ++c) {
+			numberDepthFirst(node->children[c]);
+		}
+	}
 }
 
 // --------------------------------------------------------------------------
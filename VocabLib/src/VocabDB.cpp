@@ -459,7 +459,7 @@ void AKMajDB::loadBoFModel(const std::string& filename) {
 	m_nnIndex = vlr::createIndexByType(
 			cvflann::Matrix<uchar>((uchar*) m_bofModel->getCentroids().data,
 					m_bofModel->getCentroids().rows,
-					m_bofModel->getCentroids().cols), vlr::HIERARCHICAL,
+					m_bofModel->getCentroids().cols), m_bofModel->getNNType(),
 			cvflann::IndexParams());
 }
 
@@ -545,7 +545,8 @@ void AKMajDB::loadNNIndex(const std::string& filename) {
 // --------------------------------------------------------------------------
 
 int IncrementaKMeansDB::getFeaturesLength() const {
-	return m_bofModel->getCentroids().cols;
+	// Centers hold one dimension per bit of the features
+	return m_bofModel->getCentroids().cols / 8;
 }
 
 // --------------------------------------------------------------------------
@@ -556,10 +557,8 @@ void IncrementaKMeansDB::quantize(const cv::Mat& feature, int& wordId, double& w
 
 	wordId = -1;
 
-	cv::Mat transaction;
-	int clusterIndex;
 	double distanceToCluster;
-	m_bofModel->findNearestNeighbor(transaction, clusterIndex, distanceToCluster);
+	m_bofModel->findNearestNeighbor(feature, wordId, distanceToCluster);
 
 	CV_Assert(wordId != -1);
 
@@ -6,6 +6,7 @@
  */
 
 #include <limits.h>
+#include <cstdio>
 
 #include <gtest/gtest.h>
 #include <opencv2/core/core.hpp>
@@ -92,3 +93,191 @@ TEST(VocabTreeBinary, LoadSave) {
 	ASSERT_TRUE(tree->getNumNodes() == treeLoad->getNumNodes());
 
 }
+
+TEST(VocabTreeBinary, BoundsPruning) {
+
+	/////////////////////////////////////////////////////////////////////
+	std::vector<std::string> keysFilenames;
+	keysFilenames.push_back("brief_0.bin");
+	keysFilenames.push_back("brief_1.bin");
+
+	vlr::Mat data(keysFilenames);
+	/////////////////////////////////////////////////////////////////////
+
+	vlr::VocabTreeParams params;
+	params["depth"] = 3;
+
+	cv::Ptr<vlr::VocabTreeBin> tree = new vlr::VocabTreeBin(data, params);
+	cvflann::seed_random(1234);
+	tree->build();
+
+	params["bounds.pruning"] = 1;
+
+	cv::Ptr<vlr::VocabTreeBin> treePruned = new vlr::VocabTreeBin(data,
+			params);
+	cvflann::seed_random(1234);
+	treePruned->build();
+
+	// Pruning must not change the clustering
+	ASSERT_TRUE(*tree.obj == *treePruned.obj);
+
+}
+
+TEST(VocabTreeBinary, Staging) {
+
+	/////////////////////////////////////////////////////////////////////
+	std::vector<std::string> keysFilenames;
+	keysFilenames.push_back("brief_0.bin");
+	keysFilenames.push_back("brief_1.bin");
+
+	vlr::Mat data(keysFilenames);
+	/////////////////////////////////////////////////////////////////////
+
+	vlr::VocabTreeParams params;
+	params["depth"] = 3;
+	// Read every descriptor from the data set
+	params["staging.max.bytes"] = 0;
+
+	cv::Ptr<vlr::VocabTreeBin> tree = new vlr::VocabTreeBin(data, params);
+	cvflann::seed_random(1234);
+	tree->build();
+
+	params["staging.max.bytes"] = 1 << 30;
+
+	cv::Ptr<vlr::VocabTreeBin> treeStaged = new vlr::VocabTreeBin(data,
+			params);
+	cvflann::seed_random(1234);
+	treeStaged->build();
+
+	// Staging must not change the clustering
+	ASSERT_TRUE(*tree.obj == *treeStaged.obj);
+
+}
+
+TEST(VocabTreeBinary, LevelWise) {
+
+	std::vector<std::string> keysFilenames;
+	keysFilenames.push_back("brief_0.bin");
+	keysFilenames.push_back("brief_1.bin");
+
+	vlr::VocabTreeParams params;
+	params["depth"] = 3;
+
+	cv::Ptr<vlr::VocabTreeBin> tree = new vlr::VocabTreeBin(keysFilenames,
+			params);
+	tree->build();
+
+	ASSERT_TRUE(tree->getNumWords() > 1);
+	ASSERT_TRUE(tree->getNumWords() <= 1000);
+
+	tree->save("test_tree_levelwise.yaml.gz");
+
+	cv::Ptr<vlr::VocabTreeBin> treeLoad = new vlr::VocabTreeBin();
+
+	treeLoad->load("test_tree_levelwise.yaml.gz");
+
+	// Check tree structure is the same
+	ASSERT_TRUE(*tree.obj == *treeLoad.obj);
+
+}
+
+TEST(VocabTreeBinary, LevelWiseCentersAreMajorities) {
+
+	std::vector<std::string> keysFilenames;
+	keysFilenames.push_back("brief_0.bin");
+	keysFilenames.push_back("brief_1.bin");
+
+	vlr::VocabTreeParams params;
+	params["depth"] = 1;
+	params["branch.factor"] = 10;
+	// Enough iterations for the streamed k-majority to converge
+	params["max.iterations"] = 1000;
+
+	cv::Ptr<vlr::VocabTreeBin> tree = new vlr::VocabTreeBin(keysFilenames,
+			params);
+	tree->build();
+
+	ASSERT_EQ(10, int(tree->getNumWords()));
+
+	cv::Mat data, descriptors;
+	for (size_t f = 0; f < keysFilenames.size(); ++f) {
+		FileUtils::loadDescriptors(keysFilenames[f], descriptors);
+		data.push_back(descriptors);
+	}
+
+	// Count the bits set among the descriptors routed to every word
+	std::vector<int> count(tree->getNumWords(), 0);
+	std::vector<std::vector<int> > bitCounts(tree->getNumWords(),
+			std::vector<int>(data.cols * 8, 0));
+	for (int i = 0; i < data.rows; ++i) {
+		int wordId = -1, nodeAtL = 0;
+		tree->quantize(data.row(i), 0, wordId, nodeAtL);
+		ASSERT_TRUE(0 <= wordId && wordId < int(tree->getNumWords()));
+		++count[wordId];
+		const uchar* descriptor = data.ptr<uchar>(i);
+		for (int l = 0; l < data.cols * 8; ++l) {
+			bitCounts[wordId][l] += (descriptor[l / 8] >> (l % 8)) & 1;
+		}
+	}
+
+	// Once converged every center is the majority of its own data, a bit being
+	// set when more than half of the data has it, and no word is left empty.
+	// Votes are laid out as by KMajority::majorityVoting, byte b goes to byte
+	// dim - 1 - b of the center
+	for (int j = 0; j < 10; ++j) {
+		vlr::VocabTreeNode<uchar>* word = tree->getRoot()->children[j];
+		EXPECT_GT(count[word->word_id], 0);
+		for (int l = 0; l < data.cols * 8; ++l) {
+			int bit = (word->center[data.cols - 1 - l / 8] >> (l % 8)) & 1;
+			EXPECT_EQ(2 * bitCounts[word->word_id][l] > count[word->word_id],
+					bit == 1);
+		}
+	}
+
+}
+
+TEST(VocabTreeBinary, CheckpointResume) {
+
+	/////////////////////////////////////////////////////////////////////
+	std::vector<std::string> keysFilenames;
+	keysFilenames.push_back("brief_0.bin");
+	keysFilenames.push_back("brief_1.bin");
+
+	vlr::Mat data(keysFilenames);
+	/////////////////////////////////////////////////////////////////////
+
+	vlr::VocabTreeParams params;
+	params["depth"] = 3;
+	params["checkpoint.dir"] = std::string(".");
+	// About one checkpoint per level
+	params["checkpoint.every"] = data.rows;
+
+	std::remove("./vocabtree.ckpt");
+	cv::Ptr<vlr::VocabTreeBin> tree = new vlr::VocabTreeBin(data, params);
+	cvflann::seed_random(1234);
+	tree->build();
+
+	// Stop the same build at its first checkpoint
+	params["checkpoint.stop.after"] = 1;
+
+	std::remove("./vocabtree.ckpt");
+	cv::Ptr<vlr::VocabTreeBin> treeStopped = new vlr::VocabTreeBin(data,
+			params);
+	cvflann::seed_random(1234);
+	ASSERT_THROW(treeStopped->build(), std::runtime_error);
+
+	ASSERT_TRUE(FileUtils::checkFileExist("./vocabtree.ckpt"));
+
+	// Finish it from the checkpoint, with another seed
+	params["checkpoint.stop.after"] = 0;
+	params["checkpoint.resume"] = 1;
+
+	cv::Ptr<vlr::VocabTreeBin> treeResumed = new vlr::VocabTreeBin(data,
+			params);
+	cvflann::seed_random(4321);
+	treeResumed->build();
+
+	// The resumed build must give the tree of the uninterrupted one
+	ASSERT_TRUE(*tree.obj == *treeResumed.obj);
+
+}
@@ -18,6 +18,7 @@
 #include <VocabTree.h>
 #include <VocabDB.hpp>
 
+#include <BinaryVocabFile.hpp>
 #include <FileUtils.hpp>
 
 #include <FunctionUtils.hpp>
@@ -92,9 +93,11 @@ int main(int argc, char **argv) {
 	}
 
 	// Checking that database filename refers to a compressed YAML or XML file
-	if (boost::regex_match(in_vocab, DESCRIPTOR_REGEX) == false) {
+	if (boost::regex_match(in_vocab, DESCRIPTOR_REGEX) == false
+			&& BinaryVocabFile::isBinaryVocab(in_vocab) == false) {
 		fprintf(stderr,
-				"Input vocabulary file must have the extension .yaml.gz or .xml.gz\n");
+				"Input vocabulary file must have the extension .yaml.gz or .xml.gz"
+						" or be a binary vocabulary\n");
 		return EXIT_FAILURE;
 	}
 